@@ -261,6 +261,11 @@ bool GpSystemServices_Win32::IsFullscreenOnStartup() const
 	return false;
 }
 
+bool GpSystemServices_Win32::IsStartupTraceEnabled() const
+{
+	return false;
+}
+
 unsigned int GpSystemServices_Win32::GetCPUCount() const
 {
 	SYSTEM_INFO sysInfo;
@@ -34,6 +34,7 @@ public:
 	bool IsTextInputObstructive() const override;
 	bool IsFullscreenPreferred() const override;
 	bool IsFullscreenOnStartup() const override;
+	bool IsStartupTraceEnabled() const override;
 	unsigned int GetCPUCount() const override;
 	void SetTextInputEnabled(bool isEnabled) override;
 	bool IsTextInputEnabled() const override;
@@ -84,6 +84,11 @@ bool GpSystemServices_Android::IsFullscreenOnStartup() const
 	return true;
 }
 
+bool GpSystemServices_Android::IsStartupTraceEnabled() const
+{
+	return false;
+}
+
 unsigned int GpSystemServices_Android::GetCPUCount() const
 {
 	return SDL_GetCPUCount();
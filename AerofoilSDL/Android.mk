@@ -18,7 +18,9 @@ LOCAL_CFLAGS := -DGP_DEBUG_CONFIG=0
 
 # Add your application source files here...
 LOCAL_SRC_FILES := \
+	GpAudioBufferQueue.cpp	\
 	GpAudioDriver_SDL2.cpp	\
+	GpAudioMixKernels.cpp	\
 	GpDisplayDriver_SDL_GL2.cpp	\
 	ShaderCode/CopyQuadP.cpp	\
 	ShaderCode/DrawQuadPaletteP.cpp	\
@@ -0,0 +1,111 @@
+#include "GpAudioBufferQueue.h"
+#include "IGpAudioBuffer.h"
+
+GpAudioBufferQueue::GpAudioBufferQueue()
+	: m_nextTicket(0)
+	, m_frontLane(-1)
+{
+	for (int lane = 0; lane < Lane_Count; lane++)
+	{
+		m_rings[lane].m_writeIndex.store(0, std::memory_order_relaxed);
+		m_rings[lane].m_readIndex.store(0, std::memory_order_relaxed);
+	}
+
+	m_otherLaneLock.clear();
+}
+
+bool GpAudioBufferQueue::Push(Lane lane, IGpAudioBuffer *buffer, size_t startOffset, uint64_t postTime)
+{
+	Ring &ring = m_rings[lane];
+
+	// The mixer lane only ever has one producer, so only the other lane needs a lock
+	if (lane == Lane_Other)
+	{
+		while (m_otherLaneLock.test_and_set(std::memory_order_acquire))
+		{
+		}
+	}
+
+	const unsigned int writeIndex = ring.m_writeIndex.load(std::memory_order_relaxed);
+
+	// The consumer releases the slot only after it's done reading it
+	const bool isFull = (writeIndex - ring.m_readIndex.load(std::memory_order_acquire) == kLaneCapacity);
+	if (!isFull)
+	{
+		buffer->AddRef();
+
+		Entry &entry = ring.m_entries[writeIndex % kLaneCapacity];
+		entry.m_buffer = buffer;
+		entry.m_startOffset = startOffset;
+		entry.m_postTime = postTime;
+		entry.m_ticket = m_nextTicket.fetch_add(1, std::memory_order_relaxed);
+
+		ring.m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+	}
+
+	if (lane == Lane_Other)
+		m_otherLaneLock.clear(std::memory_order_release);
+
+	return !isFull;
+}
+
+const GpAudioBufferQueue::Entry *GpAudioBufferQueue::Front()
+{
+	if (m_frontLane >= 0)
+		return RingFront(m_rings[m_frontLane]);
+
+	// Posts that were made one after another are published in that order, so the lowest ticket among the
+	// lanes' fronts is the oldest post.  Once chosen, the front stays put until it's popped.
+	const Entry *oldest = nullptr;
+	for (int lane = 0; lane < Lane_Count; lane++)
+	{
+		const Entry *entry = RingFront(m_rings[lane]);
+		if (entry && (!oldest || IsBefore(entry->m_ticket, oldest->m_ticket)))
+		{
+			oldest = entry;
+			m_frontLane = lane;
+		}
+	}
+
+	return oldest;
+}
+
+void GpAudioBufferQueue::PopFront()
+{
+	Ring &ring = m_rings[m_frontLane];
+	ring.m_readIndex.store(ring.m_readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+	m_frontLane = -1;
+}
+
+size_t GpAudioBufferQueue::Flush(IGpAudioBuffer **outBuffers)
+{
+	size_t numFlushed = 0;
+
+	// Stops once it has taken as many as the queue holds, anything posted during the flush stays queued
+	while (numFlushed < kCapacity)
+	{
+		const Entry *entry = Front();
+		if (!entry)
+			break;
+
+		outBuffers[numFlushed++] = entry->m_buffer;
+		PopFront();
+	}
+
+	return numFlushed;
+}
+
+const GpAudioBufferQueue::Entry *GpAudioBufferQueue::RingFront(const Ring &ring) const
+{
+	const unsigned int readIndex = ring.m_readIndex.load(std::memory_order_relaxed);
+	if (readIndex == ring.m_writeIndex.load(std::memory_order_acquire))
+		return nullptr;
+
+	return &ring.m_entries[readIndex % kLaneCapacity];
+}
+
+bool GpAudioBufferQueue::IsBefore(uint32_t ticketA, uint32_t ticketB)
+{
+	return static_cast<int32_t>(ticketA - ticketB) < 0;
+}
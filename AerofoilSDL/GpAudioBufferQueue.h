@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreDefs.h"
+
+#include <atomic>
+
+struct IGpAudioBuffer;
+
+// Buffers posted to a channel and waiting to be mixed.  Posts come in through two single-producer rings: one for
+// the mixer thread, which posts from buffer-finished callbacks and must never wait, and one for every other thread,
+// serialized by a spin lock that the mixer never takes.  Each post is stamped with a ticket so the consumer can
+// take them in the order they were made.  The consumer side never locks or allocates, and its calls must be
+// serialized by the caller, which is the mixer lock for the SDL driver.  Each queued buffer holds a reference that
+// the consumer releases.
+class GpAudioBufferQueue
+{
+public:
+	enum Lane
+	{
+		Lane_Mixer,
+		Lane_Other,
+
+		Lane_Count,
+	};
+
+	static const size_t kLaneCapacity = 16;
+	static const size_t kCapacity = kLaneCapacity * Lane_Count;
+
+	struct Entry
+	{
+		IGpAudioBuffer *m_buffer;
+		size_t m_startOffset;
+		uint64_t m_postTime;
+		uint32_t m_ticket;
+	};
+
+	GpAudioBufferQueue();
+
+	// Producer: adds a reference to the buffer and queues it, or returns false if the lane is full
+	bool Push(Lane lane, IGpAudioBuffer *buffer, size_t startOffset, uint64_t postTime);
+
+	// Consumer: the oldest entry, or null if the queue is empty.  The entry stays at the front until it's popped.
+	const Entry *Front();
+
+	// Consumer: removes the front entry without releasing its buffer
+	void PopFront();
+
+	// Consumer: removes every entry and returns their buffers, oldest first, for the caller to release
+	size_t Flush(IGpAudioBuffer **outBuffers);
+
+private:
+	struct Ring
+	{
+		Entry m_entries[kLaneCapacity];
+		std::atomic<unsigned int> m_writeIndex;
+		std::atomic<unsigned int> m_readIndex;
+	};
+
+	const Entry *RingFront(const Ring &ring) const;
+	static bool IsBefore(uint32_t ticketA, uint32_t ticketB);
+
+	Ring m_rings[Lane_Count];
+	std::atomic<uint32_t> m_nextTicket;
+	std::atomic_flag m_otherLaneLock;
+
+	int m_frontLane;	// Consumer only, the lane that the front entry was taken from, or -1 if not chosen yet
+};
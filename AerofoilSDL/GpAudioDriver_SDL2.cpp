@@ -1,18 +1,26 @@
 #include "CoreDefs.h"
+#include "IGpAudioBuffer.h"
 #include "IGpAudioDriver.h"
 #include "IGpAudioChannel.h"
 #include "IGpAudioChannelCallbacks.h"
+#include "IGpLogDriver.h"
 #include "IGpMutex.h"
 #include "IGpPrefsHandler.h"
 #include "IGpSystemServices.h"
+#include "GpAudioBufferQueue.h"
 #include "GpAudioDriverProperties.h"
+#include "GpAudioMixKernels.h"
 #include "GpSDL.h"
 
+#include "SDL.h"
 #include "SDL_audio.h"
+#include "SDL_timer.h"
 #include "GpRingBuffer.h"
 
 #include "SDL_atomic.h"
+#include "SDL_thread.h"
 
+#include <atomic>
 #include <stdlib.h>
 #include <string.h>
 #include <new>
@@ -20,6 +28,41 @@
 
 class GpAudioDriver_SDL2;
 
+// Device buffer sizes, in frames.  Smaller buffers cut the delay before a new sound is heard, but leave the
+// mixer less time to run before the device runs dry.
+static const unsigned int kMinBufferFrames = 64;
+static const unsigned int kMaxBufferFrames = 4096;
+static const unsigned int kDefaultBufferFrames = 1024;
+
+// The offline driver renders at a fixed rate, in blocks of this many frames
+static const unsigned int kOfflineSampleRate = 48000;
+static const unsigned int kOfflineRenderFrames = 1024;
+
+static const char *kPrefsIdentifier = "GpAudioDriverSDL2";
+static uint32_t kPrefsVersion = 1;
+
+struct GpAudioDriver_SDL2_Prefs
+{
+	uint32_t m_bufferFrames;
+};
+
+// Log2 histogram of durations in microseconds.  The first bucket is everything under 32us, and the last
+// is everything from 32ms up.
+struct GpAudioTimingHistogram
+{
+	static const size_t kNumBuckets = 12;
+	static const uint64_t kFirstBucketLimit = 32;
+
+	uint64_t m_buckets[kNumBuckets];
+	uint64_t m_count;
+	uint64_t m_totalMicros;
+	uint64_t m_maxMicros;
+
+	void Reset();
+	void Add(uint64_t micros);
+	void Log(IGpLogDriver *logger, const char *name) const;
+};
+
 static void *AlignedAlloc(size_t size, size_t alignment)
 {
 	void *storage = malloc(size + alignment);
@@ -46,20 +89,25 @@ static void AlignedFree(void *ptr)
 	free(storageLoc);
 }
 
-struct GpAudioChannelBufferChain_SDL2 final
+class GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) GpAudioBuffer_SDL2 final : public IGpAudioBuffer
 {
-	GpAudioChannelBufferChain_SDL2();
+public:
+	void AddRef() override;
+	void Release() override;
 
-	static GpAudioChannelBufferChain_SDL2 *Alloc();
-	void Release();
+	const uint8_t *GetData() const;
+	size_t GetSize() const override;
 
-	static const size_t kMaxCapacity = 65536;
+	static GpAudioBuffer_SDL2 *Create(const void *data, size_t size);
 
-	size_t m_consumed;
-	size_t m_used;
-	uint8_t m_data[kMaxCapacity];
-	GpAudioChannelBufferChain_SDL2 *m_next;
-	bool m_hasTrigger;
+private:
+	explicit GpAudioBuffer_SDL2(size_t size);
+	~GpAudioBuffer_SDL2();
+
+	static size_t AlignedSize();
+
+	SDL_atomic_t m_refCount;
+	size_t m_size;
 };
 
 class GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) GpAudioChannel_SDL2 final : public IGpAudioChannel
@@ -81,11 +129,13 @@ public:
 	void Release();
 
 	void SetAudioChannelContext(IGpAudioChannelCallbacks *callbacks) override;
-	void PostBuffer(const void *buffer, size_t bufferSize) override;
+	void PostBuffer(IGpAudioBuffer *buffer, size_t startOffset) override;
+	void SetPan(int32_t pan, int32_t maxPan) override;
 	void Stop() override;
 	void Destroy() override;
 
 	void Consume(uint8_t *output, size_t sz);
+	void GetPanGains(int16_t &outLeftGain, int16_t &outRightGain);
 
 	static GpAudioChannel_SDL2 *Alloc(GpAudioDriver_SDL2 *driver);
 
@@ -93,13 +143,24 @@ private:
 	bool Init(GpAudioDriver_SDL2 *driver);
 
 	IGpAudioChannelCallbacks *m_callbacks;
-	IGpMutex *m_mutex;
 	GpAudioDriver_SDL2 *m_owner;
 
 	SDL_atomic_t m_refCount;
 
-	GpAudioChannelBufferChain_SDL2 *m_firstPendingBuffer;
-	GpAudioChannelBufferChain_SDL2 *m_lastPendingBuffer;
+	// Consumed by the mixer, or by Stop while it holds the mixer lock
+	GpAudioBufferQueue m_pendingBuffers;
+	size_t m_frontBufferConsumed;
+
+	// Set when the mixer ran out of buffers, so the next buffer to start is a newly triggered sound
+	// rather than a continuation, and its latency gets measured.
+	bool m_isStarved;
+
+	// Resampler state, only touched by the mixer.  The history holds the last input samples of the previous
+	// chunk and the phase is the fractional input position of the next output frame.
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_resampleHistory[kResampleTaps];
+	uint32_t m_resamplePhase;
+
+	SDL_atomic_t m_panGains;
 
 	ChannelState m_channelState;
 };
@@ -109,11 +170,13 @@ class GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) GpAudioDriver_SDL2 final : public I
 public:
 	friend class GpAudioChannel_SDL2;
 
-	explicit GpAudioDriver_SDL2(const GpAudioDriverProperties &properties);
+	GpAudioDriver_SDL2(const GpAudioDriverProperties &properties, bool isOffline);
 	~GpAudioDriver_SDL2();
 
 	IGpAudioChannel *CreateChannel() override;
+	IGpAudioBuffer *CreateBuffer(const void *data, size_t size) override;
 	void SetMasterVolume(uint32_t vol, uint32_t maxVolume) override;
+	void ServeTicks(int tickCount) override;
 	void Shutdown() override;
 	IGpPrefsHandler *GetPrefsHandler() const override;
 
@@ -123,51 +186,194 @@ public:
 	bool Init();
 
 private:
+	bool OpenDevice();
+	void CloseDevice();
+	bool IsMixerThread() const;
+	void LockMixer();
+	void UnlockMixer();
+	bool WriteWaveHeader();
 	void DetachAudioChannel(GpAudioChannel_SDL2 *channel);
+	void PublishChannelList(int listIndex);
+	void RecordTriggerLatency(uint64_t postTime, size_t inputOffset);
+	uint64_t TicksToMicros(uint64_t ticks) const;
+	void LogStats() const;
+
+	static unsigned int ClampBufferFrames(uint32_t bufferFrames);
 
 	static void SDLCALL StaticMixAudio(void *userdata, Uint8 *stream, int len);
 
 	void MixAudio(void *stream, size_t len);
 	void RefillMixChunk(GpAudioChannel_SDL2 *const*channels, size_t numChannels);
+	void ResampleChannel(GpAudioChannel_SDL2 *channel);
 
 	GpAudioDriverProperties m_properties;
 	IGpMutex *m_mutex;
 	IGpMutex *m_mixState;
 
 	static const size_t kMaxChannels = 16;
-	static const size_t kMixChunkSize = 256;
-	static const int16_t kMaxAudioVolumeScale = 25;
+	static const size_t kOutputChannels = 2;
+	static const size_t kMixChunkSamples = kMixChunkSize * kOutputChannels;
+	static const size_t kMaxResampleInput = kMixChunkSize * (kResampleMaxStep >> 16) + 1;
 
-	GpAudioChannel_SDL2 *m_channels[kMaxChannels];
-	size_t m_numChannels;
+	struct ChannelList
+	{
+		GpAudioChannel_SDL2 *m_channels[kMaxChannels];
+		size_t m_numChannels;
+	};
+
+	// The mixer reads the active channel list without locking.  Changes are made to the other list under m_mutex,
+	// and once it's published, nothing is removed from or freed through the old list until the mixer is done with it.
+	ChannelList m_channelLists[2];
+	SDL_atomic_t m_activeChannelList;
 
+	SDL_AudioDeviceID m_deviceID;
+	bool m_sdlAudioInitialized;
 	bool m_sdlAudioRunning;
 
-	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_mixChunk[kMixChunkSize];
-	size_t m_mixChunkReadOffset;
+	unsigned int m_bufferFrames;	// Requested from the device
+	unsigned int m_deviceBufferFrames;	// Obtained from the device
+	unsigned int m_outputSampleRate;
+	uint32_t m_resampleStep;
+	size_t m_mixChunkFrames;	// Never more than the device buffer, so small buffers aren't held up by the mix chunk
+
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_resampleFilter[kResamplePhases * kResampleTaps];
+
+	// Mixer scratch.  The resampler input has the channel's history in front of the new samples.
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) uint8_t m_resampleInputBytes[kMaxResampleInput];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_resampleInput[kResampleTaps + kMaxResampleInput];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_resampledChunk[kMixChunkSize];
+
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_mixChunk[kMixChunkSamples];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int32_t m_mixAccumulator[kMixChunkSamples];
+	size_t m_mixChunkReadOffset;	// In samples
 
 	int16_t m_audioVolumeScale;
+
+	// Whichever thread last ran the mixer, or 0 while the device is closed
+	std::atomic<SDL_threadID> m_mixerThreadID;
+
+	// Offline rendering runs the mixer on ServeTicks and writes the mix to a WAV file instead of a device.
+	// The mix mutex stands in for the SDL audio lock.
+	bool m_isOffline;
+	IGpMutex *m_offlineMixMutex;
+	SDL_RWops *m_offlineFile;
+	uint64_t m_offlineFramesWritten;
+	uint32_t m_offlineTickRemainder;
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_offlineRenderBuffer[kOfflineRenderFrames * kOutputChannels];
+
+	// Instrumentation, only touched by the mixer while the device is open.  SDL doesn't report underruns,
+	// so they're estimated from callbacks that overrun their buffer or arrive more than a buffer late.
+	uint64_t m_perfFrequency;
+	uint64_t m_lastCallbackTime;
+	uint64_t m_mixChunkOutputTime;	// Estimated time that the current mix chunk starts playing
+	uint64_t m_numCallbacks;
+	uint64_t m_numUnderruns;
+	GpAudioTimingHistogram m_callbackTimes;
+	GpAudioTimingHistogram m_triggerLatencies;
 };
 
-GpAudioChannelBufferChain_SDL2::GpAudioChannelBufferChain_SDL2()
-	: m_used(0)
-	, m_consumed(0)
-	, m_next(nullptr)
-	, m_hasTrigger(false)
+/////////////////////////////////////////////////////////////////////////////////////////
+// Instrumentation
+
+void GpAudioTimingHistogram::Reset()
+{
+	for (size_t i = 0; i < kNumBuckets; i++)
+		m_buckets[i] = 0;
+
+	m_count = 0;
+	m_totalMicros = 0;
+	m_maxMicros = 0;
+}
+
+void GpAudioTimingHistogram::Add(uint64_t micros)
 {
+	size_t bucket = 0;
+	for (uint64_t limit = kFirstBucketLimit; micros >= limit && bucket < kNumBuckets - 1; limit *= 2)
+		bucket++;
+
+	m_buckets[bucket]++;
+	m_count++;
+	m_totalMicros += micros;
+	if (micros > m_maxMicros)
+		m_maxMicros = micros;
 }
 
+void GpAudioTimingHistogram::Log(IGpLogDriver *logger, const char *name) const
+{
+	if (m_count == 0)
+		return;
+
+	logger->Printf(IGpLogDriver::Category_Information, "%s: %llu samples, average %lluus, max %lluus", name,
+		static_cast<unsigned long long>(m_count), static_cast<unsigned long long>(m_totalMicros / m_count), static_cast<unsigned long long>(m_maxMicros));
+
+	uint64_t bucketMin = 0;
+	uint64_t bucketLimit = kFirstBucketLimit;
+	for (size_t i = 0; i < kNumBuckets; i++)
+	{
+		if (m_buckets[i] != 0)
+		{
+			if (i == kNumBuckets - 1)
+				logger->Printf(IGpLogDriver::Category_Information, "    %lluus+: %llu", static_cast<unsigned long long>(bucketMin), static_cast<unsigned long long>(m_buckets[i]));
+			else
+				logger->Printf(IGpLogDriver::Category_Information, "    %lluus-%lluus: %llu", static_cast<unsigned long long>(bucketMin), static_cast<unsigned long long>(bucketLimit - 1), static_cast<unsigned long long>(m_buckets[i]));
+		}
+
+		bucketMin = bucketLimit;
+		bucketLimit *= 2;
+	}
+}
 
-GpAudioChannelBufferChain_SDL2 *GpAudioChannelBufferChain_SDL2::Alloc()
+/////////////////////////////////////////////////////////////////////////////////////////
+// GpAudioBuffer
+
+GpAudioBuffer_SDL2::GpAudioBuffer_SDL2(size_t size)
+	: m_size(size)
 {
-	void *storage = AlignedAlloc(sizeof(GpAudioChannelBufferChain_SDL2), GP_SYSTEM_MEMORY_ALIGNMENT);
-	return new (storage) GpAudioChannelBufferChain_SDL2();
+	SDL_AtomicSet(&m_refCount, 1);
 }
 
-void GpAudioChannelBufferChain_SDL2::Release()
+GpAudioBuffer_SDL2::~GpAudioBuffer_SDL2()
 {
-	this->~GpAudioChannelBufferChain_SDL2();
-	AlignedFree(this);
+}
+
+void GpAudioBuffer_SDL2::AddRef()
+{
+	SDL_AtomicIncRef(&m_refCount);
+}
+
+void GpAudioBuffer_SDL2::Release()
+{
+	if (SDL_AtomicDecRef(&m_refCount))
+	{
+		this->~GpAudioBuffer_SDL2();
+		AlignedFree(this);
+	}
+}
+
+const uint8_t *GpAudioBuffer_SDL2::GetData() const
+{
+	return reinterpret_cast<const uint8_t*>(this) + AlignedSize();
+}
+
+size_t GpAudioBuffer_SDL2::GetSize() const
+{
+	return m_size;
+}
+
+size_t GpAudioBuffer_SDL2::AlignedSize()
+{
+	return (sizeof(GpAudioBuffer_SDL2) + GP_SYSTEM_MEMORY_ALIGNMENT - 1) / GP_SYSTEM_MEMORY_ALIGNMENT * GP_SYSTEM_MEMORY_ALIGNMENT;
+}
+
+GpAudioBuffer_SDL2 *GpAudioBuffer_SDL2::Create(const void *data, size_t size)
+{
+	void *storage = AlignedAlloc(AlignedSize() + size, GP_SYSTEM_MEMORY_ALIGNMENT);
+	if (!storage)
+		return nullptr;
+
+	memcpy(static_cast<uint8_t*>(storage) + AlignedSize(), data, size);
+
+	return new (storage) GpAudioBuffer_SDL2(size);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -175,27 +381,22 @@ void GpAudioChannelBufferChain_SDL2::Release()
 
 GpAudioChannel_SDL2::GpAudioChannel_SDL2()
 	: m_callbacks(nullptr)
-	, m_mutex(nullptr)
 	, m_owner(nullptr)
-	, m_firstPendingBuffer(nullptr)
-	, m_lastPendingBuffer(nullptr)
+	, m_frontBufferConsumed(0)
+	, m_isStarved(true)
+	, m_resamplePhase(0)
 {
 	SDL_AtomicSet(&m_refCount, 1);
+
+	for (unsigned int i = 0; i < kResampleTaps; i++)
+		m_resampleHistory[i] = 0;
+
+	SetPan(0, 1);
 }
 
 GpAudioChannel_SDL2::~GpAudioChannel_SDL2()
 {
 	Stop();
-
-	if (m_mutex)
-		m_mutex->Destroy();
-
-	while (m_firstPendingBuffer)
-	{
-		GpAudioChannelBufferChain_SDL2 *buffer = m_firstPendingBuffer;
-		m_firstPendingBuffer = buffer->m_next;
-		buffer->Release();
-	}
 }
 
 void GpAudioChannel_SDL2::AddRef()
@@ -218,57 +419,58 @@ void GpAudioChannel_SDL2::SetAudioChannelContext(IGpAudioChannelCallbacks *callb
 	m_callbacks = callbacks;
 }
 
-void GpAudioChannel_SDL2::PostBuffer(const void *buffer, size_t bufferSize)
+void GpAudioChannel_SDL2::PostBuffer(IGpAudioBuffer *buffer, size_t startOffset)
 {
-	m_mutex->Lock();
+	// Reposts from NotifyBufferFinished on the mixer thread get their own lane, so the mixer never waits on a poster
+	const GpAudioBufferQueue::Lane lane = m_owner->IsMixerThread() ? GpAudioBufferQueue::Lane_Mixer : GpAudioBufferQueue::Lane_Other;
+	const size_t clampedStartOffset = (startOffset < buffer->GetSize()) ? startOffset : buffer->GetSize();
 
-	while (bufferSize > 0)
+	if (!m_pendingBuffers.Push(lane, buffer, clampedStartOffset, SDL_GetPerformanceCounter()))
 	{
-		GpAudioChannelBufferChain_SDL2 *newBuffer = GpAudioChannelBufferChain_SDL2::Alloc();
-		if (newBuffer == nullptr)
-			break;
-
-		if (m_lastPendingBuffer == nullptr)
-			m_firstPendingBuffer = newBuffer;
-		else
-			m_lastPendingBuffer->m_next = newBuffer;
-		m_lastPendingBuffer = newBuffer;
+		// Queue is full, drop the buffer but still let the poster know that it's done
+		if (m_callbacks)
+			m_callbacks->NotifyBufferFinished();
+	}
+}
 
-		size_t bufferable = newBuffer->kMaxCapacity;
-		if (bufferSize < bufferable)
-			bufferable = bufferSize;
+void GpAudioChannel_SDL2::SetPan(int32_t pan, int32_t maxPan)
+{
+	int16_t leftGain = 0;
+	int16_t rightGain = 0;
+	GpAudioMixKernels::ComputePanGains(pan, maxPan, leftGain, rightGain);
 
-		memcpy(newBuffer->m_data, buffer, bufferable);
+	SDL_AtomicSet(&m_panGains, (static_cast<int>(leftGain) << 16) | static_cast<uint16_t>(rightGain));
+}
 
-		buffer = static_cast<const uint8_t*>(buffer) + bufferable;
-		bufferSize -= bufferable;
-		m_lastPendingBuffer->m_used = bufferable;
-		m_lastPendingBuffer->m_hasTrigger = (bufferSize == 0);
-	}
+void GpAudioChannel_SDL2::GetPanGains(int16_t &outLeftGain, int16_t &outRightGain)
+{
+	const int gains = SDL_AtomicGet(&m_panGains);
 
-	m_mutex->Unlock();
+	outLeftGain = static_cast<int16_t>((gains >> 16) & 0xffff);
+	outRightGain = static_cast<int16_t>(gains & 0xffff);
 }
 
 void GpAudioChannel_SDL2::Stop()
 {
-	m_mutex->Lock();
+	// Take the mixer's place as the consumer for the duration of the flush.  The SDL audio lock is held by SDL
+	// around the mix callback anyway, so this doesn't add any locking to the mixer path.
+	m_owner->LockMixer();
 
-	GpAudioChannelBufferChain_SDL2 *buffer = m_firstPendingBuffer;
-	m_firstPendingBuffer = nullptr;
-	m_lastPendingBuffer = nullptr;
+	IGpAudioBuffer *flushedBuffers[GpAudioBufferQueue::kCapacity];
+	const size_t numFlushed = m_pendingBuffers.Flush(flushedBuffers);
 
-	while (buffer)
-	{
-		if (buffer->m_hasTrigger && m_callbacks)
-			m_callbacks->NotifyBufferFinished();
+	m_frontBufferConsumed = 0;
+	m_isStarved = true;
 
-		GpAudioChannelBufferChain_SDL2 *nextBuffer = buffer->m_next;
-		buffer->Release();
+	m_owner->UnlockMixer();
 
-		buffer = nextBuffer;
-	}
+	for (size_t i = 0; i < numFlushed; i++)
+	{
+		flushedBuffers[i]->Release();
 
-	m_mutex->Unlock();
+		if (m_callbacks)
+			m_callbacks->NotifyBufferFinished();
+	}
 }
 
 void GpAudioChannel_SDL2::Destroy()
@@ -282,52 +484,59 @@ void GpAudioChannel_SDL2::Destroy()
 bool GpAudioChannel_SDL2::Init(GpAudioDriver_SDL2 *driver)
 {
 	m_owner = driver;
-	m_mutex = driver->m_properties.m_systemServices->CreateRecursiveMutex();
-	if (!m_mutex)
-		return false;
 
 	return true;
 }
 
 void GpAudioChannel_SDL2::Consume(uint8_t *output, size_t sz)
 {
-	m_mutex->Lock();
+	const size_t requested = sz;
 
-	while (m_firstPendingBuffer != nullptr)
+	while (sz > 0)
 	{
-		GpAudioChannelBufferChain_SDL2 *buffer = m_firstPendingBuffer;
-		const size_t available = (buffer->m_used - buffer->m_consumed);
+		const GpAudioBufferQueue::Entry *entry = m_pendingBuffers.Front();
+		if (!entry)
+			break;
+
+		GpAudioBuffer_SDL2 *buffer = static_cast<GpAudioBuffer_SDL2*>(entry->m_buffer);
+		if (m_isStarved)
+		{
+			m_owner->RecordTriggerLatency(entry->m_postTime, requested - sz);
+			m_isStarved = false;
+		}
+
+		const size_t position = entry->m_startOffset + m_frontBufferConsumed;
+		const size_t available = buffer->GetSize() - position;
 		if (available <= sz)
 		{
-			memcpy(output, buffer->m_data + buffer->m_consumed, available);
+			memcpy(output, buffer->GetData() + position, available);
 			sz -= available;
 			output += available;
 
-			m_firstPendingBuffer = buffer->m_next;
-			if (m_firstPendingBuffer == nullptr)
-				m_lastPendingBuffer = nullptr;
-
-			if (buffer->m_hasTrigger && m_callbacks)
-				m_callbacks->NotifyBufferFinished();
+			m_frontBufferConsumed = 0;
+			m_pendingBuffers.PopFront();
 
+			// The poster normally still holds a reference, so this rarely frees anything
 			buffer->Release();
 
-			if (sz == 0)
-				break;
+			// This may post the next buffer, which will be picked up on the next iteration
+			if (m_callbacks)
+				m_callbacks->NotifyBufferFinished();
 		}
 		else
 		{
-			memcpy(output, buffer->m_data + buffer->m_consumed, sz);
-			buffer->m_consumed += sz;
-			buffer += sz;
+			memcpy(output, buffer->GetData() + position, sz);
+			m_frontBufferConsumed += sz;
+			output += sz;
 			sz = 0;
-			break;
 		}
 	}
 
-	m_mutex->Unlock();
-
-	memset(output, 0x80, sz);
+	if (sz > 0)
+	{
+		memset(output, 0x80, sz);
+		m_isStarved = true;
+	}
 }
 
 GpAudioChannel_SDL2 *GpAudioChannel_SDL2::Alloc(GpAudioDriver_SDL2 *driver)
@@ -350,26 +559,57 @@ GpAudioChannel_SDL2 *GpAudioChannel_SDL2::Alloc(GpAudioDriver_SDL2 *driver)
 /////////////////////////////////////////////////////////////////////////////////////////
 // GpAudioDriver_SDL2
 
-GpAudioDriver_SDL2::GpAudioDriver_SDL2(const GpAudioDriverProperties &properties)
+GpAudioDriver_SDL2::GpAudioDriver_SDL2(const GpAudioDriverProperties &properties, bool isOffline)
 	: m_properties(properties)
 	, m_mutex(nullptr)
-	, m_numChannels(0)
+	, m_deviceID(0)
+	, m_sdlAudioInitialized(false)
 	, m_sdlAudioRunning(false)
-	, m_mixChunkReadOffset(kMixChunkSize)
+	, m_bufferFrames(kDefaultBufferFrames)
+	, m_deviceBufferFrames(0)
+	, m_outputSampleRate(0)
+	, m_resampleStep(0x10000)
+	, m_mixChunkFrames(kMixChunkSize)
+	, m_mixChunkReadOffset(kMixChunkSamples)
 	, m_audioVolumeScale(kMaxAudioVolumeScale)
-
+	, m_mixerThreadID(0)
+	, m_isOffline(isOffline)
+	, m_offlineMixMutex(nullptr)
+	, m_offlineFile(nullptr)
+	, m_offlineFramesWritten(0)
+	, m_offlineTickRemainder(0)
+	, m_perfFrequency(SDL_GetPerformanceFrequency())
+	, m_lastCallbackTime(0)
+	, m_mixChunkOutputTime(0)
+	, m_numCallbacks(0)
+	, m_numUnderruns(0)
 {
-	for (size_t i = 0; i < kMaxChannels; i++)
-		m_channels[i] = nullptr;
+	for (size_t list = 0; list < 2; list++)
+	{
+		for (size_t i = 0; i < kMaxChannels; i++)
+			m_channelLists[list].m_channels[i] = nullptr;
 
-	for (size_t i = 0; i < kMixChunkSize; i++)
+		m_channelLists[list].m_numChannels = 0;
+	}
+
+	SDL_AtomicSet(&m_activeChannelList, 0);
+
+	for (size_t i = 0; i < kMixChunkSamples; i++)
 		m_mixChunk[i] = 0;
+
+	m_callbackTimes.Reset();
+	m_triggerLatencies.Reset();
 }
 
 GpAudioDriver_SDL2::~GpAudioDriver_SDL2()
 {
-	if (m_sdlAudioRunning)
-		SDL_CloseAudio();
+	CloseDevice();
+
+	if (m_sdlAudioInitialized)
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+
+	if (m_offlineMixMutex)
+		m_offlineMixMutex->Destroy();
 
 	if (m_mutex)
 		m_mutex->Destroy();
@@ -382,21 +622,32 @@ IGpAudioChannel *GpAudioDriver_SDL2::CreateChannel()
 		return nullptr;
 
 	m_mutex->Lock();
-	if (m_numChannels == kMaxChannels)
+
+	const int activeList = SDL_AtomicGet(&m_activeChannelList);
+	if (m_channelLists[activeList].m_numChannels == kMaxChannels)
 	{
-		newChannel->Destroy();
 		m_mutex->Unlock();
+		newChannel->Destroy();
 		return nullptr;
 	}
 
-	m_channels[m_numChannels] = newChannel;
-	m_numChannels++;
+	ChannelList &newList = m_channelLists[1 - activeList];
+	newList = m_channelLists[activeList];
+	newList.m_channels[newList.m_numChannels] = newChannel;
+	newList.m_numChannels++;
+
+	PublishChannelList(1 - activeList);
 
 	m_mutex->Unlock();
 
 	return newChannel;
 }
 
+IGpAudioBuffer *GpAudioDriver_SDL2::CreateBuffer(const void *data, size_t size)
+{
+	return GpAudioBuffer_SDL2::Create(data, size);
+}
+
 void GpAudioDriver_SDL2::SetMasterVolume(uint32_t vol, uint32_t maxVolume)
 {
 	double scale = vol * static_cast<uint64_t>(kMaxAudioVolumeScale) / maxVolume;
@@ -404,6 +655,43 @@ void GpAudioDriver_SDL2::SetMasterVolume(uint32_t vol, uint32_t maxVolume)
 	m_audioVolumeScale = static_cast<int16_t>(scale);
 }
 
+void GpAudioDriver_SDL2::ServeTicks(int tickCount)
+{
+	if (!m_offlineFile || tickCount <= 0)
+		return;
+
+	// Ticks are 1/60 of a second, and the leftover fraction of a frame carries over to the next call
+	const uint64_t tickFrames = static_cast<uint64_t>(tickCount) * m_outputSampleRate + m_offlineTickRemainder;
+	uint64_t framesRemaining = tickFrames / 60;
+	m_offlineTickRemainder = static_cast<uint32_t>(tickFrames % 60);
+
+	while (framesRemaining > 0)
+	{
+		const size_t numFrames = (framesRemaining < kOfflineRenderFrames) ? static_cast<size_t>(framesRemaining) : kOfflineRenderFrames;
+		const size_t numSamples = numFrames * kOutputChannels;
+
+		LockMixer();
+		MixAudio(m_offlineRenderBuffer, numSamples * sizeof(int16_t));
+		UnlockMixer();
+
+		// WAV data is little-endian
+		for (size_t i = 0; i < numSamples; i++)
+			m_offlineRenderBuffer[i] = static_cast<int16_t>(SDL_SwapLE16(static_cast<Uint16>(m_offlineRenderBuffer[i])));
+
+		if (SDL_RWwrite(m_offlineFile, m_offlineRenderBuffer, sizeof(int16_t), numSamples) != numSamples)
+		{
+			if (m_properties.m_logger)
+				m_properties.m_logger->Printf(IGpLogDriver::Category_Error, "Audio: Failed to write offline render, stopping");
+
+			CloseDevice();
+			return;
+		}
+
+		m_offlineFramesWritten += numFrames;
+		framesRemaining -= numFrames;
+	}
+}
+
 void GpAudioDriver_SDL2::Shutdown()
 {
 	this->~GpAudioDriver_SDL2();
@@ -417,11 +705,32 @@ IGpPrefsHandler *GpAudioDriver_SDL2::GetPrefsHandler() const
 
 void GpAudioDriver_SDL2::ApplyPrefs(const void *identifier, size_t identifierSize, const void *contents, size_t contentsSize, uint32_t version)
 {
+	if (version == kPrefsVersion && identifierSize == strlen(kPrefsIdentifier) && !memcmp(identifier, kPrefsIdentifier, identifierSize) && contentsSize == sizeof(GpAudioDriver_SDL2_Prefs))
+	{
+		const GpAudioDriver_SDL2_Prefs *prefs = static_cast<const GpAudioDriver_SDL2_Prefs *>(contents);
+
+		const unsigned int bufferFrames = ClampBufferFrames(prefs->m_bufferFrames);
+		if (bufferFrames == m_bufferFrames)
+			return;
+
+		m_bufferFrames = bufferFrames;
+
+		// The device was opened with the default size before prefs were loaded, so reopen it
+		if (m_sdlAudioRunning)
+		{
+			CloseDevice();
+			if (!OpenDevice() && m_properties.m_logger)
+				m_properties.m_logger->Printf(IGpLogDriver::Category_Error, "Audio: Failed to reopen device with %u frame buffer", bufferFrames);
+		}
+	}
 }
 
 bool GpAudioDriver_SDL2::SavePrefs(void *context, WritePrefsFunc_t writeFunc)
 {
-	return true;
+	GpAudioDriver_SDL2_Prefs prefs;
+	prefs.m_bufferFrames = m_bufferFrames;
+
+	return writeFunc(context, kPrefsIdentifier, strlen(kPrefsIdentifier), &prefs, sizeof(prefs), kPrefsVersion);
 }
 
 bool GpAudioDriver_SDL2::Init()
@@ -430,47 +739,269 @@ bool GpAudioDriver_SDL2::Init()
 	if (!m_mutex)
 		return false;
 
-	SDL_AudioSpec requestedSpec;
-	memset(&requestedSpec, 0, sizeof(requestedSpec));
+	if (m_isOffline)
+	{
+		m_offlineMixMutex = m_properties.m_systemServices->CreateRecursiveMutex();
+		if (!m_offlineMixMutex)
+			return false;
+	}
+	else
+	{
+		// Unlike SDL_OpenAudio, SDL_OpenAudioDevice doesn't start the audio subsystem by itself
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+			return false;
+
+		m_sdlAudioInitialized = true;
+	}
+
+	if (!OpenDevice())
+		return false;
+
+	return true;
+}
+
+bool GpAudioDriver_SDL2::OpenDevice()
+{
+	if (m_isOffline)
+	{
+		if (!m_properties.m_renderPath)
+			return false;
+
+		m_offlineFile = SDL_RWFromFile(m_properties.m_renderPath, "wb");
+		if (!m_offlineFile)
+			return false;
 
-	requestedSpec.callback = GpAudioDriver_SDL2::StaticMixAudio;
-	requestedSpec.channels = 1;
-	requestedSpec.format = AUDIO_S16;
-	requestedSpec.freq = m_properties.m_sampleRate;
-	requestedSpec.samples = 512;
-	requestedSpec.userdata = this;
+		m_outputSampleRate = kOfflineSampleRate;
+		m_deviceBufferFrames = kOfflineRenderFrames;
+		m_offlineFramesWritten = 0;
+		m_offlineTickRemainder = 0;
 
-	if (SDL_OpenAudio(&requestedSpec, nullptr))
+		// Written again with the final size when the render is closed
+		if (!WriteWaveHeader())
+			return false;
+	}
+	else
 	{
-		requestedSpec.freq = 22050;
-		if (SDL_OpenAudio(&requestedSpec, nullptr))
+		SDL_AudioSpec requestedSpec;
+		memset(&requestedSpec, 0, sizeof(requestedSpec));
+
+		// Mixing happens at the device's own rate so SDL doesn't have to convert.  Only the rate is allowed to change,
+		// since the mixer always produces signed 16-bit stereo.
+		requestedSpec.callback = GpAudioDriver_SDL2::StaticMixAudio;
+		requestedSpec.channels = kOutputChannels;
+		requestedSpec.format = AUDIO_S16SYS;
+		requestedSpec.freq = 48000;
+		requestedSpec.samples = static_cast<Uint16>(m_bufferFrames);
+		requestedSpec.userdata = this;
+
+		SDL_AudioSpec obtainedSpec;
+		memset(&obtainedSpec, 0, sizeof(obtainedSpec));
+
+		m_deviceID = SDL_OpenAudioDevice(nullptr, 0, &requestedSpec, &obtainedSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+		if (m_deviceID == 0)
 			return false;
+
+		m_sdlAudioRunning = true;
+
+		m_outputSampleRate = static_cast<unsigned int>(obtainedSpec.freq);
+		m_deviceBufferFrames = obtainedSpec.samples;
 	}
 
-	SDL_PauseAudio(0);
+	const unsigned int contentSampleRate = m_properties.m_sampleRate;
+	m_resampleStep = static_cast<uint32_t>((static_cast<uint64_t>(contentSampleRate) << 16) / m_outputSampleRate);
+	if (m_resampleStep == 0 || m_resampleStep > kResampleMaxStep)
+		return false;
+
+	GpAudioMixKernels::BuildResampleFilter(m_resampleFilter, contentSampleRate, m_outputSampleRate);
+
+	// The mixer works in multiples of 16 frames
+	m_mixChunkFrames = kMixChunkSize;
+	if (m_deviceBufferFrames < kMixChunkSize)
+		m_mixChunkFrames = (m_deviceBufferFrames < 16) ? 16 : (m_deviceBufferFrames & ~static_cast<unsigned int>(15));
 
-	m_sdlAudioRunning = true;
+	m_mixChunkReadOffset = m_mixChunkFrames * kOutputChannels;
+	m_lastCallbackTime = 0;
+
+	if (m_isOffline)
+	{
+		if (m_properties.m_logger)
+			m_properties.m_logger->Printf(IGpLogDriver::Category_Information, "Audio: Rendering offline at %u Hz to %s", m_outputSampleRate, m_properties.m_renderPath);
+	}
+	else
+	{
+		if (m_properties.m_logger)
+			m_properties.m_logger->Printf(IGpLogDriver::Category_Information, "Audio: Opened device at %u Hz with %u frame buffer (requested %u)", m_outputSampleRate, m_deviceBufferFrames, m_bufferFrames);
+
+		SDL_PauseAudioDevice(m_deviceID, 0);
+	}
 
 	return true;
 }
 
+void GpAudioDriver_SDL2::CloseDevice()
+{
+	if (m_sdlAudioRunning)
+	{
+		SDL_CloseAudioDevice(m_deviceID);
+		m_deviceID = 0;
+		m_sdlAudioRunning = false;
+	}
+	else if (m_offlineFile)
+	{
+		WriteWaveHeader();
+		SDL_RWclose(m_offlineFile);
+		m_offlineFile = nullptr;
+
+		if (m_properties.m_logger)
+			m_properties.m_logger->Printf(IGpLogDriver::Category_Information, "Audio: Rendered %llu frames offline", static_cast<unsigned long long>(m_offlineFramesWritten));
+	}
+	else
+		return;
+
+	// The mixer thread is gone, so its ID may be reused by a thread that isn't the mixer
+	m_mixerThreadID.store(0, std::memory_order_relaxed);
+
+	LogStats();
+
+	m_numCallbacks = 0;
+	m_numUnderruns = 0;
+	m_callbackTimes.Reset();
+	m_triggerLatencies.Reset();
+}
+
+bool GpAudioDriver_SDL2::IsMixerThread() const
+{
+	return m_mixerThreadID.load(std::memory_order_relaxed) == SDL_ThreadID();
+}
+
+void GpAudioDriver_SDL2::LockMixer()
+{
+	if (m_isOffline)
+		m_offlineMixMutex->Lock();
+	else
+		SDL_LockAudioDevice(m_deviceID);
+}
+
+void GpAudioDriver_SDL2::UnlockMixer()
+{
+	if (m_isOffline)
+		m_offlineMixMutex->Unlock();
+	else
+		SDL_UnlockAudioDevice(m_deviceID);
+}
+
+// 16-bit stereo PCM.  Rewrites the header at the start of the file and returns to the end.
+bool GpAudioDriver_SDL2::WriteWaveHeader()
+{
+	const uint32_t kBytesPerFrame = static_cast<uint32_t>(kOutputChannels * sizeof(int16_t));
+	const uint64_t dataSize = m_offlineFramesWritten * kBytesPerFrame;
+	const uint32_t clampedDataSize = (dataSize > 0xffffffffu - 36) ? (0xffffffffu - 36) : static_cast<uint32_t>(dataSize);
+
+	if (SDL_RWseek(m_offlineFile, 0, RW_SEEK_SET) < 0)
+		return false;
+
+	bool succeeded = true;
+	succeeded &= (SDL_RWwrite(m_offlineFile, "RIFF", 1, 4) == 4);
+	succeeded &= (SDL_WriteLE32(m_offlineFile, clampedDataSize + 36) == 1);
+	succeeded &= (SDL_RWwrite(m_offlineFile, "WAVEfmt ", 1, 8) == 8);
+	succeeded &= (SDL_WriteLE32(m_offlineFile, 16) == 1);
+	succeeded &= (SDL_WriteLE16(m_offlineFile, 1) == 1);	// PCM
+	succeeded &= (SDL_WriteLE16(m_offlineFile, kOutputChannels) == 1);
+	succeeded &= (SDL_WriteLE32(m_offlineFile, m_outputSampleRate) == 1);
+	succeeded &= (SDL_WriteLE32(m_offlineFile, m_outputSampleRate * kBytesPerFrame) == 1);
+	succeeded &= (SDL_WriteLE16(m_offlineFile, kBytesPerFrame) == 1);
+	succeeded &= (SDL_WriteLE16(m_offlineFile, 16) == 1);
+	succeeded &= (SDL_RWwrite(m_offlineFile, "data", 1, 4) == 4);
+	succeeded &= (SDL_WriteLE32(m_offlineFile, clampedDataSize) == 1);
+
+	if (SDL_RWseek(m_offlineFile, 0, RW_SEEK_END) < 0)
+		return false;
+
+	return succeeded;
+}
+
+unsigned int GpAudioDriver_SDL2::ClampBufferFrames(uint32_t bufferFrames)
+{
+	if (bufferFrames < kMinBufferFrames)
+		return kMinBufferFrames;
+	if (bufferFrames > kMaxBufferFrames)
+		return kMaxBufferFrames;
+
+	unsigned int powerOfTwo = kMinBufferFrames;
+	while (powerOfTwo * 2 <= bufferFrames)
+		powerOfTwo *= 2;
+
+	return powerOfTwo;
+}
+
+uint64_t GpAudioDriver_SDL2::TicksToMicros(uint64_t ticks) const
+{
+	return ticks * 1000000 / m_perfFrequency;
+}
+
+// Called by a channel when it starts a buffer after being starved.  The input offset is how far into the
+// mix chunk the buffer starts, in content samples.
+void GpAudioDriver_SDL2::RecordTriggerLatency(uint64_t postTime, size_t inputOffset)
+{
+	// Offline output time has nothing to do with the wall clock
+	if (m_isOffline)
+		return;
+
+	const uint64_t outputOffset = (static_cast<uint64_t>(inputOffset) << 16) / m_resampleStep;
+	const uint64_t outputTime = m_mixChunkOutputTime + outputOffset * m_perfFrequency / m_outputSampleRate;
+
+	m_triggerLatencies.Add((outputTime > postTime) ? TicksToMicros(outputTime - postTime) : 0);
+}
+
+void GpAudioDriver_SDL2::LogStats() const
+{
+	IGpLogDriver *logger = m_properties.m_logger;
+	if (!logger || m_numCallbacks == 0)
+		return;
+
+	logger->Printf(IGpLogDriver::Category_Information, "Audio: %llu callbacks, %llu estimated underruns",
+		static_cast<unsigned long long>(m_numCallbacks), static_cast<unsigned long long>(m_numUnderruns));
+
+	m_callbackTimes.Log(logger, "Audio: Callback duration");
+	m_triggerLatencies.Log(logger, "Audio: Trigger-to-output latency");
+}
+
 void GpAudioDriver_SDL2::DetachAudioChannel(GpAudioChannel_SDL2 *channel)
 {
 	m_mutex->Lock();
-	const size_t numChannels = m_numChannels;
+
+	const int activeList = SDL_AtomicGet(&m_activeChannelList);
+	ChannelList &newList = m_channelLists[1 - activeList];
+	newList = m_channelLists[activeList];
+
+	const size_t numChannels = newList.m_numChannels;
 	for (size_t i = 0; i < numChannels; i++)
 	{
-		if (m_channels[i] == channel)
+		if (newList.m_channels[i] == channel)
 		{
-			m_numChannels = numChannels - 1;
-			m_channels[i] = m_channels[numChannels - 1];
-			m_channels[numChannels - 1] = nullptr;
+			newList.m_numChannels = numChannels - 1;
+			newList.m_channels[i] = newList.m_channels[numChannels - 1];
+			newList.m_channels[numChannels - 1] = nullptr;
+
+			// Once this returns, the mixer no longer touches the channel, so it can be freed
+			PublishChannelList(1 - activeList);
 			break;
 		}
 	}
+
 	m_mutex->Unlock();
 }
 
+void GpAudioDriver_SDL2::PublishChannelList(int listIndex)
+{
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&m_activeChannelList, listIndex);
+
+	// The mixer holds the mixer lock for a whole mix, so this waits out any mix that's still using the old list
+	LockMixer();
+	UnlockMixer();
+}
+
 void GpAudioDriver_SDL2::StaticMixAudio(void *userdata, Uint8 *stream, int len)
 {
 	static_cast<GpAudioDriver_SDL2*>(userdata)->MixAudio(stream, static_cast<size_t>(len));
@@ -478,30 +1009,29 @@ void GpAudioDriver_SDL2::StaticMixAudio(void *userdata, Uint8 *stream, int len)
 
 void GpAudioDriver_SDL2::MixAudio(void *stream, size_t len)
 {
-	GpAudioChannel_SDL2 *mixingChannels[kMaxChannels];
-	size_t numChannels = 0;
+	m_mixerThreadID.store(SDL_ThreadID(), std::memory_order_relaxed);
 
-	m_mutex->Lock();
-	numChannels = m_numChannels;
-	for (size_t i = 0; i < numChannels; i++)
-	{
-		GpAudioChannel_SDL2 *channel = m_channels[i];
-		channel->AddRef();
+	const ChannelList &channelList = m_channelLists[SDL_AtomicGet(&m_activeChannelList)];
+	SDL_MemoryBarrierAcquire();
 
-		mixingChannels[i] = channel;
-	}
-	m_mutex->Unlock();
+	const uint64_t callbackStartTime = SDL_GetPerformanceCounter();
+	const uint64_t bufferTicks = static_cast<uint64_t>(m_deviceBufferFrames) * m_perfFrequency / m_outputSampleRate;
 
-	size_t samplesRemaining = len / sizeof(int16_t);
+	bool underran = (!m_isOffline && m_lastCallbackTime != 0 && callbackStartTime - m_lastCallbackTime > bufferTicks * 2);
+	m_lastCallbackTime = callbackStartTime;
+
+	const size_t mixChunkSamples = m_mixChunkFrames * kOutputChannels;
+	const size_t totalSamples = len / sizeof(int16_t);
+	size_t samplesRemaining = totalSamples;
 
 	for (;;)
 	{
-		size_t availableInMixChunk = kMixChunkSize - m_mixChunkReadOffset;
+		size_t availableInMixChunk = mixChunkSamples - m_mixChunkReadOffset;
 
 		if (availableInMixChunk > samplesRemaining)
 		{
-			m_mixChunkReadOffset += samplesRemaining;
 			memcpy(stream, m_mixChunk + m_mixChunkReadOffset, samplesRemaining * sizeof(int16_t));
+			m_mixChunkReadOffset += samplesRemaining;
 
 			break;
 		}
@@ -512,59 +1042,85 @@ void GpAudioDriver_SDL2::MixAudio(void *stream, size_t len)
 			stream = static_cast<int16_t*>(stream) + availableInMixChunk;
 			samplesRemaining -= availableInMixChunk;
 
+			// What's written in this callback plays after what's already queued in the device
+			const uint64_t outputFrame = m_deviceBufferFrames + (totalSamples - samplesRemaining) / kOutputChannels;
+			m_mixChunkOutputTime = callbackStartTime + outputFrame * m_perfFrequency / m_outputSampleRate;
+
 			m_mixChunkReadOffset = 0;
-			RefillMixChunk(mixingChannels, numChannels);
+			RefillMixChunk(channelList.m_channels, channelList.m_numChannels);
 		}
 	}
 
-	for (size_t i = 0; i < numChannels; i++)
-		mixingChannels[i]->Release();
+	const uint64_t callbackTicks = SDL_GetPerformanceCounter() - callbackStartTime;
+	if (!m_isOffline && callbackTicks > bufferTicks)
+		underran = true;
+
+	m_callbackTimes.Add(TicksToMicros(callbackTicks));
+	m_numCallbacks++;
+	if (underran)
+		m_numUnderruns++;
 }
 
 void GpAudioDriver_SDL2::RefillMixChunk(GpAudioChannel_SDL2 *const*channels, size_t numChannels)
 {
-	uint8_t audioMixBufferUnaligned[kMixChunkSize + GP_SYSTEM_MEMORY_ALIGNMENT];
-	uint8_t *audioMixBuffer = audioMixBufferUnaligned;
+	const size_t mixChunkSamples = m_mixChunkFrames * kOutputChannels;
 
+	if (numChannels == 0)
 	{
-		uintptr_t bufferPtr = reinterpret_cast<uintptr_t>(audioMixBuffer);
-		size_t alignPadding = GP_SYSTEM_MEMORY_ALIGNMENT - (bufferPtr % GP_SYSTEM_MEMORY_ALIGNMENT);
-		audioMixBuffer += alignPadding;
+		memset(m_mixChunk, 0, mixChunkSamples * sizeof(m_mixChunk[0]));
+		return;
 	}
 
-	bool noAudio = true;
+	GP_STATIC_ASSERT(kMixChunkSize % 16 == 0);
 
 	const int16_t audioVolumeScale = m_audioVolumeScale;
 
+	memset(m_mixAccumulator, 0, mixChunkSamples * sizeof(m_mixAccumulator[0]));
+
 	for (size_t i = 0; i < numChannels; i++)
 	{
-		channels[i]->Consume(audioMixBuffer, kMixChunkSize);
+		GpAudioChannel_SDL2 *channel = channels[i];
 
-		if (i == 0)
-		{
-			noAudio = false;
-			for (size_t j = 0; j < kMixChunkSize; j++)
-				m_mixChunk[j] = (static_cast<int16_t>(audioMixBuffer[j]) - 0x80) * audioVolumeScale;
-		}
-		else
-		{
-			for (size_t j = 0; j < kMixChunkSize; j++)
-				m_mixChunk[j] += (static_cast<int16_t>(audioMixBuffer[j]) - 0x80) * audioVolumeScale;
-		}
+		ResampleChannel(channel);
+
+		int16_t leftPanGain = 0;
+		int16_t rightPanGain = 0;
+		channel->GetPanGains(leftPanGain, rightPanGain);
+
+		const int16_t leftGain = GpAudioMixKernels::ComputeMixGain(audioVolumeScale, leftPanGain);
+		const int16_t rightGain = GpAudioMixKernels::ComputeMixGain(audioVolumeScale, rightPanGain);
+
+		GpAudioMixKernels::AccumulatePannedSamples(m_mixAccumulator, m_resampledChunk, leftGain, rightGain, m_mixChunkFrames);
 	}
 
-	if (noAudio)
-		memset(m_mixChunk, 0, kMixChunkSize * sizeof(m_mixChunk[0]));
+	GpAudioMixKernels::PackMixSamples(m_mixChunk, m_mixAccumulator, mixChunkSamples);
 }
 
+void GpAudioDriver_SDL2::ResampleChannel(GpAudioChannel_SDL2 *channel)
+{
+	const uint32_t endPosition = channel->m_resamplePhase + static_cast<uint32_t>(m_mixChunkFrames) * m_resampleStep;
+	const size_t numInputSamples = GpAudioMixKernels::ResampleInputSamples(channel->m_resamplePhase, m_mixChunkFrames, m_resampleStep);
 
-IGpAudioDriver *GpDriver_CreateAudioDriver_SDL(const GpAudioDriverProperties &properties)
+	channel->Consume(m_resampleInputBytes, numInputSamples);
+
+	int16_t *newInput = m_resampleInput + kResampleTaps;
+	memcpy(m_resampleInput, channel->m_resampleHistory, sizeof(channel->m_resampleHistory));
+	for (size_t i = 0; i < numInputSamples; i++)
+		newInput[i] = static_cast<int16_t>(static_cast<int>(m_resampleInputBytes[i]) - 0x80);
+
+	GpAudioMixKernels::Resample(m_resampledChunk, m_resampleInput, m_mixChunkFrames, channel->m_resamplePhase, m_resampleStep, m_resampleFilter);
+
+	memcpy(channel->m_resampleHistory, m_resampleInput + numInputSamples, sizeof(channel->m_resampleHistory));
+	channel->m_resamplePhase = endPosition & 0xffff;
+}
+
+static IGpAudioDriver *CreateAudioDriver_SDL2(const GpAudioDriverProperties &properties, bool isOffline)
 {
 	void *storage = AlignedAlloc(sizeof(GpAudioDriver_SDL2), GP_SYSTEM_MEMORY_ALIGNMENT);
 	if (!storage)
 		return nullptr;
 
-	GpAudioDriver_SDL2 *driver = new (storage) GpAudioDriver_SDL2(properties);
+	GpAudioDriver_SDL2 *driver = new (storage) GpAudioDriver_SDL2(properties, isOffline);
 	if (!driver->Init())
 	{
 		driver->Shutdown();
@@ -573,3 +1129,14 @@ IGpAudioDriver *GpDriver_CreateAudioDriver_SDL(const GpAudioDriverProperties &pr
 
 	return driver;
 }
+
+IGpAudioDriver *GpDriver_CreateAudioDriver_SDL(const GpAudioDriverProperties &properties)
+{
+	return CreateAudioDriver_SDL2(properties, false);
+}
+
+// Runs the same mixer without a device, advanced by ServeTicks and written to properties.m_renderPath as a WAV file
+IGpAudioDriver *GpDriver_CreateAudioDriver_Offline(const GpAudioDriverProperties &properties)
+{
+	return CreateAudioDriver_SDL2(properties, true);
+}
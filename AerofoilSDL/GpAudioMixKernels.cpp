@@ -0,0 +1,213 @@
+#include "GpAudioMixKernels.h"
+
+#include <math.h>
+
+#if GP_AUDIO_MIX_SSE2
+#include <emmintrin.h>
+#endif
+
+static int16_t SaturateToInt16(int32_t value)
+{
+	if (value < -0x8000)
+		return -0x8000;
+	if (value > 0x7fff)
+		return 0x7fff;
+	return static_cast<int16_t>(value);
+}
+
+void GpAudioMixKernels::Resample(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter)
+{
+#if GP_AUDIO_MIX_SSE2
+	ResampleSSE2(output, input, numFrames, position, step, filter);
+#else
+	ResampleScalar(output, input, numFrames, position, step, filter);
+#endif
+}
+
+void GpAudioMixKernels::AccumulatePannedSamples(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames)
+{
+#if GP_AUDIO_MIX_SSE2
+	AccumulatePannedSamplesSSE2(accumulator, samples, leftGain, rightGain, numFrames);
+#else
+	AccumulatePannedSamplesScalar(accumulator, samples, leftGain, rightGain, numFrames);
+#endif
+}
+
+void GpAudioMixKernels::PackMixSamples(int16_t *output, const int32_t *accumulator, size_t numSamples)
+{
+#if GP_AUDIO_MIX_SSE2
+	PackMixSamplesSSE2(output, accumulator, numSamples);
+#else
+	PackMixSamplesScalar(output, accumulator, numSamples);
+#endif
+}
+
+size_t GpAudioMixKernels::ResampleInputSamples(uint32_t position, size_t numFrames, uint32_t step)
+{
+	return (position + static_cast<uint32_t>(numFrames) * step) >> 16;
+}
+
+void GpAudioMixKernels::ResampleScalar(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter)
+{
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		const int16_t *taps = input + (position >> 16);
+		const int16_t *coefs = filter + ((position >> (16 - kResamplePhaseBits)) & (kResamplePhases - 1)) * kResampleTaps;
+
+		int32_t sum = 0;
+		for (unsigned int t = 0; t < kResampleTaps; t++)
+			sum += taps[t] * coefs[t];
+
+		output[i] = SaturateToInt16(sum >> kResampleOutputShift);
+		position += step;
+	}
+}
+
+void GpAudioMixKernels::AccumulatePannedSamplesScalar(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames)
+{
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		accumulator[i * 2 + 0] += (samples[i] * leftGain) >> kMixGainShift;
+		accumulator[i * 2 + 1] += (samples[i] * rightGain) >> kMixGainShift;
+	}
+}
+
+void GpAudioMixKernels::PackMixSamplesScalar(int16_t *output, const int32_t *accumulator, size_t numSamples)
+{
+	for (size_t i = 0; i < numSamples; i++)
+		output[i] = SaturateToInt16(accumulator[i]);
+}
+
+#if GP_AUDIO_MIX_SSE2
+// One output frame per iteration, with all 8 taps in a single multiply-add.  The filter must be 16-byte aligned.
+void GpAudioMixKernels::ResampleSSE2(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter)
+{
+	GP_STATIC_ASSERT(kResampleTaps == 8);
+
+	for (size_t i = 0; i < numFrames; i++)
+	{
+		const __m128i taps = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + (position >> 16)));
+		const __m128i coefs = _mm_load_si128(reinterpret_cast<const __m128i*>(filter + ((position >> (16 - kResamplePhaseBits)) & (kResamplePhases - 1)) * kResampleTaps));
+
+		__m128i sum = _mm_madd_epi16(taps, coefs);
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		output[i] = SaturateToInt16(_mm_cvtsi128_si32(sum) >> kResampleOutputShift);
+		position += step;
+	}
+}
+
+// Processes 8 frames per iteration.  Buffers must be 16-byte aligned and the frame count a multiple of 8.
+void GpAudioMixKernels::AccumulatePannedSamplesSSE2(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames)
+{
+	const __m128i gains = _mm_set_epi16(rightGain, leftGain, rightGain, leftGain, rightGain, leftGain, rightGain, leftGain);
+
+	for (size_t i = 0; i < numFrames; i += 8)
+	{
+		const __m128i mono = _mm_load_si128(reinterpret_cast<const __m128i*>(samples + i));
+		__m128i *acc = reinterpret_cast<__m128i*>(accumulator + i * 2);
+
+		// Duplicate each sample into a left/right pair, then rebuild the full 32-bit products from the low and high halves
+		const __m128i stereoLow = _mm_unpacklo_epi16(mono, mono);
+		const __m128i stereoHigh = _mm_unpackhi_epi16(mono, mono);
+		const __m128i productLowLo = _mm_mullo_epi16(stereoLow, gains);
+		const __m128i productLowHi = _mm_mulhi_epi16(stereoLow, gains);
+		const __m128i productHighLo = _mm_mullo_epi16(stereoHigh, gains);
+		const __m128i productHighHi = _mm_mulhi_epi16(stereoHigh, gains);
+
+		acc[0] = _mm_add_epi32(acc[0], _mm_srai_epi32(_mm_unpacklo_epi16(productLowLo, productLowHi), kMixGainShift));
+		acc[1] = _mm_add_epi32(acc[1], _mm_srai_epi32(_mm_unpackhi_epi16(productLowLo, productLowHi), kMixGainShift));
+		acc[2] = _mm_add_epi32(acc[2], _mm_srai_epi32(_mm_unpacklo_epi16(productHighLo, productHighHi), kMixGainShift));
+		acc[3] = _mm_add_epi32(acc[3], _mm_srai_epi32(_mm_unpackhi_epi16(productHighLo, productHighHi), kMixGainShift));
+	}
+}
+
+void GpAudioMixKernels::PackMixSamplesSSE2(int16_t *output, const int32_t *accumulator, size_t numSamples)
+{
+	for (size_t i = 0; i < numSamples; i += 8)
+	{
+		const __m128i *acc = reinterpret_cast<const __m128i*>(accumulator + i);
+		_mm_store_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi32(acc[0], acc[1]));
+	}
+}
+#endif
+
+// Builds the polyphase table: a Blackman-windowed sinc low-pass, sampled at each phase offset and
+// normalized so every phase has unity DC gain.  When downsampling, the cutoff follows the output rate.
+void GpAudioMixKernels::BuildResampleFilter(int16_t *filter, unsigned int inputRate, unsigned int outputRate)
+{
+	const double kPi = 3.14159265358979323846;
+	const double halfWidth = kResampleTaps / 2;
+
+	double cutoff = 0.45;
+	if (outputRate < inputRate)
+		cutoff = cutoff * outputRate / inputRate;
+
+	for (unsigned int phase = 0; phase < kResamplePhases; phase++)
+	{
+		const double fraction = static_cast<double>(phase) / kResamplePhases;
+
+		double coefs[kResampleTaps];
+		double total = 0.0;
+		for (unsigned int t = 0; t < kResampleTaps; t++)
+		{
+			// Output sits between taps 3 and 4, so the filter's delay is a constant number of input samples
+			const double distance = static_cast<double>(t) - (halfWidth - 1.0) - fraction;
+
+			double sinc = 2.0 * cutoff;
+			if (distance != 0.0)
+				sinc = sin(2.0 * kPi * cutoff * distance) / (kPi * distance);
+
+			double window = 0.0;
+			if (fabs(distance) < halfWidth)
+				window = 0.42 + 0.5 * cos(kPi * distance / halfWidth) + 0.08 * cos(2.0 * kPi * distance / halfWidth);
+
+			coefs[t] = sinc * window;
+			total += coefs[t];
+		}
+
+		int16_t *phaseCoefs = filter + phase * kResampleTaps;
+		int32_t quantizedTotal = 0;
+		unsigned int largestTap = 0;
+		for (unsigned int t = 0; t < kResampleTaps; t++)
+		{
+			phaseCoefs[t] = static_cast<int16_t>(floor(coefs[t] / total * (1 << kResampleFilterBits) + 0.5));
+			quantizedTotal += phaseCoefs[t];
+
+			if (phaseCoefs[t] > phaseCoefs[largestTap])
+				largestTap = t;
+		}
+
+		// Put the rounding error on the largest tap so the phases don't have slightly different DC levels
+		phaseCoefs[largestTap] = static_cast<int16_t>(phaseCoefs[largestTap] + (1 << kResampleFilterBits) - quantizedTotal);
+	}
+}
+
+void GpAudioMixKernels::ComputePanGains(int32_t pan, int32_t maxPan, int16_t &outLeftGain, int16_t &outRightGain)
+{
+	const double kPi = 3.14159265358979323846;
+	const double kSqrt2 = 1.41421356237309504880;
+
+	if (maxPan <= 0)
+	{
+		pan = 0;
+		maxPan = 1;
+	}
+	else if (pan < -maxPan)
+		pan = -maxPan;
+	else if (pan > maxPan)
+		pan = maxPan;
+
+	// Constant-power pan law, scaled so that the center position is at unity gain on both sides
+	const double angle = (static_cast<double>(pan) / maxPan + 1.0) * kPi * 0.25;
+	outLeftGain = static_cast<int16_t>(floor(cos(angle) * kSqrt2 * (1 << kPanGainBits) + 0.5));
+	outRightGain = static_cast<int16_t>(floor(sin(angle) * kSqrt2 * (1 << kPanGainBits) + 0.5));
+}
+
+int16_t GpAudioMixKernels::ComputeMixGain(int16_t audioVolumeScale, int16_t panGain)
+{
+	GP_STATIC_ASSERT(kMaxAudioVolumeScale * 2 * (1 << kPanGainBits) >> kMixGainShift <= 0x7fff);
+
+	return static_cast<int16_t>((static_cast<int32_t>(audioVolumeScale) * panGain) >> kMixGainShift);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreDefs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GP_AUDIO_MIX_SSE2 1
+#else
+#define GP_AUDIO_MIX_SSE2 0
+#endif
+
+// Sound content is resampled to the device rate by an 8-tap polyphase FIR.  Input positions are 16.16 fixed
+// point, and the top bits of the fraction pick one of 64 filter phases.  Coefficients have 14 fractional bits,
+// and resampled samples keep 6 fractional bits over the 8-bit source.
+//
+// Output frame i is filtered from the kResampleTaps input samples starting at (position + i * step) >> 16.
+// The input is the previous chunk's last kResampleTaps samples followed by ResampleInputSamples new ones,
+// which always covers the last frame's taps, and the position of the next chunk is the end position's fraction.
+static const unsigned int kResampleTaps = 8;
+static const unsigned int kResamplePhaseBits = 6;
+static const unsigned int kResamplePhases = 1 << kResamplePhaseBits;
+static const unsigned int kResampleFilterBits = 14;
+static const unsigned int kResampleOutputShift = kResampleFilterBits - 6;
+static const uint32_t kResampleMaxStep = 4 << 16;
+
+// Pan gains have 14 fractional bits, and are combined with the master volume scale into mix gains that
+// bring resampled samples back down to the output range.
+static const unsigned int kPanGainBits = 14;
+static const unsigned int kMixGainShift = 10;
+static const int16_t kMaxAudioVolumeScale = 25;
+
+// The mixer works in chunks of a multiple of 16 frames, up to this many
+static const size_t kMixChunkSize = 256;
+
+// Channels are resampled to the device rate individually, panned into a stereo 32-bit accumulator,
+// and saturated once when packed, so loud overlapping sounds clip instead of wrapping around.
+// The scalar versions are the reference that the SIMD versions must match exactly, which AudioMixTest checks.
+struct GpAudioMixKernels
+{
+	static size_t ResampleInputSamples(uint32_t position, size_t numFrames, uint32_t step);
+	static void Resample(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter);
+	static void AccumulatePannedSamples(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames);
+	static void PackMixSamples(int16_t *output, const int32_t *accumulator, size_t numSamples);
+
+	static void ResampleScalar(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter);
+	static void AccumulatePannedSamplesScalar(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames);
+	static void PackMixSamplesScalar(int16_t *output, const int32_t *accumulator, size_t numSamples);
+
+#if GP_AUDIO_MIX_SSE2
+	static void ResampleSSE2(int16_t *output, const int16_t *input, size_t numFrames, uint32_t position, uint32_t step, const int16_t *filter);
+	static void AccumulatePannedSamplesSSE2(int32_t *accumulator, const int16_t *samples, int16_t leftGain, int16_t rightGain, size_t numFrames);
+	static void PackMixSamplesSSE2(int16_t *output, const int32_t *accumulator, size_t numSamples);
+#endif
+
+	static void BuildResampleFilter(int16_t *filter, unsigned int inputRate, unsigned int outputRate);
+	static void ComputePanGains(int32_t pan, int32_t maxPan, int16_t &outLeftGain, int16_t &outRightGain);
+	static int16_t ComputeMixGain(int16_t audioVolumeScale, int16_t panGain);
+};
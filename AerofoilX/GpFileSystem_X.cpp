@@ -14,6 +14,7 @@
 
 #include <string>
 #include <vector>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -48,9 +49,12 @@ public:
 	GpUFilePos_t Tell() const override;
 	void Close() override;
 	void Flush() override;
+	const void *MapContents() override;
 
 private:
 	FILE *m_f;
+	void *m_mapping;
+	size_t m_mappingSize;
 	bool m_seekable;
 	bool m_isReadOnly;
 	bool m_isWriteOnly;
@@ -59,6 +63,8 @@ private:
 
 GpFileStream_X_File::GpFileStream_X_File(FILE *f, bool readOnly, bool writeOnly)
 	: m_f(f)
+	, m_mapping(nullptr)
+	, m_mappingSize(0)
 	, m_isReadOnly(readOnly)
 	, m_isWriteOnly(writeOnly)
 {
@@ -67,6 +73,9 @@ GpFileStream_X_File::GpFileStream_X_File(FILE *f, bool readOnly, bool writeOnly)
 
 GpFileStream_X_File::~GpFileStream_X_File()
 {
+	if (m_mapping)
+		munmap(m_mapping, m_mappingSize);
+
 	fclose(m_f);
 }
 
@@ -153,6 +162,29 @@ void GpFileStream_X_File::Flush()
 	fflush(m_f);
 }
 
+// Only read-only files are mapped, since nothing keeps the mapping in sync with writes through the stream
+const void *GpFileStream_X_File::MapContents()
+{
+	if (m_mapping)
+		return m_mapping;
+
+	if (!m_isReadOnly || !m_seekable)
+		return nullptr;
+
+	const GpUFilePos_t size = Size();
+	if (size == 0 || size != static_cast<GpUFilePos_t>(static_cast<size_t>(size)))
+		return nullptr;
+
+	void *mapping = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fileno(m_f), 0);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	m_mapping = mapping;
+	m_mappingSize = static_cast<size_t>(size);
+
+	return m_mapping;
+}
+
 bool GpFileSystem_X::ResolvePath(PortabilityLayer::VirtualDirectory_t virtualDirectory, char const* const* paths, size_t numPaths, std::string &resolution)
 {
 	const char *prefsAppend = nullptr;
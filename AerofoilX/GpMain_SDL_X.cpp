@@ -20,6 +20,7 @@
 #include "IGpVOSEventQueue.h"
 
 #include <string>
+#include <string.h>
 
 GpXGlobals g_gpXGlobals;
 
@@ -27,6 +28,7 @@ extern "C" IGpFontHandler *GpDriver_CreateFontHandler_FreeType2(const GpFontHand
 
 IGpDisplayDriver *GpDriver_CreateDisplayDriver_SDL_GL2(const GpDisplayDriverProperties &properties);
 IGpAudioDriver *GpDriver_CreateAudioDriver_SDL(const GpAudioDriverProperties &properties);
+IGpAudioDriver *GpDriver_CreateAudioDriver_Offline(const GpAudioDriverProperties &properties);
 IGpInputDriver *GpDriver_CreateInputDriver_SDL2_Gamepad(const GpInputDriverProperties &properties);
 
 
@@ -50,6 +52,23 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 
 	g_gpGlobalConfig.m_audioDriverType = EGpAudioDriverType_SDL2;
 
+	// -renderaudio <path> mixes audio in game time into a WAV file instead of playing it
+	for (int i = 1; i < argc - 1; i++)
+	{
+		if (!strcmp(argv[i], "-renderaudio"))
+		{
+			g_gpGlobalConfig.m_audioDriverType = EGpAudioDriverType_Offline;
+			g_gpGlobalConfig.m_audioRenderPath = argv[i + 1];
+		}
+	}
+
+	// -startuptrace writes StartupTrace.json to the prefs directory
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-startuptrace"))
+			GpSystemServices_X::GetInstance()->SetStartupTraceEnabled(true);
+	}
+
 	g_gpGlobalConfig.m_fontHandlerType = EGpFontHandlerType_FreeType2;
 
 	EGpInputDriverType inputDrivers[] =
@@ -66,6 +85,7 @@ SDLMAIN_DECLSPEC int SDL_main(int argc, char *argv[])
 
 	GpDisplayDriverFactory::RegisterDisplayDriverFactory(EGpDisplayDriverType_SDL_GL2, GpDriver_CreateDisplayDriver_SDL_GL2);
 	GpAudioDriverFactory::RegisterAudioDriverFactory(EGpAudioDriverType_SDL2, GpDriver_CreateAudioDriver_SDL);
+	GpAudioDriverFactory::RegisterAudioDriverFactory(EGpAudioDriverType_Offline, GpDriver_CreateAudioDriver_Offline);
 	GpInputDriverFactory::RegisterInputDriverFactory(EGpInputDriverType_SDL2_Gamepad, GpDriver_CreateInputDriver_SDL2_Gamepad);
 	GpFontHandlerFactory::RegisterFontHandlerFactory(EGpFontHandlerType_FreeType2, GpDriver_CreateFontHandler_FreeType2);
 
@@ -29,8 +29,9 @@ static void *StaticStartThread(void *lpThreadParameter)
 }
 
 GpSystemServices_X::GpSystemServices_X()
-	: m_textInputEnabled(false)
-	, m_clipboardContents(nullptr)
+	: m_clipboardContents(nullptr)
+	, m_textInputEnabled(false)
+	, m_startupTraceEnabled(false)
 {
 }
 
@@ -93,11 +94,21 @@ bool GpSystemServices_X::IsFullscreenOnStartup() const
 	return false;
 }
 
+bool GpSystemServices_X::IsStartupTraceEnabled() const
+{
+	return m_startupTraceEnabled;
+}
+
 unsigned int GpSystemServices_X::GetCPUCount() const
 {
 	return SDL_GetCPUCount();
 }
 
+void GpSystemServices_X::SetStartupTraceEnabled(bool isEnabled)
+{
+	m_startupTraceEnabled = isEnabled;
+}
+
 void GpSystemServices_X::SetTextInputEnabled(bool isEnabled)
 {
 	m_textInputEnabled = isEnabled;
@@ -18,6 +18,7 @@ public:
 	bool IsTextInputObstructive() const override;
 	bool IsFullscreenPreferred() const override;
 	bool IsFullscreenOnStartup() const override;
+	bool IsStartupTraceEnabled() const override;
 	unsigned int GetCPUCount() const override;
 	void SetTextInputEnabled(bool isEnabled) override;
 	bool IsTextInputEnabled() const override;
@@ -25,6 +26,8 @@ public:
 	IGpClipboardContents *GetClipboardContents() const override;
 	void SetClipboardContents(IGpClipboardContents *contents) override;
 
+	void SetStartupTraceEnabled(bool isEnabled);
+
 	static GpSystemServices_X *GetInstance();
 
 private:
@@ -32,4 +35,5 @@ private:
 
 	IGpClipboardContents *m_clipboardContents;
 	bool m_textInputEnabled;
+	bool m_startupTraceEnabled;
 };
@@ -0,0 +1,292 @@
+#include "GpAudioMixKernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Checks that the SIMD mix kernels are bit-identical to the scalar reference for every volume scale and pan
+// position, every chunk length the mixer can use, and a range of resample steps, with enough stacked channels
+// that the mix saturates in both directions.  Also checks that no kernel writes past the frames it was asked for,
+// and that the resampler never reads input that the mixer hasn't consumed yet.
+
+static const size_t kMaxTestChannels = 16;
+// Each channel starts a few samples further into the input, so there's some slack after the resampler's reach
+static const size_t kInputSamples = kResampleTaps + kMixChunkSize * (kResampleMaxStep >> 16) + 1 + 4;
+static const int16_t kGuardSample = 0x5a5a;
+static const int32_t kGuardAccumulator = 0x5a5a5a5a;
+
+// Content is 22254 Hz, and device rates vary, so cover upsampling, unity and downsampling
+static const unsigned int kContentRate = 22254;
+static const unsigned int kOutputRates[] = { 48000, 44100, 22254, 11025, kContentRate / 4 + 1 };
+static const size_t kNumOutputRates = sizeof(kOutputRates) / sizeof(kOutputRates[0]);
+
+struct TestTotals
+{
+	size_t m_numChecks;
+	size_t m_numMismatches;
+	size_t m_numOverruns;
+	size_t m_numUnconsumedReads;
+};
+
+struct MixBuffers
+{
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_resampled[kMixChunkSize];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int32_t m_accumulator[kMixChunkSize * 2];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t m_output[kMixChunkSize * 2];
+
+	void Reset(size_t numFrames);
+	bool GuardsIntact(size_t numFrames) const;
+};
+
+void MixBuffers::Reset(size_t numFrames)
+{
+	for (size_t i = 0; i < kMixChunkSize; i++)
+		m_resampled[i] = kGuardSample;
+
+	for (size_t i = 0; i < kMixChunkSize * 2; i++)
+	{
+		m_accumulator[i] = (i < numFrames * 2) ? 0 : kGuardAccumulator;
+		m_output[i] = kGuardSample;
+	}
+}
+
+bool MixBuffers::GuardsIntact(size_t numFrames) const
+{
+	for (size_t i = numFrames; i < kMixChunkSize; i++)
+	{
+		if (m_resampled[i] != kGuardSample)
+			return false;
+	}
+
+	for (size_t i = numFrames * 2; i < kMixChunkSize * 2; i++)
+	{
+		if (m_accumulator[i] != kGuardAccumulator || m_output[i] != kGuardSample)
+			return false;
+	}
+
+	return true;
+}
+
+#if GP_AUDIO_MIX_SSE2
+
+static void Check(bool matches, TestTotals &totals)
+{
+	totals.m_numChecks++;
+	if (!matches)
+		totals.m_numMismatches++;
+}
+
+// Fills the input with 8-bit content converted the way the mixer does it, or with full-scale square waves that
+// drive the resampler into saturation.
+static void FillInput(int16_t *input, bool fullScale, uint32_t &seed)
+{
+	for (size_t i = 0; i < kInputSamples; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		if (fullScale)
+			input[i] = (((seed >> 16) & 3) == 0) ? -0x8000 : 0x7fff;
+		else
+			input[i] = static_cast<int16_t>(static_cast<int>((seed >> 16) & 0xff) - 0x80);
+	}
+}
+
+// Mixes one chunk through both paths, one channel at a time, comparing the accumulators after every channel and
+// the packed output at the end.  Channel samples come from the resampler, so they cover its saturated range too.
+static void CheckMix(const int16_t *filter, const int16_t *input, size_t numFrames, uint32_t step, const int16_t *leftGains, const int16_t *rightGains, size_t numChannels, TestTotals &totals)
+{
+	MixBuffers scalar;
+	MixBuffers simd;
+
+	scalar.Reset(numFrames);
+	simd.Reset(numFrames);
+
+	for (size_t c = 0; c < numChannels; c++)
+	{
+		const uint32_t position = static_cast<uint32_t>(c * 0x1357) & 0xffff;
+		const int16_t *channelInput = input + (c % 4);
+
+		GpAudioMixKernels::ResampleScalar(scalar.m_resampled, channelInput, numFrames, position, step, filter);
+		GpAudioMixKernels::ResampleSSE2(simd.m_resampled, channelInput, numFrames, position, step, filter);
+		Check(memcmp(scalar.m_resampled, simd.m_resampled, sizeof(scalar.m_resampled)) == 0, totals);
+
+		GpAudioMixKernels::AccumulatePannedSamplesScalar(scalar.m_accumulator, scalar.m_resampled, leftGains[c], rightGains[c], numFrames);
+		GpAudioMixKernels::AccumulatePannedSamplesSSE2(simd.m_accumulator, simd.m_resampled, leftGains[c], rightGains[c], numFrames);
+		Check(memcmp(scalar.m_accumulator, simd.m_accumulator, sizeof(scalar.m_accumulator)) == 0, totals);
+	}
+
+	GpAudioMixKernels::PackMixSamplesScalar(scalar.m_output, scalar.m_accumulator, numFrames * 2);
+	GpAudioMixKernels::PackMixSamplesSSE2(simd.m_output, simd.m_accumulator, numFrames * 2);
+	Check(memcmp(scalar.m_output, simd.m_output, sizeof(scalar.m_output)) == 0, totals);
+
+	if (!scalar.GuardsIntact(numFrames) || !simd.GuardsIntact(numFrames))
+		totals.m_numOverruns++;
+}
+
+// Runs every gain from 0 to the top of the 16-bit range through the accumulator and packer, with samples at the
+// extremes as well as in between, so products that only fit in 32 bits are covered too.
+static void CheckAllGains(TestTotals &totals)
+{
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t samples[kMixChunkSize];
+
+	for (size_t i = 0; i < kMixChunkSize; i++)
+	{
+		if (i < 8)
+			samples[i] = (i & 1) ? -0x8000 : 0x7fff;
+		else
+			samples[i] = static_cast<int16_t>(static_cast<int>(i * 0x10101 % 0x10000) - 0x8000);
+	}
+
+	for (int32_t gain = 0; gain <= 0x7fff; gain++)
+	{
+		MixBuffers scalar;
+		MixBuffers simd;
+
+		scalar.Reset(kMixChunkSize);
+		simd.Reset(kMixChunkSize);
+
+		const int16_t leftGain = static_cast<int16_t>(gain);
+		const int16_t rightGain = static_cast<int16_t>(0x7fff - gain);
+
+		GpAudioMixKernels::AccumulatePannedSamplesScalar(scalar.m_accumulator, samples, leftGain, rightGain, kMixChunkSize);
+		GpAudioMixKernels::AccumulatePannedSamplesSSE2(simd.m_accumulator, samples, leftGain, rightGain, kMixChunkSize);
+		Check(memcmp(scalar.m_accumulator, simd.m_accumulator, sizeof(scalar.m_accumulator)) == 0, totals);
+
+		GpAudioMixKernels::PackMixSamplesScalar(scalar.m_output, scalar.m_accumulator, kMixChunkSize * 2);
+		GpAudioMixKernels::PackMixSamplesSSE2(simd.m_output, simd.m_accumulator, kMixChunkSize * 2);
+		Check(memcmp(scalar.m_output, simd.m_output, sizeof(scalar.m_output)) == 0, totals);
+	}
+}
+
+// Mixes every volume scale and pan pair at every chunk length and resample step
+static void CheckAllMixes(TestTotals &totals)
+{
+	// The game pans across the width of a room, 512 positions either side of the center
+	const int32_t kMaxPan = 512;
+	const size_t kNumPans = kMaxPan * 2 + 1;
+
+
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t filter[kResamplePhases * kResampleTaps];
+	int16_t input[kInputSamples];
+
+	int16_t leftPanGains[kNumPans];
+	int16_t rightPanGains[kNumPans];
+	for (size_t p = 0; p < kNumPans; p++)
+		GpAudioMixKernels::ComputePanGains(static_cast<int32_t>(p) - kMaxPan, kMaxPan, leftPanGains[p], rightPanGains[p]);
+
+	uint32_t seed = 1;
+
+	for (size_t r = 0; r < kNumOutputRates; r++)
+	{
+		const uint32_t step = static_cast<uint32_t>((static_cast<uint64_t>(kContentRate) << 16) / kOutputRates[r]);
+		GpAudioMixKernels::BuildResampleFilter(filter, kContentRate, kOutputRates[r]);
+
+		for (int fullScale = 0; fullScale < 2; fullScale++)
+		{
+			FillInput(input, fullScale != 0, seed);
+
+			for (size_t numFrames = 16; numFrames <= kMixChunkSize; numFrames += 16)
+			{
+				for (int16_t volumeScale = 0; volumeScale <= kMaxAudioVolumeScale; volumeScale++)
+				{
+					// Each mix stacks a full set of channels over consecutive pan positions, so every
+					// volume scale and pan pair is mixed at every chunk length
+					for (size_t firstPan = 0; firstPan < kNumPans; firstPan += kMaxTestChannels)
+					{
+						int16_t leftGains[kMaxTestChannels];
+						int16_t rightGains[kMaxTestChannels];
+						for (size_t c = 0; c < kMaxTestChannels; c++)
+						{
+							const size_t pan = (firstPan + c) % kNumPans;
+							leftGains[c] = GpAudioMixKernels::ComputeMixGain(volumeScale, leftPanGains[pan]);
+							rightGains[c] = GpAudioMixKernels::ComputeMixGain(volumeScale, rightPanGains[pan]);
+						}
+
+						CheckMix(filter, input, numFrames, step, leftGains, rightGains, kMaxTestChannels, totals);
+					}
+				}
+			}
+		}
+	}
+}
+
+#endif
+
+// Resamples chunks the way the mixer does, with the input after the samples the mixer would have consumed
+// filled with full-scale values of either sign, and checks that the output doesn't depend on them.
+static void CheckUnconsumedInput(TestTotals &totals)
+{
+	const size_t kMaxInput = kResampleTaps + kMixChunkSize * (kResampleMaxStep >> 16) + 1;
+	const size_t kMaxOverread = kResampleTaps;
+
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t filter[kResamplePhases * kResampleTaps];
+	GP_ALIGNED(GP_SYSTEM_MEMORY_ALIGNMENT) int16_t resampled[2][kMixChunkSize];
+	int16_t content[kMaxInput];
+	int16_t input[kMaxInput + kMaxOverread];
+
+	uint32_t seed = 1;
+	for (size_t i = 0; i < kMaxInput; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+		content[i] = static_cast<int16_t>(static_cast<int>((seed >> 16) & 0xff) - 0x80);
+	}
+
+	for (size_t r = 0; r < kNumOutputRates; r++)
+	{
+		const uint32_t step = static_cast<uint32_t>((static_cast<uint64_t>(kContentRate) << 16) / kOutputRates[r]);
+		GpAudioMixKernels::BuildResampleFilter(filter, kContentRate, kOutputRates[r]);
+
+		for (size_t numFrames = 16; numFrames <= kMixChunkSize; numFrames += 16)
+		{
+			for (uint32_t phase = 0; phase < 0x10000; phase += 0x3f1)
+			{
+				// History, then the new samples
+				const size_t numConsumed = kResampleTaps + GpAudioMixKernels::ResampleInputSamples(phase, numFrames, step);
+
+				for (int useSIMD = 0; useSIMD < 2; useSIMD++)
+				{
+#if !GP_AUDIO_MIX_SSE2
+					if (useSIMD)
+						break;
+#endif
+
+					for (int poison = 0; poison < 2; poison++)
+					{
+						memcpy(input, content, numConsumed * sizeof(int16_t));
+						for (size_t i = numConsumed; i < kMaxInput + kMaxOverread; i++)
+							input[i] = (poison == 0) ? 0x7fff : -0x8000;
+
+#if GP_AUDIO_MIX_SSE2
+						if (useSIMD)
+							GpAudioMixKernels::ResampleSSE2(resampled[poison], input, numFrames, phase, step, filter);
+						else
+#endif
+							GpAudioMixKernels::ResampleScalar(resampled[poison], input, numFrames, phase, step, filter);
+					}
+
+					totals.m_numChecks++;
+					if (memcmp(resampled[0], resampled[1], numFrames * sizeof(int16_t)) != 0)
+						totals.m_numUnconsumedReads++;
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, const char **argv)
+{
+	TestTotals totals;
+	memset(&totals, 0, sizeof(totals));
+
+#if GP_AUDIO_MIX_SSE2
+	CheckAllMixes(totals);
+	CheckAllGains(totals);
+#else
+	fprintf(stdout, "No SIMD mix kernels on this target, only checking the scalar resampler's input\n");
+#endif
+
+	CheckUnconsumedInput(totals);
+
+	fprintf(stdout, "%zu comparisons, %zu mismatches, %zu overruns, %zu reads of unconsumed input\n", totals.m_numChecks, totals.m_numMismatches, totals.m_numOverruns, totals.m_numUnconsumedReads);
+
+	return (totals.m_numMismatches == 0 && totals.m_numOverruns == 0 && totals.m_numUnconsumedReads == 0) ? 0 : 1;
+}
@@ -0,0 +1,322 @@
+#include "GpAudioBufferQueue.h"
+#include "IGpAudioBuffer.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Hammers a buffer queue the way the SDL audio driver uses it: a mixer thread consumes buffers and posts a new one
+// from each buffer-finished callback through its own lane, while other threads post and flush concurrently.  Checks
+// that every producer's buffers come out in the order they were accepted, that each accepted buffer comes out exactly
+// once, and that every reference taken by the queue is released.  Before that, checks that posts made one after
+// another through alternating lanes come out in the order they were made.
+
+static const int kNumOutsideProducers = 2;
+static const int kNumProducers = kNumOutsideProducers + 1;	// The last one is the mixer's callback
+static const int kMixerProducer = kNumOutsideProducers;
+
+static std::atomic<size_t> gs_numLiveBuffers;
+
+class TestBuffer final : public IGpAudioBuffer
+{
+public:
+	TestBuffer(int producer, unsigned int sequence);
+
+	void AddRef() override;
+	void Release() override;
+	size_t GetSize() const override;
+
+	int GetProducer() const;
+	unsigned int GetSequence() const;
+
+private:
+	~TestBuffer();
+
+	std::atomic<unsigned int> m_refCount;
+	int m_producer;
+	unsigned int m_sequence;
+};
+
+TestBuffer::TestBuffer(int producer, unsigned int sequence)
+	: m_refCount(1)
+	, m_producer(producer)
+	, m_sequence(sequence)
+{
+	gs_numLiveBuffers++;
+}
+
+TestBuffer::~TestBuffer()
+{
+	gs_numLiveBuffers--;
+}
+
+void TestBuffer::AddRef()
+{
+	m_refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TestBuffer::Release()
+{
+	if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete this;
+}
+
+size_t TestBuffer::GetSize() const
+{
+	return 1;
+}
+
+int TestBuffer::GetProducer() const
+{
+	return m_producer;
+}
+
+unsigned int TestBuffer::GetSequence() const
+{
+	return m_sequence;
+}
+
+struct StressState
+{
+	GpAudioBufferQueue m_queue;
+	std::mutex m_mixerMutex;	// Stands in for the SDL audio lock, so flushes and mixes are one consumer
+
+	// Written only by the producer that owns them
+	std::vector<unsigned int> m_accepted[kNumProducers];
+	unsigned int m_nextSequence[kNumProducers];
+	size_t m_numRejected[kNumProducers];
+
+	// Written only under the mixer mutex
+	std::vector<unsigned int> m_removed[kNumProducers];
+	size_t m_numConsumed;
+	size_t m_numFlushed;
+
+	std::atomic<bool> m_producersFinished;
+};
+
+static bool Post(StressState &state, int producer)
+{
+	TestBuffer *buffer = new TestBuffer(producer, state.m_nextSequence[producer]++);
+
+	const GpAudioBufferQueue::Lane lane = (producer == kMixerProducer) ? GpAudioBufferQueue::Lane_Mixer : GpAudioBufferQueue::Lane_Other;
+	const bool accepted = state.m_queue.Push(lane, buffer, 0, 0);
+	if (accepted)
+		state.m_accepted[producer].push_back(buffer->GetSequence());
+	else
+		state.m_numRejected[producer]++;
+
+	buffer->Release();
+
+	return accepted;
+}
+
+// Must be called with the mixer mutex held
+static void RecordRemoved(StressState &state, IGpAudioBuffer *buffer)
+{
+	TestBuffer *testBuffer = static_cast<TestBuffer*>(buffer);
+	state.m_removed[testBuffer->GetProducer()].push_back(testBuffer->GetSequence());
+}
+
+static void MixerThread(StressState &state, unsigned int numCallbackPosts)
+{
+	for (;;)
+	{
+		const bool producersFinished = state.m_producersFinished.load();
+		bool consumedAny = false;
+
+		{
+			std::lock_guard<std::mutex> lock(state.m_mixerMutex);
+
+			while (const GpAudioBufferQueue::Entry *entry = state.m_queue.Front())
+			{
+				IGpAudioBuffer *buffer = entry->m_buffer;
+				RecordRemoved(state, buffer);
+				state.m_numConsumed++;
+				consumedAny = true;
+
+				state.m_queue.PopFront();
+				buffer->Release();
+
+				// Buffer-finished callbacks post the next buffer from this thread while it's still mixing
+				if (state.m_nextSequence[kMixerProducer] < numCallbackPosts)
+					Post(state, kMixerProducer);
+			}
+		}
+
+		if (!consumedAny)
+		{
+			if (producersFinished && state.m_nextSequence[kMixerProducer] >= numCallbackPosts)
+				break;
+
+			// Keep the callback posting even if everything else has drained
+			if (state.m_nextSequence[kMixerProducer] < numCallbackPosts)
+				Post(state, kMixerProducer);
+			else
+				std::this_thread::yield();
+		}
+	}
+}
+
+static void ProducerThread(StressState &state, int producer, unsigned int numPosts)
+{
+	while (state.m_nextSequence[producer] < numPosts)
+	{
+		// Back off while the queue is full so that most posts race with the mixer's instead of being rejected
+		if (!Post(state, producer))
+			std::this_thread::yield();
+	}
+}
+
+// Stops the channel every so often, the way Stop takes the mixer's place as the consumer
+static void FlushThread(StressState &state)
+{
+	unsigned int counter = 0;
+
+	while (!state.m_producersFinished.load())
+	{
+		if ((++counter & 0x3f) != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		IGpAudioBuffer *flushedBuffers[GpAudioBufferQueue::kCapacity];
+		size_t numFlushed = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(state.m_mixerMutex);
+
+			numFlushed = state.m_queue.Flush(flushedBuffers);
+			for (size_t i = 0; i < numFlushed; i++)
+				RecordRemoved(state, flushedBuffers[i]);
+
+			state.m_numFlushed += numFlushed;
+		}
+
+		for (size_t i = 0; i < numFlushed; i++)
+			flushedBuffers[i]->Release();
+	}
+}
+
+// Posts from one thread through a pattern of lanes, consuming as it goes, and checks that the buffers come out in
+// the order they were posted
+static bool CheckLaneOrder()
+{
+	GpAudioBufferQueue queue;
+	unsigned int nextPosted = 0;
+	unsigned int nextExpected = 0;
+	bool inOrder = true;
+
+	uint32_t seed = 1;
+	for (int i = 0; i < 100000; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		if ((seed >> 16) % 3 != 0)
+		{
+			const GpAudioBufferQueue::Lane lane = ((seed >> 20) & 1) ? GpAudioBufferQueue::Lane_Mixer : GpAudioBufferQueue::Lane_Other;
+
+			TestBuffer *buffer = new TestBuffer(0, nextPosted);
+			if (queue.Push(lane, buffer, 0, 0))
+				nextPosted++;
+
+			buffer->Release();
+		}
+		else if (const GpAudioBufferQueue::Entry *entry = queue.Front())
+		{
+			IGpAudioBuffer *buffer = entry->m_buffer;
+			if (static_cast<TestBuffer*>(buffer)->GetSequence() != nextExpected)
+				inOrder = false;
+
+			nextExpected++;
+			queue.PopFront();
+			buffer->Release();
+		}
+	}
+
+	IGpAudioBuffer *flushedBuffers[GpAudioBufferQueue::kCapacity];
+	const size_t numFlushed = queue.Flush(flushedBuffers);
+	for (size_t i = 0; i < numFlushed; i++)
+	{
+		if (static_cast<TestBuffer*>(flushedBuffers[i])->GetSequence() != nextExpected)
+			inOrder = false;
+
+		nextExpected++;
+		flushedBuffers[i]->Release();
+	}
+
+	if (nextExpected != nextPosted)
+		inOrder = false;
+
+	fprintf(stdout, "Lane order: %u posts, %s\n", nextPosted, inOrder ? "in order" : "OUT OF ORDER");
+
+	return inOrder;
+}
+
+int main(int argc, const char **argv)
+{
+	unsigned int numPosts = 1000000;
+	if (argc >= 2)
+		numPosts = static_cast<unsigned int>(atoi(argv[1]));
+
+	if (numPosts == 0)
+	{
+		fprintf(stderr, "Usage: AudioQueueTest [<posts per producer>]\n");
+		return -1;
+	}
+
+	const bool lanesInOrder = CheckLaneOrder();
+
+	StressState *state = new StressState();
+	for (int p = 0; p < kNumProducers; p++)
+	{
+		state->m_nextSequence[p] = 0;
+		state->m_numRejected[p] = 0;
+	}
+
+	state->m_numConsumed = 0;
+	state->m_numFlushed = 0;
+	state->m_producersFinished = false;
+
+	std::thread mixerThread(MixerThread, std::ref(*state), numPosts);
+	std::thread flushThread(FlushThread, std::ref(*state));
+
+	std::thread producerThreads[kNumOutsideProducers];
+	for (int p = 0; p < kNumOutsideProducers; p++)
+		producerThreads[p] = std::thread(ProducerThread, std::ref(*state), p, numPosts);
+
+	for (int p = 0; p < kNumOutsideProducers; p++)
+		producerThreads[p].join();
+
+	state->m_producersFinished = true;
+
+	flushThread.join();
+	mixerThread.join();
+
+	size_t numOrderErrors = 0;
+	size_t numAccepted = 0;
+	size_t numRejected = 0;
+	for (int p = 0; p < kNumProducers; p++)
+	{
+		numAccepted += state->m_accepted[p].size();
+		numRejected += state->m_numRejected[p];
+
+		if (state->m_accepted[p] != state->m_removed[p])
+		{
+			fprintf(stderr, "Producer %i: %zu buffers accepted but %zu removed, or out of order\n", p, state->m_accepted[p].size(), state->m_removed[p].size());
+			numOrderErrors++;
+		}
+	}
+
+	const size_t numLeaked = gs_numLiveBuffers.load();
+
+	fprintf(stdout, "%zu posts accepted, %zu rejected as full, %zu consumed, %zu flushed\n", numAccepted, numRejected, state->m_numConsumed, state->m_numFlushed);
+	fprintf(stdout, "%zu producers out of order, %zu buffers leaked\n", numOrderErrors, numLeaked);
+
+	delete state;
+
+	return (lanesInOrder && numOrderErrors == 0 && numLeaked == 0) ? 0 : 1;
+}
@@ -74,6 +74,7 @@ LOCAL_SRC_FILES := \
 	Sound.cpp	\
 	SoundSync_Cpp11.cpp	\
 	SourceExport.cpp	\
+	Startup.cpp	\
 	StringUtils.cpp	\
 	StructuresInit.cpp	\
 	StructuresInit2.cpp	\
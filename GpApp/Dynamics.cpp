@@ -21,10 +21,11 @@
 
 
 Rect		breadSrc[kNumBreadPicts];
+Boolean		bandHitDynamic[kMaxDynamicObs];
 
 extern	dynaPtr		dinahs;
 extern	bandPtr		bands;
-extern	short		numBands, tvWithMovieNumber;
+extern	short		numBands, numDynamics, tvWithMovieNumber;
 extern	Boolean		evenFrame, twoPlayerGame, onePlayerLeft, playerDead;
 
 
@@ -76,36 +77,53 @@ void CheckDynamicCollision (short who, gliderPtr thisGlider, Boolean doOffset)
 	}
 }
 
-//--------------------------------------------------------------  DidBandHitDynamic
+//--------------------------------------------------------------  TestBandsAgainstDynamics
 
-// Checks to see if a rubber band struck a dynamic.
+// Tests every rubber band against every dynamic in a single pass.  Called once
+// per frame before the dynamics are handled.  Bands do not move while the
+// dynamics are handled, and each handler only moves its own dynamic after
+// asking DidBandHitDynamic(), so the results hold for the whole frame.
 
-Boolean DidBandHitDynamic (short who)
+void TestBandsAgainstDynamics (void)
 {
-	Rect		dinahRect;
-	short		i;
-	Boolean		collided;
+	short		dinahTop[kMaxDynamicObs], dinahLeft[kMaxDynamicObs];
+	short		dinahBottom[kMaxDynamicObs], dinahRight[kMaxDynamicObs];
+	short		i, n;
 	
-	dinahRect = dinahs[who].dest;
+	for (i = 0; i < numDynamics; i++)
+	{
+		dinahTop[i] = dinahs[i].dest.top;
+		dinahLeft[i] = dinahs[i].dest.left;
+		dinahBottom[i] = dinahs[i].dest.bottom;
+		dinahRight[i] = dinahs[i].dest.right;
+		bandHitDynamic[i] = false;
+	}
 	
-	for (i = 0; i < numBands; i++)
+	for (n = 0; n < numBands; n++)
 	{
-		if (bands[i].dest.bottom < dinahRect.top)
-			collided = false;
-		else if (bands[i].dest.top > dinahRect.bottom)
-			collided = false;
-		else if (bands[i].dest.right < dinahRect.left)
-			collided = false;
-		else if (bands[i].dest.left > dinahRect.right)
-			collided = false;
-		else
-			collided = true;
+		const short		bandTop = bands[n].dest.top;
+		const short		bandLeft = bands[n].dest.left;
+		const short		bandBottom = bands[n].dest.bottom;
+		const short		bandRight = bands[n].dest.right;
 		
-		if (collided)
-			break;
+		for (i = 0; i < numDynamics; i++)
+		{
+			bandHitDynamic[i] |= ((bandBottom >= dinahTop[i]) && 
+					(bandTop <= dinahBottom[i]) && 
+					(bandRight >= dinahLeft[i]) && 
+					(bandLeft <= dinahRight[i]));
+		}
 	}
-	
-	return (collided);
+}
+
+//--------------------------------------------------------------  DidBandHitDynamic
+
+// Checks to see if a rubber band struck a dynamic.  Only valid while the
+// dynamics are being handled (see TestBandsAgainstDynamics() above).
+
+Boolean DidBandHitDynamic (short who)
+{
+	return (bandHitDynamic[who]);
 }
 
 //--------------------------------------------------------------  RenderToast
@@ -19,7 +19,7 @@ dynaPtr		dinahs;
 short		numDynamics;
 
 extern	Rect		breadSrc[];
-extern	short		numLights;
+extern	short		numLights, numBands;
 extern	Boolean		evenFrame;
 
 
@@ -32,6 +32,9 @@ void HandleDynamics (void)
 {
 	short		i;
 	
+	if (numBands > 0)
+		TestBandsAgainstDynamics();
+	
 	for (i = 0; i < numDynamics; i++)
 	{
 		switch (dinahs[i].type)
@@ -46,6 +46,13 @@ namespace PortabilityLayer
 #define kErrNeedColorQD				12
 #define kErrNeed16Or256Colors		13
 
+#define kStartupReadPrefs			0
+#define kStartupCreateOffscreens	1
+#define kStartupInitSound			2
+#define kStartupInitMusic			3
+#define kStartupBuildHouseList		4
+#define kStartupOpenHouse			5
+
 #define iAbout					1
 #define iAboutAerofoil			3
 #define iExportSourceCode		4
@@ -615,6 +615,9 @@ static const Boolean kFaceLeft = FALSE;	// Conflicts with GP input driver
 #define kSavingTitleMode			2
 
 #define kScoreboardPictID			1997
+#define kAngelPictID				1019
+#define kSupportPictID				1999
+#define kClutterPictID				4018
 
 #define kDemoLength					6702
 
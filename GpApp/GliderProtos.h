@@ -9,6 +9,7 @@
 #include "GliderStructs.h"
 
 struct GpMouseInputEvent;
+struct IGpAudioBuffer;
 
 //--------------------------------------------------------------  Prototypes
 
@@ -50,6 +51,7 @@ void ZeroFlamesAndTheLike (void);
 void RemoveSavedMapsNotInRoom (SInt16);
 
 void CheckDynamicCollision (SInt16, gliderPtr, Boolean);	// --- Dynamics.c
+void TestBandsAgainstDynamics (void);
 Boolean DidBandHitDynamic (SInt16);
 void RenderToast (SInt16);
 void RenderBalloon (SInt16);
@@ -175,6 +177,7 @@ void CloseMapWindow (void);
 void ToggleMapWindow (void);
 void HandleMapClick (const GpMouseInputEvent &);
 void MoveRoom (Point);
+void FlushMapThumbnails (void);
 
 void DoMarquee (void);									// --- Marquee.c
 void StartMarquee (Rect *);
@@ -416,6 +419,8 @@ Boolean DoesRoomHaveCeiling (void);
 
 void ReadyLevel (void);									// --- RoomGraphics.c
 void ResetLocale (Boolean soft);
+void WaitForRoomPrefetch (void);
+void FlushBackgroundCache (void);
 void DrawLocale (Boolean soft);
 void RedrawRoomLighting (void);
 
@@ -449,18 +454,26 @@ Boolean HasDragManager (void);
 
 void DoLoadHouse (void);								// --- SelectHouse.c
 void BuildHouseList (void);
+void ScanHouseFolders (void);
 void AddExtraHouse (const VFileSpec &);
 
 void DoSettingsMain (void);								// --- Settings.c
 
 void PlayPrioritySound (SInt16, SInt16);					// --- Sound.c
 void FlushAnyTriggerPlaying (void);
-void PlayExclusiveSoundChannel (SInt16, SInt16, SInt16, SInt16);
+void UpdateSoundVoices (void);
 PLError_t LoadTriggerSound (SInt16);
 void DumpTriggerSound (void);
 void InitSound (void);
 void KillSound (void);
 void TellHerNoSounds (void);
+IGpAudioBuffer *GetCachedSound (Boolean, SInt16);
+void FlushHouseSounds (void);
+void FlushSoundCache (void);
+
+void BeginStartup (void);								// --- Startup.c
+void RunStartupStep (SInt16);
+void EndStartup (void);
 
 void InitScoreboardMap (void);							// --- StructuresInit.c
 void InitGliderMap (void);
@@ -472,6 +485,8 @@ void InitSwitches (void);
 void InitLights (void);
 void InitAppliances (void);
 void InitEnemies (void);
+void QueueOffscreenGraphics (void);
+void DoneWithOffscreenGraphics (void);
 
 void CreateOffscreens (void);							// --- StructuresInit2.c
 void CreatePointers (void);
@@ -582,20 +582,20 @@ Boolean ReadHouse (GpIOStream *houseStream)
 		return(false);
 	}
 	
-	const size_t readByteCount = houseStream->Read(*thisHouse, byteCount);
-	if (readByteCount != byteCount || readByteCount < houseType::kBinaryDataSize)
+	if (byteCount < houseType::kBinaryDataSize)
 	{
 		CheckFileError(PLErrors::kIOError, thisHouseName);
 		return(false);
 	}
 
-	if (alignmentPadding != 0)
-	{
-		// GP: Correct for padding
-		const size_t roomDataSize = byteCount - houseType::kBinaryDataSize;
+	// GP: Read the header and the rooms separately so the rooms land past the padding
+	const size_t roomDataSize = byteCount - houseType::kBinaryDataSize;
 
-		uint8_t *houseDataBytes = reinterpret_cast<uint8_t*>(*thisHouse);
-		memmove((*thisHouse)->rooms, houseDataBytes + houseType::kBinaryDataSize, roomDataSize);
+	if (houseStream->Read(*thisHouse, houseType::kBinaryDataSize) != houseType::kBinaryDataSize
+		|| houseStream->Read((*thisHouse)->rooms, roomDataSize) != roomDataSize)
+	{
+		CheckFileError(PLErrors::kIOError, thisHouseName);
+		return(false);
 	}
 
 	ByteSwapHouse(*thisHouse, static_cast<size_t>(byteCount), false);
@@ -803,6 +803,10 @@ void CloseHouseResFork (void)
 	{
 		PortabilityLayer::ResourceManager *rm = PortabilityLayer::ResourceManager::GetInstance();
 
+		WaitForRoomPrefetch();
+		FlushBackgroundCache();
+		FlushMapThumbnails();
+		FlushHouseSounds();
 		houseResFork->Destroy();
 		houseResFork = nullptr;
 	}
@@ -15,6 +15,9 @@
 #include "RectUtils.h"
 
 
+#define kRoomsTimesSuites		8192		// 64 floors * 128 suites
+
+
 void WrapBannerAndTrailer (void);
 void ValidateNumberOfRooms (void);
 void CheckDuplicateFloorSuite (void);
@@ -26,6 +29,7 @@ void CheckRoomNameLength (void);
 void MakeSureNumObjectsJives (void);
 void KeepAllObjectsLegal (void);
 void CheckForStaircasePairs (void);
+short FloorSuiteSlot (short, short);
 
 
 short		houseErrors, wasRoom;
@@ -625,13 +629,25 @@ void ValidateNumberOfRooms (void)
 	}
 }
 
+//--------------------------------------------------------------  FloorSuiteSlot
+
+// Maps a floor and suite to a unique slot in a kRoomsTimesSuites sized table.
+// Returns -1 if the floor or suite is out of the legal range.
+
+short FloorSuiteSlot (short floor, short suite)
+{
+	if ((floor > 56) || (floor < -7) || (suite >= 128) || (suite < 0))
+		return (-1);
+	
+	return (((floor + 7) * 128) + suite);
+}
+
 //--------------------------------------------------------------  CheckDuplicateFloorSuite
 
 // Error check, looks for rooms with the same floor suite (stacked).
 
 void CheckDuplicateFloorSuite (void)
 {
-	#define		kRoomsTimesSuites	8192
 	short		i, numRooms, bitPlace;
 	char		*pidgeonHoles;
 	
@@ -644,10 +660,10 @@ void CheckDuplicateFloorSuite (void)
 	{
 		if ((*thisHouse)->rooms[i].suite != kRoomIsEmpty)
 		{
-			bitPlace = (((*thisHouse)->rooms[i].floor + 7) * 128) + 
-					(*thisHouse)->rooms[i].suite;
-			//if ((bitPlace < 0) || (bitPlace >= 8192))
-			//	DebugStr(PSTR("Blew array"));
+			bitPlace = FloorSuiteSlot((*thisHouse)->rooms[i].floor, 
+					(*thisHouse)->rooms[i].suite);
+			if (bitPlace == -1)				// left to ValidateRoomNumbers()
+				continue;
 			if (pidgeonHoles[bitPlace] != 0)
 			{
 				houseErrors++;
@@ -889,11 +905,27 @@ void KeepAllObjectsLegal (void)
 
 void CheckForStaircasePairs (void)
 {
-	short		i, h, g, numRooms, neighbor;
+	short		i, h, g, numRooms, neighbor, slot;
+	short		*roomAtSlot;
 	Boolean		hasStairs;
 	Str255		message;
 	
+	roomAtSlot = (short *)NewPtr(sizeof(short) * kRoomsTimesSuites);
+	if (roomAtSlot == nil)
+		return;
+	
+	for (i = 0; i < kRoomsTimesSuites; i++)
+		roomAtSlot[i] = kRoomIsEmpty;
+	
 	numRooms = (*thisHouse)->nRooms;
+	for (i = 0; i < numRooms; i++)			// index rooms by floor and suite
+	{										// keeping the first room found
+		slot = FloorSuiteSlot((*thisHouse)->rooms[i].floor, 
+				(*thisHouse)->rooms[i].suite);
+		if ((slot != -1) && (roomAtSlot[slot] == kRoomIsEmpty))
+			roomAtSlot[slot] = i;
+	}
+	
 	for (i = 0; i < numRooms; i++)
 	{
 		if ((*thisHouse)->rooms[i].suite != kRoomIsEmpty)
@@ -903,7 +935,9 @@ void CheckForStaircasePairs (void)
 				if ((*thisHouse)->rooms[i].objects[h].what == kUpStairs)
 				{
 					thisRoomNumber = i;
-					neighbor = GetNeighborRoomNumber(kNorthRoom);
+					slot = FloorSuiteSlot((*thisHouse)->rooms[i].floor + 1, 
+							(*thisHouse)->rooms[i].suite);
+					neighbor = (slot == -1) ? kRoomIsEmpty : roomAtSlot[slot];
 					if (neighbor == kRoomIsEmpty)
 					{
 						GetLocalizedString(20, message);
@@ -930,7 +964,9 @@ void CheckForStaircasePairs (void)
 				else if ((*thisHouse)->rooms[i].objects[h].what == kDownStairs)
 				{
 					thisRoomNumber = i;
-					neighbor = GetNeighborRoomNumber(kSouthRoom);
+					slot = FloorSuiteSlot((*thisHouse)->rooms[i].floor - 1, 
+							(*thisHouse)->rooms[i].suite);
+					neighbor = (slot == -1) ? kRoomIsEmpty : roomAtSlot[slot];
 					if (neighbor == kRoomIsEmpty)
 					{
 						GetLocalizedString(22, message);
@@ -957,6 +993,8 @@ void CheckForStaircasePairs (void)
 			}
 		}
 	}
+	
+	DisposePtr((Ptr)roomAtSlot);
 }
 #endif
 
@@ -527,6 +527,7 @@ int gpAppMain()
 	Boolean		whoCares, copyGood;
 
 	PL_Init();
+	BeginStartup();
 
 	ToolBoxInit();
 	CheckOurEnvirons();
@@ -543,7 +544,7 @@ int gpAppMain()
 //	dataResFile = OpenResFile("\pMermaid");
 	SetUpAppleEvents();
 	LoadCursors();
-	ReadInPrefs();
+	RunStartupStep(kStartupReadPrefs);
 
 	SpinCursor(2);	// Tick once to let the display driver flush any resolution changes from prefs
 	FlushResolutionChange();
@@ -570,7 +571,7 @@ int gpAppMain()
 	InitMarquee();
 	CreatePointers();
 	InitSrcRects();
-	CreateOffscreens();
+	RunStartupStep(kStartupCreateOffscreens);
 
 	bool resolutionChanged = false;
 
@@ -598,10 +599,11 @@ int gpAppMain()
 	if (isDoColorFade)
 		PortabilityLayer::WindowManager::GetInstance()->SetWindowDesaturation(mainWindow, 1.0);
 
-	InitSound();						SpinCursor(2);
-	InitMusic();						SpinCursor(2);
-	BuildHouseList();
-	OpenHouse(true);
+	RunStartupStep(kStartupInitSound);	SpinCursor(2);
+	RunStartupStep(kStartupInitMusic);	SpinCursor(2);
+	RunStartupStep(kStartupBuildHouseList);
+	RunStartupStep(kStartupOpenHouse);
+	EndStartup();
 
 	PlayPrioritySound(kBirdSound, kBirdPriority);
 	DelayTicks(6);
@@ -643,6 +645,8 @@ int gpAppMain()
 	PL_DEAD(FlushEvents());
 //	theErr = LoadScrap();
 
+	PL_Shutdown();
+
 	return 0;
 }
 
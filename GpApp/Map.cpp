@@ -32,9 +32,11 @@
 #define kNewRoomAlert			1004
 #define kYesDoNewRoom			1
 #define kThumbnailPictID		1010
+#define kMaxPrettyNails			32
 
 
 void LoadGraphicPlus (DrawSurface *, short, const Rect &);
+short GetPrettyNail (short);
 void RedrawMapContents (void);
 void LiveHScrollAction (PortabilityLayer::Widget *theControl, int thePart);
 void LiveVScrollAction (PortabilityLayer::Widget *theControl, int thePart);
@@ -46,13 +48,16 @@ void KeepWindowInBounds (Window *window);
 Rect			nailSrcRect, activeRoomRect, wasActiveRoomRect;
 Rect			mapHScrollRect, mapVScrollRect, mapCenterRect;
 Rect			mapWindowRect;
-DrawSurface		*nailSrcMap;
+DrawSurface		*nailSrcMap, *prettyNailMap;
 WindowPtr		mapWindow;
 PortabilityLayer::Widget	*mapHScroll, *mapVScroll;
 short			isMapH, isMapV, mapRoomsHigh, mapRoomsWide;
 short			mapLeftRoom, mapTopRoom;
+short			prettyNailIDs[kMaxPrettyNails], numPrettyNails;
+UInt32			prettyNailUsed[kMaxPrettyNails], prettyNailClock;
 Boolean			isMapOpen, doPrettyMap;
 
+extern	short		numberRooms;
 extern	Boolean		doComplainDialogs;
 
 
@@ -183,6 +188,79 @@ void LoadGraphicPlus (DrawSurface *surface, short resID, const Rect &theRect)
 	thePicture.Dispose();
 }
 
+//--------------------------------------------------------------  GetPrettyNail
+// Custom backgrounds are scaled down once into a strip of thumbnails and
+// kept there, so scrolling the map is just a matter of copying from the
+// strip.  Returns the thumbnail's slot, or -1 if there's no strip.
+
+#ifndef COMPILEDEMO
+short GetPrettyNail (short pictID)
+{
+	Rect		bounds;
+	PLError_t	theErr;
+	short		i, slot;
+	
+	for (i = 0; i < numPrettyNails; i++)
+	{
+		if (prettyNailIDs[i] == pictID)
+		{
+			prettyNailUsed[i] = ++prettyNailClock;
+			return (i);
+		}
+	}
+	
+	if (prettyNailMap == nil)
+	{
+		QSetRect(&bounds, 0, 0, kMapRoomWidth, kMapRoomHeight * kMaxPrettyNails);
+		theErr = CreateOffScreenGWorld(&prettyNailMap, &bounds);
+		if (theErr != PLErrors::kNone)
+		{
+			prettyNailMap = nil;
+			return (-1);
+		}
+	}
+	
+	if (numPrettyNails < kMaxPrettyNails)
+		slot = numPrettyNails++;
+	else
+	{
+		slot = 0;						// Toss the least recently used one
+		for (i = 1; i < kMaxPrettyNails; i++)
+		{
+			if (prettyNailUsed[i] < prettyNailUsed[slot])
+				slot = i;
+		}
+	}
+	
+	QSetRect(&bounds, 0, 0, kMapRoomWidth, kMapRoomHeight);
+	QOffsetRect(&bounds, 0, slot * kMapRoomHeight);
+	PortabilityLayer::ResolveCachingColor whiteColor = StdColors::White();
+	prettyNailMap->FillRect(bounds, whiteColor);
+	LoadGraphicPlus(prettyNailMap, pictID, bounds);
+	
+	prettyNailIDs[slot] = pictID;
+	prettyNailUsed[slot] = ++prettyNailClock;
+	
+	return (slot);
+}
+#endif
+
+//--------------------------------------------------------------  FlushMapThumbnails
+// Forgets the custom background thumbnails.  Called when the house's
+// pictures may have changed.
+
+void FlushMapThumbnails (void)
+{
+#ifndef COMPILEDEMO
+	if (prettyNailMap != nil)
+	{
+		DisposeGWorld(prettyNailMap);
+		prettyNailMap = nil;
+	}
+	numPrettyNails = 0;
+#endif
+}
+
 //--------------------------------------------------------------  RedrawMapContents
 
 #ifndef COMPILEDEMO
@@ -190,7 +268,8 @@ void RedrawMapContents (void)
 {
 	Rect		newClip, aRoom, src;
 	short		h, i, groundLevel;
-	short		floor, suite, whoCares, type;
+	short		floor, suite, whoCares, type, slot;
+	short		*mapCells;
 	char		wasState;
 	Boolean		activeRoomVisible;
 	
@@ -200,6 +279,26 @@ void RedrawMapContents (void)
 	activeRoomVisible = false;
 	groundLevel = kMapGroundValue - mapTopRoom;
 	
+	// Find which room (if any) sits in each visible cell in one pass over
+	// the house, first room wins just as with RoomExists().
+	mapCells = (short *)NewPtr(sizeof(short) * mapRoomsWide * mapRoomsHigh);
+	if (mapCells == nil)
+		return;
+	for (i = 0; i < mapRoomsWide * mapRoomsHigh; i++)
+		mapCells[i] = kRoomIsEmpty;
+	if (houseUnlocked)
+	{
+		for (i = numberRooms - 1; i >= 0; i--)
+		{
+			suite = (*thisHouse)->rooms[i].suite - mapLeftRoom;
+			floor = (kMapGroundValue - (*thisHouse)->rooms[i].floor) - mapTopRoom;
+			if (((*thisHouse)->rooms[i].suite >= 0) && 
+					(suite >= 0) && (suite < mapRoomsWide) && 
+					(floor >= 0) && (floor < mapRoomsHigh))
+				mapCells[floor * mapRoomsWide + suite] = i;
+		}
+	}
+	
 	newClip.left = mapWindowRect.left;
 	newClip.top = mapWindowRect.top;
 	newClip.right = mapWindowRect.right + 2 - kMapScrollBarWidth;
@@ -214,9 +313,8 @@ void RedrawMapContents (void)
 			QSetRect(&aRoom, 0, 0, kMapRoomWidth, kMapRoomHeight);
 			QOffsetRect(&aRoom, kMapRoomWidth * h, kMapRoomHeight * i);
 			
-			suite = h + mapLeftRoom;
-			floor = kMapGroundValue - (i + mapTopRoom);
-			if ((RoomExists(suite, floor, &whoCares)) && (houseUnlocked))
+			whoCares = mapCells[i * mapRoomsWide + h];
+			if (whoCares != kRoomIsEmpty)
 			{
 				type = (*thisHouse)->rooms[whoCares].background - kBaseBackgroundID;
 				if (type > kNumBackgrounds)
@@ -227,7 +325,17 @@ void RedrawMapContents (void)
 
 				if (type > kNumBackgrounds)		// Do a "pretty" thumbnail.
 				{
-					LoadGraphicPlus(surface, type + kBaseBackgroundID, aRoom);
+					slot = GetPrettyNail(type + kBaseBackgroundID);
+					if (slot == -1)
+						LoadGraphicPlus(surface, type + kBaseBackgroundID, aRoom);
+					else
+					{
+						QSetRect(&src, 0, 0, kMapRoomWidth, kMapRoomHeight);
+						QOffsetRect(&src, 0, slot * kMapRoomHeight);
+						CopyBits((BitMap *)*GetGWorldPixMap(prettyNailMap), 
+								GetPortBitMapForCopyBits(mapWindow->GetDrawSurface()),
+								&src, &aRoom, srcCopy);
+					}
 				}
 				else
 				{
@@ -260,6 +368,8 @@ void RedrawMapContents (void)
 			}
 		}
 	}
+	
+	DisposePtr((Ptr)mapCells);
 
 	PortabilityLayer::ResolveCachingColor blackColor = StdColors::Black();
 	
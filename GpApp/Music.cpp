@@ -8,10 +8,13 @@
 #include "Environ.h"
 #include "Externs.h"
 #include "SoundSync.h"
+#include "GpIOStream.h"
+#include "IGpAudioBuffer.h"
 #include "IGpMutex.h"
 #include "IGpSystemServices.h"
 #include "MemoryManager.h"
 #include "ResourceManager.h"
+#include "WorkerThread.h"
 
 #include "PLDrivers.h"
 #include "PLResources.h"
@@ -21,19 +24,25 @@
 #define kMaxMusic					7
 #define kLastMusicPiece				16
 #define kLastGamePiece				6
+#define kMusicChunkSize				8192		// bytes of samples per streamed buffer
+#define kMusicChunksQueued			3			// so two are still queued while one is read
 
 
+void AdvanceMusicScore (void);
+Boolean OpenMusicStream (short);
+void CloseMusicStream (void);
+IGpAudioBuffer *ReadMusicChunk (void);
+Boolean QueueMusicChunk (void);
+void ReadMusicTask (void *context);
 void MusicCallBack (PortabilityLayer::AudioChannel *channel);
-PLError_t LoadMusicSounds (void);
-PLError_t DumpMusicSounds (void);
+PLError_t CheckMusicSounds (void);
+Boolean FindWaveSoundData (GpIOStream *stream, UInt32 *dataSize);
 PLError_t OpenMusicChannel (void);
 PLError_t CloseMusicChannel (void);
 
-THandle<void> ParseAndConvertSound(const THandle<void> &handle);
 
 
 PortabilityLayer::AudioChannel	*musicChannel;
-Ptr				theMusicData[kMaxMusic];
 short			musicScore[kLastMusicPiece];
 short			gameScore[kLastGamePiece];
 Boolean			isMusicOn, isPlayMusicIdle, isPlayMusicGame;
@@ -44,10 +53,15 @@ struct MusicState
 {
 	short			musicMode;
 	short			musicSoundID, musicCursor;
+	GpIOStream		*musicStream;		// Segment being played, positioned at its next samples
+	UInt32			musicBytesLeft;
+	Boolean			musicStreaming;		// Cleared to stop the reader from queueing more
 };
 
 MusicState musicState;
 IGpMutex *musicMutex;
+PortabilityLayer::WorkerThread *musicReader;	// Nil if music isn't playing or there are no workers
+Byte musicChunk[4 + kMusicChunkSize];	// Length-tagged, only used under the lock
 
 
 extern	Boolean		isSoundOn;
@@ -59,7 +73,7 @@ extern	Boolean		isSoundOn;
 PLError_t StartMusic (void)
 {
 	PLError_t		theErr;
-	short		soundVolume;
+	short		soundVolume, numQueued;
 
 	theErr = PLErrors::kNone;
 
@@ -73,16 +87,29 @@ PLError_t StartMusic (void)
 
 	if ((soundVolume != 0) && (!failedMusic))
 	{
-		musicChannel->AddBuffer(theMusicData[musicState.musicSoundID], true);
-
-		// Don't need to lock here because the callback should not trigger until queued
-		musicState.musicCursor++;
-		if (musicState.musicCursor >= kLastMusicPiece)
-			musicState.musicCursor = 0;
-		musicState.musicSoundID = musicScore[musicState.musicCursor];
+		// Each chunk's callback has the reader queue up another one, picking up
+		// where the last stop left off
+		if (musicReader == nil)
+			musicReader = PortabilityLayer::WorkerThread::Create();
+
+		musicMutex->Lock();
+		musicState.musicStreaming = true;
+		for (numQueued = 0; numQueued < kMusicChunksQueued; numQueued++)
+		{
+			if (!QueueMusicChunk())
+				break;
+		}
+		if (numQueued == 0)
+			musicState.musicStreaming = false;
+		musicMutex->Unlock();
 
-		musicChannel->AddBuffer(theMusicData[musicState.musicSoundID], true);
-		musicChannel->AddCallback(MusicCallBack, true);
+		if (numQueued == 0)
+		{
+			if (musicReader != nil)
+				musicReader->Destroy();
+			musicReader = nil;
+			return (PLErrors::kAudioError);
+		}
 
 		isMusicOn = true;
 	}
@@ -102,9 +129,18 @@ void StopTheMusic (void)
 	theErr = PLErrors::kNone;
 	if ((isMusicOn) && (!failedMusic))
 	{
+		musicMutex->Lock();
+		musicState.musicStreaming = false;
+		musicMutex->Unlock();
+
 		musicChannel->ClearAllCommands();
 		musicChannel->Stop();
 
+		// No more callbacks can come in, so wait out any reads they started
+		if (musicReader != nil)
+			musicReader->Destroy();
+		musicReader = nil;
+
 		isMusicOn = false;
 	}
 }
@@ -156,13 +192,11 @@ void SetMusicalMode (short newMode)
 	musicMutex->Unlock();
 }
 
-//--------------------------------------------------------------  MusicCallBack
+//--------------------------------------------------------------  AdvanceMusicScore
+// Picks the next segment to play.  Must be called under the music lock.
 
-void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
+void AdvanceMusicScore (void)
 {
-	PLError_t		theErr;
-
-	musicMutex->Lock();
 	switch (musicState.musicMode)
 	{
 		case kPlayGameScoreMode:
@@ -188,63 +222,150 @@ void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
 		musicState.musicSoundID = musicState.musicMode;
 		break;
 	}
+}
 
-	short musicSoundID = musicState.musicSoundID;
-	musicMutex->Unlock();
+//--------------------------------------------------------------  OpenMusicStream
+// Opens a music segment in the app's archive, positioned at its samples.
+// Must be called under the music lock (or with no music playing).
 
-	theChannel->AddBuffer(theMusicData[musicSoundID], true);
-	theChannel->AddCallback(MusicCallBack, true);
+Boolean OpenMusicStream (short soundID)
+{
+	PortabilityLayer::IResourceArchive	*archive;
+	GpIOStream		*stream;
+	UInt32			dataSize;
+
+	CloseMusicStream();
+
+	archive = PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive();
+	stream = archive->OpenResourceStream('snd ', soundID + kBaseBufferMusicID);
+	if (stream == nil)
+		return (false);
+
+	if (!FindWaveSoundData(stream, &dataSize))
+	{
+		stream->Close();
+		return (false);
+	}
+
+	musicState.musicStream = stream;
+	musicState.musicBytesLeft = dataSize;
+
+	return (true);
 }
 
-//--------------------------------------------------------------  LoadMusicSounds
+//--------------------------------------------------------------  CloseMusicStream
 
-PLError_t LoadMusicSounds (void)
+void CloseMusicStream (void)
 {
-	Handle		theSound;
-	long		soundDataSize;
-	PLError_t		theErr;
-	short		i;
+	if (musicState.musicStream != nil)
+		musicState.musicStream->Close();
+	musicState.musicStream = nil;
+	musicState.musicBytesLeft = 0;
+}
 
-	theErr = PLErrors::kNone;
+//--------------------------------------------------------------  ReadMusicChunk
+// Reads the next few thousand samples of music into a new buffer, moving
+// on through the score whenever a segment runs out.  Must be called under
+// the music lock.  Returns nil if the music can't go on.
 
-	for (i = 0; i < kMaxMusic; i++)
-		theMusicData[i] = nil;
+IGpAudioBuffer *ReadMusicChunk (void)
+{
+	UInt32		chunkSize;
+	short		attempts;
 
-	for (i = 0; i < kMaxMusic; i++)
+	for (attempts = 0; musicState.musicBytesLeft == 0; attempts++)
 	{
-		theSound = ParseAndConvertSound(PortabilityLayer::ResourceManager::GetInstance()->GetAppResource('snd ', i + kBaseBufferMusicID));
-		if (theSound == nil)
-			return PLErrors::kOutOfMemory;
+		if (attempts > kMaxMusic)
+			return (nil);
 
-		soundDataSize = GetHandleSize(theSound);
+		if (musicState.musicStream != nil)
+			AdvanceMusicScore();
 
-		theMusicData[i] = PortabilityLayer::MemoryManager::GetInstance()->Alloc(soundDataSize);
-		if (theMusicData[i] == nil)
-			return PLErrors::kOutOfMemory;
+		if (!OpenMusicStream(musicState.musicSoundID))
+			return (nil);
+	}
 
-		memcpy(theMusicData[i], static_cast<Byte*>(*theSound), soundDataSize);
-		theSound.Dispose();
+	chunkSize = musicState.musicBytesLeft;
+	if (chunkSize > kMusicChunkSize)
+		chunkSize = kMusicChunkSize;
+
+	if (!musicState.musicStream->ReadExact(musicChunk + 4, chunkSize))
+	{
+		CloseMusicStream();
+		return (nil);
 	}
-	return (theErr);
+	musicState.musicBytesLeft -= chunkSize;
+
+	memcpy(musicChunk, &chunkSize, 4);
+
+	return (PortabilityLayer::SoundSystem::GetInstance()->CreateBuffer(musicChunk));
 }
 
-//--------------------------------------------------------------  DumpMusicSounds
+//--------------------------------------------------------------  QueueMusicChunk
+// Reads the next chunk and queues it on the music channel, followed by a
+// callback for when it finishes.  Must be called under the music lock.
 
-PLError_t DumpMusicSounds (void)
+Boolean QueueMusicChunk (void)
 {
-	PLError_t		theErr;
-	short		i;
+	IGpAudioBuffer	*theBuffer;
 
-	theErr = PLErrors::kNone;
+	theBuffer = ReadMusicChunk();
+	if (theBuffer == nil)
+		return (false);
+
+	musicChannel->AddBuffer(theBuffer, true);
+	musicChannel->AddCallback(MusicCallBack, true);
+	theBuffer->Release();
+
+	return (true);
+}
+
+//--------------------------------------------------------------  ReadMusicTask
+// Runs on the music reader.  Queues under the lock so that stopping the
+// music can't slip in between the check and the queueing.
+
+void ReadMusicTask (void *context)
+{
+	musicMutex->Lock();
+	if (musicState.musicStreaming)
+		QueueMusicChunk();
+	musicMutex->Unlock();
+}
+
+//--------------------------------------------------------------  MusicCallBack
+// Called as each chunk of music finishes, usually on the audio thread,
+// which mustn't wait on the archive.  The reader queues up the next chunk
+// while the ones already queued play.  Without workers, it's read here.
+
+void MusicCallBack (PortabilityLayer::AudioChannel *theChannel)
+{
+	if (musicReader != nil)
+		musicReader->AsyncExecuteTask(ReadMusicTask, nil);
+	else
+	{
+		musicMutex->Lock();
+		QueueMusicChunk();
+		musicMutex->Unlock();
+	}
+}
+
+//--------------------------------------------------------------  CheckMusicSounds
+// Music is streamed as it plays, so this only makes sure every segment
+// is there and readable.
+
+PLError_t CheckMusicSounds (void)
+{
+	short		i;
 
 	for (i = 0; i < kMaxMusic; i++)
 	{
-		if (theMusicData[i] != nil)
-			PortabilityLayer::MemoryManager::GetInstance()->Release(theMusicData[i]);
-		theMusicData[i] = nil;
+		if (!OpenMusicStream(i))
+			return (PLErrors::kOutOfMemory);
 	}
 
-	return (theErr);
+	CloseMusicStream();
+
+	return (PLErrors::kNone);
 }
 
 //--------------------------------------------------------------  OpenMusicChannel
@@ -294,7 +415,11 @@ void InitMusic (void)
 
 	failedMusic = false;
 	isMusicOn = false;
-	theErr = LoadMusicSounds();
+	musicState.musicStream = nil;
+	musicState.musicBytesLeft = 0;
+	musicState.musicStreaming = false;
+	musicReader = nil;
+	theErr = CheckMusicSounds();
 	if (theErr != PLErrors::kNone)
 	{
 		YellowAlert(kYellowNoMusic, theErr);
@@ -361,8 +486,9 @@ void KillMusic (void)
 	if (dontLoadMusic)
 		return;
 
+	StopTheMusic();
 	theErr = CloseMusicChannel();
-	theErr = DumpMusicSounds();
+	CloseMusicStream();
 
 	if (musicMutex)
 		musicMutex->Destroy();
@@ -10,10 +10,12 @@
 
 
 #define kMaxTempManholes			8
+#define kMaxLocalRooms				9
 
 
 short GetObjectLinked (objectType *);
 void ListOneRoomsObjects (short);
+short FindMasterObject (short, short);
 
 
 Rect		blowerSrcRect;									// Blowers
@@ -76,6 +78,9 @@ hotPtr		hotSpots;
 short		nLocalObj, nHotSpots, numMasterObjects, numLocalMasterObjects;
 short		numTempManholes, tvWithMovieNumber;
 Boolean		newState;
+short		masterRoomNums[kMaxLocalRooms];					// room -> first index
+short		masterRoomFirsts[kMaxLocalRooms];				// into masterObjects
+short		numMasterRooms;
 
 extern	linksPtr	linksList;
 extern	short		srcLocations[], destLocations[];
@@ -258,6 +263,14 @@ void ListOneRoomsObjects (short where)
 	if (roomNum == kRoomIsEmpty)
 		return;
 	
+	if ((numMasterObjects + kMaxRoomObs > kMaxMasterObjects) || 
+			(numMasterRooms >= kMaxLocalRooms))
+		return;
+	
+	masterRoomNums[numMasterRooms] = roomNum;			// a room's objects are
+	masterRoomFirsts[numMasterRooms] = numMasterObjects;	// listed contiguously
+	numMasterRooms++;
+	
 	for (n = 0; n < kMaxRoomObs; n++)
 	{
 		if (numMasterObjects < kMaxMasterObjects)
@@ -289,15 +302,36 @@ void ListOneRoomsObjects (short where)
 	}
 }
 
+//--------------------------------------------------------------  FindMasterObject
+// Returns the index into masterObjects of the given room's object, or -1.
+
+short FindMasterObject (short room, short object)
+{
+	short		i, found;
+	
+	if ((object < 0) || (object >= kMaxRoomObs))
+		return (-1);
+	
+	found = -1;
+	for (i = 0; i < numMasterRooms; i++)				// at most 9 rooms listed
+	{
+		if (masterRoomNums[i] == room)
+			found = masterRoomFirsts[i] + object;
+	}
+	
+	return (found);
+}
+
 //--------------------------------------------------------------  ListAllLocalObjects
 
 void ListAllLocalObjects (void)
 {
-	short		i, n;
+	short		i;
 	char		wasState;
 	
 	numMasterObjects = 0;
 	numLocalMasterObjects = 0;
+	numMasterRooms = 0;
 	nHotSpots = 0;
 	
 	ListOneRoomsObjects(kCentralRoom);
@@ -322,16 +356,8 @@ void ListAllLocalObjects (void)
 	{													// index into this list
 		if ((masterObjects[i].roomLink != -1) && 		// if object has a link
 				(masterObjects[i].objectLink != -1))
-		{
-			for (n = 0; n < numMasterObjects; n++)		// search for the object
-			{											// linked to in this list
-				if ((masterObjects[i].roomLink == masterObjects[n].roomNum) && 
-						(masterObjects[i].objectLink == masterObjects[n].objectNum))
-				{
-					masterObjects[i].localLink = n;		// log the index
-				}
-			}
-		}
+			masterObjects[i].localLink = FindMasterObject(masterObjects[i].roomLink, 
+					masterObjects[i].objectLink);
 	}
 }
 
@@ -216,6 +216,8 @@ void NewGame (short mode)
 	playing = true;		// everything before this line is game set-up
 	PlayGame();			// everything following is after a game has ended
 
+	WaitForRoomPrefetch();
+	FlushBackgroundCache();
 	ClearScoreboard();
 
 #ifdef CREATEDEMODATA
@@ -665,6 +667,7 @@ void PlayGame (void)
 		}
 
 		HandleTelephone();
+		UpdateSoundVoices();
 
 		if (twoPlayerGame)
 		{
@@ -741,7 +741,15 @@ void RenderFrame (void)
 	{
 		Delay(1, nullptr);
 	}
-	nextFrame = TickCount() + kTicksPerFrame;
+	
+	// Step the frame deadline by a fixed amount so that a frame which runs
+	// a little long doesn't push the rest back.  If a frame ran past its
+	// whole slot, the late frame is still shown, but the deadline is reset
+	// to a full frame from now rather than left behind, so the next frames
+	// don't follow back to back to catch up.
+	nextFrame += kTicksPerFrame;
+	if (TickCount() >= nextFrame)
+		nextFrame = TickCount() + kTicksPerFrame;
 	
 	CopyRectsQD();
 	
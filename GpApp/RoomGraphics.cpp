@@ -10,15 +10,42 @@
 #include "Externs.h"
 #include "Environ.h"
 #include "MainWindow.h"
+#include "PLQDOffscreen.h"
+#include "QDPixMap.h"
 #include "RectUtils.h"
 #include "ResolveCachingColor.h"
+#include "ResourceLoadBatch.h"
+#include "ResourceManager.h"
+#include "ResTypeID.h"
 #include "Room.h"
+#include "Utilities.h"
 #include "BitmapImage.h"
 
 
 #define kManholeThruFloor		3957
+#define kMaxPrefetchPicts		8
+#define kMaxLocalePicts			9
+#define kMaxCachedBacks			16
+#define kBackCacheBudget		(8L * 1024L * 1024L)	// bytes of pixels
 
 
+typedef struct
+{
+	DrawSurface	*map;
+	long		bytes;
+	UInt32		lastUsed;
+	short		pictID;
+	short		tiles[kNumTiles];
+} cachedBackType;
+
+
+short FindCachedBackground (short, const short *);
+short CacheNewBackground (short, const short *);
+void PrefetchNeighborBackgrounds (void);
+PortabilityLayer::ResourceLoadBatch *QueueBackgroundReads (const short *, short);
+Boolean GetRoomBackground (short, short, short *, short *);
+void QueueLocaleBackgrounds (short);
+void WaitForLocaleBackground (short);
 void LoadGraphicSpecial (DrawSurface *surface, short);
 void DrawRoomBackground (short, short, short);
 void DrawFloorSupport (void);
@@ -35,8 +62,16 @@ short		numNeighbors, numLights, thisTiles[kNumTiles];
 short		localNumbers[9], thisBackground;
 Boolean		isStructure[9], wardBitSet;
 
+PortabilityLayer::ResourceLoadBatch	*prefetchBatch, *localeBatch;
+short		localePicts[kMaxLocalePicts], numLocalePicts;
+cachedBackType	cachedBacks[kMaxCachedBacks];
+long		cachedBackBytes;
+UInt32		cachedBackClock;
+short		numCachedBacks;
+
+extern	PortabilityLayer::IResourceArchive	*houseResFork;
 extern	Rect		tempManholes[];
-extern	short		numTempManholes, tvWithMovieNumber;
+extern	short		numTempManholes, tvWithMovieNumber, numberRooms;
 extern	Boolean		shadowVisible, takingTheStairs;
 
 
@@ -82,6 +117,8 @@ void ResetLocale (Boolean soft)
 
 	const short roomV = (*thisHouse)->rooms[thisRoomNumber].floor;
 
+	QueueLocaleBackgrounds(roomV);
+
 	PortabilityLayer::ResolveCachingColor blackColor = StdColors::Black();
 	backSrcMap->FillRect(backSrcRect, blackColor);
 	
@@ -135,8 +172,249 @@ void ResetLocale (Boolean soft)
 	RestoreWorkMap();
 	shadowVisible = IsShadowVisible();
 
+	if (localeBatch != nil)
+	{
+		localeBatch->Destroy();
+		localeBatch = nil;
+	}
+
 	if (soft)
 		RedrawAllGrease();
+	else
+		PrefetchNeighborBackgrounds();
+}
+
+//--------------------------------------------------------------  PrefetchNeighborBackgrounds
+// Entering any room reloads the backgrounds of all its neighbors.  So, while
+// the player is in this room, we read the backgrounds of every room within
+// two rooms of here on the resource loader threads.  Only the raw resource
+// is read ahead, drawing still has to happen here on the main thread.
+
+void PrefetchNeighborBackgrounds (void)
+{
+	short		roomH, roomV, hDelta, vDelta;
+	short		distance, maxDistance, pictID, i, n;
+	short		prefetchPicts[kMaxPrefetchPicts], numPrefetchPicts;
+
+	if ((houseResFork == nil) || (thisRoomNumber < 0))
+		return;
+
+	if (prefetchBatch != nil)
+	{
+		if (!prefetchBatch->IsComplete())
+			return;		// Still busy with the last room, don't stall the game
+		prefetchBatch->Destroy();
+		prefetchBatch = nil;
+	}
+
+	roomH = (*thisHouse)->rooms[thisRoomNumber].suite;
+	roomV = (*thisHouse)->rooms[thisRoomNumber].floor;
+
+	if (numNeighbors > 3)
+		maxDistance = 2;
+	else
+		maxDistance = 1;
+
+	numPrefetchPicts = 0;
+	for (distance = 1; distance <= maxDistance; distance++)
+	{
+		for (i = 0; i < numberRooms; i++)
+		{
+			if ((*thisHouse)->rooms[i].suite == kRoomIsEmpty)
+				continue;
+
+			hDelta = (*thisHouse)->rooms[i].suite - roomH;
+			vDelta = (*thisHouse)->rooms[i].floor - roomV;
+			if (hDelta < 0)
+				hDelta = -hDelta;
+			if (vDelta < 0)
+				vDelta = -vDelta;
+
+			if (numNeighbors == 1)		// Only the rooms we can fly into
+			{
+				if (hDelta + vDelta != 1)
+					continue;
+			}
+			else if ((numNeighbors == 3) && (vDelta != 0))
+				continue;
+			else if (((hDelta > vDelta) ? hDelta : vDelta) != distance)
+				continue;
+
+			pictID = (*thisHouse)->rooms[i].background;
+			for (n = 0; n < numPrefetchPicts; n++)
+			{
+				if (prefetchPicts[n] == pictID)
+					break;
+			}
+			if (n == numPrefetchPicts)
+			{
+				prefetchPicts[numPrefetchPicts++] = pictID;
+				if (numPrefetchPicts == kMaxPrefetchPicts)
+					break;
+			}
+		}
+		if (numPrefetchPicts == kMaxPrefetchPicts)
+			break;
+	}
+
+	prefetchBatch = QueueBackgroundReads(prefetchPicts, numPrefetchPicts);
+}
+
+//--------------------------------------------------------------  QueueBackgroundReads
+// Starts reading a list of backdrop pictures on the resource loader threads.
+// Item n of the batch is pictIDs[n].  Like LoadHouseResource, a picture the
+// house doesn't have is read from the application instead.  Returns nil if
+// there's nothing to read or no batch could be made.
+
+PortabilityLayer::ResourceLoadBatch *QueueBackgroundReads (const short *pictIDs, short numPicts)
+{
+	PortabilityLayer::ResourceLoadRequest	requests[kMaxLocalePicts];
+	PortabilityLayer::IResourceArchive	*appArchive;
+	short		i;
+
+	if ((houseResFork == nil) || (numPicts <= 0))
+		return nil;
+
+	if (numPicts > kMaxLocalePicts)
+		numPicts = kMaxLocalePicts;
+
+	appArchive = PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive();
+
+	for (i = 0; i < numPicts; i++)
+	{
+		requests[i].m_archive = houseResFork;
+		requests[i].m_fallbackArchive = appArchive;
+		requests[i].m_resTypeID = PortabilityLayer::ResTypeID('PICT');
+		requests[i].m_resID = pictIDs[i];
+	}
+
+	return PortabilityLayer::ResourceLoadBatch::Create(requests, numPicts);
+}
+
+//--------------------------------------------------------------  WaitForRoomPrefetch
+// Blocks until the loader threads are done with the house resources.  Must
+// be called before the house resource fork is closed.
+
+void WaitForRoomPrefetch (void)
+{
+	if (prefetchBatch != nil)
+	{
+		prefetchBatch->Destroy();
+		prefetchBatch = nil;
+	}
+}
+
+//--------------------------------------------------------------  GetRoomBackground
+// Works out which backdrop and tiles a room is drawn with.  Returns false
+// if there's no backdrop and the room is just drawn black.
+
+Boolean GetRoomBackground (short who, short elevation, short *pictID, short *tiles)
+{
+	short		i;
+
+	if (who == kRoomIsEmpty)		// This call should be smarter than this
+	{
+		if (wardBitSet)
+			return (false);
+		
+		if (elevation > 1)
+		{
+			*pictID = kSky;
+			for (i = 0; i < kNumTiles; i++)
+				tiles[i] = 2;
+		}
+		else if (elevation == 1)
+		{
+			*pictID = kMeadow;
+			for (i = 0; i < kNumTiles; i++)
+				tiles[i] = 0;
+		}
+		else
+		{
+			*pictID = kDirt;
+			for (i = 0; i < kNumTiles; i++)
+				tiles[i] = 0;
+		}
+	}
+	else
+	{
+		*pictID = (*thisHouse)->rooms[who].background;
+		for (i = 0; i < kNumTiles; i++)
+			tiles[i] = (*thisHouse)->rooms[who].tiles[i];
+	}
+
+	return (true);
+}
+
+//--------------------------------------------------------------  QueueLocaleBackgrounds
+// Before drawing the rooms around us, start reading every backdrop that
+// isn't cached yet, in the order they'll be drawn.  They then inflate on
+// the loader threads while the rooms before them are being drawn.
+
+void QueueLocaleBackgrounds (short roomV)
+{
+	short		where[9], elevation[9];
+	short		numRooms, who, pictID, i, n;
+	short		tiles[kNumTiles];
+
+	numRooms = 0;
+	if (numNeighbors > 3)
+	{
+		where[numRooms] = kNorthWestRoom;	elevation[numRooms++] = roomV + 1;
+		where[numRooms] = kNorthEastRoom;	elevation[numRooms++] = roomV + 1;
+		where[numRooms] = kNorthRoom;		elevation[numRooms++] = roomV + 1;
+		where[numRooms] = kSouthWestRoom;	elevation[numRooms++] = roomV - 1;
+		where[numRooms] = kSouthEastRoom;	elevation[numRooms++] = roomV - 1;
+		where[numRooms] = kSouthRoom;		elevation[numRooms++] = roomV - 1;
+	}
+	if (numNeighbors > 1)
+	{
+		where[numRooms] = kWestRoom;		elevation[numRooms++] = roomV;
+		where[numRooms] = kEastRoom;		elevation[numRooms++] = roomV;
+	}
+	where[numRooms] = kCentralRoom;			elevation[numRooms++] = roomV;
+
+	numLocalePicts = 0;
+	for (i = 0; i < numRooms; i++)
+	{
+		who = localNumbers[where[i]];
+		if ((who != kRoomIsEmpty) && (GetNumberOfLights(who) == 0))
+			continue;		// Drawn black
+		if (!GetRoomBackground(who, elevation[i], &pictID, tiles))
+			continue;
+		if (FindCachedBackground(pictID, tiles) != -1)
+			continue;
+
+		for (n = 0; n < numLocalePicts; n++)
+		{
+			if (localePicts[n] == pictID)
+				break;
+		}
+		if (n == numLocalePicts)
+			localePicts[numLocalePicts++] = pictID;
+	}
+
+	localeBatch = QueueBackgroundReads(localePicts, numLocalePicts);
+}
+
+//--------------------------------------------------------------  WaitForLocaleBackground
+// Blocks until a backdrop queued by QueueLocaleBackgrounds has been read.
+
+void WaitForLocaleBackground (short pictID)
+{
+	short		i;
+
+	if (localeBatch == nil)
+		return;
+
+	for (i = 0; i < numLocalePicts; i++)
+	{
+		if (localePicts[i] == pictID)
+		{
+			localeBatch->WaitForItem(i);
+			return;
+		}
+	}
 }
 
 //--------------------------------------------------------------  LoadGraphicSpecial
@@ -169,8 +447,9 @@ void LoadGraphicSpecial (DrawSurface *surface, short resID)
 
 void DrawRoomBackground (short who, short where, short elevation)
 {
-	Rect		src, dest;
-	short		i, pictID;
+	Rect		src, dest, tileSrc, tileRect;
+	DrawSurface	*tileMap;
+	short		i, pictID, cacheIndex;
 	short		tiles[kNumTiles];
 	char		wasState;
 	
@@ -189,55 +468,147 @@ void DrawRoomBackground (short who, short where, short elevation)
 		return;
 	}
 	
-	if (who == kRoomIsEmpty)		// This call should be smarter than this
+	if (!GetRoomBackground(who, elevation, &pictID, tiles))
 	{
-		if (wardBitSet)
-		{
-			PortabilityLayer::ResolveCachingColor blackColor = StdColors::Black();
-			backSrcMap->FillRect(localRoomsDest[where], blackColor);
-			return;
-		}
+		PortabilityLayer::ResolveCachingColor blackColor = StdColors::Black();
+		backSrcMap->FillRect(localRoomsDest[where], blackColor);
+		return;
+	}
+	
+	QSetRect(&src, 0, 0, kRoomWide, kTileHigh);
+	QSetRect(&dest, 0, 0, kRoomWide, kTileHigh);
+	QOffsetRect(&dest, localRoomsDest[where].left, localRoomsDest[where].top);
+	
+	cacheIndex = FindCachedBackground(pictID, tiles);
+	if (cacheIndex == -1)
+	{
+		WaitForLocaleBackground(pictID);
+		LoadGraphicSpecial(workSrcMap, pictID);
 		
-		if (elevation > 1)
+		cacheIndex = CacheNewBackground(pictID, tiles);
+		if (cacheIndex == -1)					// No cache, tile straight into the room
 		{
-			pictID = kSky;
-			for (i = 0; i < kNumTiles; i++)
-				tiles[i] = 2;
+			tileMap = backSrcMap;
+			tileRect = dest;
 		}
-		else if (elevation == 1)
+		else
 		{
-			pictID = kMeadow;
-			for (i = 0; i < kNumTiles; i++)
-				tiles[i] = 0;
+			tileMap = cachedBacks[cacheIndex].map;
+			tileRect = src;
 		}
-		else
+		
+		QSetRect(&tileSrc, 0, 0, kTileWide, kTileHigh);
+		tileRect.right = tileRect.left + kTileWide;
+		for (i = 0; i < kNumTiles; i++)
 		{
-			pictID = kDirt;
-			for (i = 0; i < kNumTiles; i++)
-				tiles[i] = 0;
+			tileSrc.left = tiles[i] * kTileWide;
+			tileSrc.right = tileSrc.left + kTileWide;
+			CopyBits((BitMap *)*GetGWorldPixMap(workSrcMap), 
+					(BitMap *)*GetGWorldPixMap(tileMap), 
+					&tileSrc, &tileRect, srcCopy);
+			QOffsetRect(&tileRect, kTileWide, 0);
 		}
+		
+		if (cacheIndex == -1)
+			return;
 	}
-	else
+	
+	CopyBits((BitMap *)*GetGWorldPixMap(cachedBacks[cacheIndex].map), 
+			(BitMap *)*GetGWorldPixMap(backSrcMap), 
+			&src, &dest, srcCopy);
+}
+
+//--------------------------------------------------------------  FindCachedBackground
+// Returns the index of the cached, already tiled, room backdrop matching
+// this picture and tile arrangement, or -1 if we haven't got one.
+
+short FindCachedBackground (short pictID, const short *tiles)
+{
+	short		i, t;
+	
+	for (i = 0; i < numCachedBacks; i++)
 	{
-		pictID = (*thisHouse)->rooms[who].background;
-		for (i = 0; i < kNumTiles; i++)
-			tiles[i] = (*thisHouse)->rooms[who].tiles[i];
+		if (cachedBacks[i].pictID != pictID)
+			continue;
+		
+		for (t = 0; t < kNumTiles; t++)
+		{
+			if (cachedBacks[i].tiles[t] != tiles[t])
+				break;
+		}
+		
+		if (t == kNumTiles)
+		{
+			cachedBacks[i].lastUsed = ++cachedBackClock;
+			return (i);
+		}
 	}
 	
-	LoadGraphicSpecial(workSrcMap, pictID);
+	return (-1);
+}
+
+//--------------------------------------------------------------  CacheNewBackground
+// Allocates a cache slot for a room backdrop, throwing out the least
+// recently used backdrops if we're over budget.  The caller tiles the
+// backdrop into the slot's map.  Returns -1 if there's no memory for it.
+
+short CacheNewBackground (short pictID, const short *tiles)
+{
+	Rect		bounds;
+	DrawSurface	*map;
+	PLError_t	theErr;
+	long		bytes;
+	short		i, t, oldest;
+	
+	QSetRect(&bounds, 0, 0, kRoomWide, kTileHigh);
+	theErr = CreateOffScreenGWorld(&map, &bounds);
+	if (theErr != PLErrors::kNone)
+		return (-1);
 	
-	QSetRect(&src, 0, 0, kTileWide, kTileHigh);
-	QSetRect(&dest, 0, 0, kTileWide, kTileHigh);
-	QOffsetRect(&dest, localRoomsDest[where].left, localRoomsDest[where].top);
-	for (i = 0; i < kNumTiles; i++)
+	bytes = (long)(*GetGWorldPixMap(map))->m_pitch * (long)kTileHigh;
+	
+	while ((numCachedBacks > 0) && ((numCachedBacks == kMaxCachedBacks) || 
+			(cachedBackBytes + bytes > kBackCacheBudget)))
 	{
-		src.left = tiles[i] * kTileWide;
-		src.right = src.left + kTileWide;
-		CopyBits((BitMap *)*GetGWorldPixMap(workSrcMap), 
-				(BitMap *)*GetGWorldPixMap(backSrcMap), 
-				&src, &dest, srcCopy);
-		QOffsetRect(&dest, kTileWide, 0);
+		oldest = 0;
+		for (i = 1; i < numCachedBacks; i++)
+		{
+			if (cachedBacks[i].lastUsed < cachedBacks[oldest].lastUsed)
+				oldest = i;
+		}
+		
+		DisposeGWorld(cachedBacks[oldest].map);
+		cachedBackBytes -= cachedBacks[oldest].bytes;
+		numCachedBacks--;
+		cachedBacks[oldest] = cachedBacks[numCachedBacks];
 	}
+	
+	i = numCachedBacks;
+	cachedBacks[i].map = map;
+	cachedBacks[i].bytes = bytes;
+	cachedBacks[i].lastUsed = ++cachedBackClock;
+	cachedBacks[i].pictID = pictID;
+	for (t = 0; t < kNumTiles; t++)
+		cachedBacks[i].tiles[t] = tiles[t];
+	cachedBackBytes += bytes;
+	numCachedBacks++;
+	
+	return (i);
+}
+
+//--------------------------------------------------------------  FlushBackgroundCache
+// Tosses all the cached backdrops.  Called whenever the house's pictures
+// may have changed out from under us.
+
+void FlushBackgroundCache (void)
+{
+	short		i;
+	
+	for (i = 0; i < numCachedBacks; i++)
+		DisposeGWorld(cachedBacks[i].map);
+	
+	numCachedBacks = 0;
+	cachedBackBytes = 0;
 }
 
 //--------------------------------------------------------------  DrawFloorSupport
@@ -59,6 +59,8 @@ Point		lastWhereClick;
 short		housesFound, thisHouseIndex, maxFiles, willMaxFiles;
 short		housePage, demoHouseIndex, numExtraHouses;
 char		fileFirstChar[12];
+DirectoryFileListEntry	*scannedHouseFiles[2];
+Boolean		houseFoldersScanned;
 
 extern	UInt32			doubleTime;
 
@@ -585,7 +587,11 @@ void DoDirSearch (void)
 
 		long dirID = theDirs[currentDir];
 
-		DirectoryFileListEntry *firstFile = GetDirectoryFiles(theDirs[currentDir]);
+		DirectoryFileListEntry *firstFile;
+		if ((currentDir < 2) && (houseFoldersScanned))
+			firstFile = scannedHouseFiles[currentDir];
+		else
+			firstFile = GetDirectoryFiles(theDirs[currentDir]);
 
 		for (DirectoryFileListEntry *f = firstFile; f; f = f->nextEntry)
 		{
@@ -605,6 +611,10 @@ void DoDirSearch (void)
 		currentDir++;
 	}
 	
+	houseFoldersScanned = false;
+	scannedHouseFiles[0] = nil;
+	scannedHouseFiles[1] = nil;
+	
 	if (housesFound < 1)
 	{
 		thisHouseIndex = -1;
@@ -636,6 +646,18 @@ void DoDirSearch (void)
 	}
 }
 
+//--------------------------------------------------------------  ScanHouseFolders
+// Lists the two house folders ahead of BuildHouseList(), which is most of
+// its file I/O.  DoDirSearch() uses the lists once and then goes back to
+// scanning for itself.  Only does file I/O, so it may run on any thread.
+
+void ScanHouseFolders (void)
+{
+	scannedHouseFiles[0] = GetDirectoryFiles(PortabilityLayer::VirtualDirectories::kGameData);
+	scannedHouseFiles[1] = GetDirectoryFiles(PortabilityLayer::VirtualDirectories::kUserData);
+	houseFoldersScanned = true;
+}
+
 //--------------------------------------------------------------  BuildHouseList
 
 void BuildHouseList (void)
@@ -10,7 +10,10 @@
 #include "PLSound.h"
 #include "DialogManager.h"
 #include "Externs.h"
+#include "GpIOStream.h"
+#include "IGpAudioBuffer.h"
 #include "MemoryManager.h"
+#include "ResourceLoadBatch.h"
 #include "ResourceManager.h"
 #include "SoundSync.h"
 #include "VirtualDirectory.h"
@@ -19,166 +22,403 @@
 
 #define kBaseBufferSoundID			1000
 #define kMaxSounds					64
+#define kMaxSoundPan				kRoomWide
+#define kMaxCachedSounds			96
+#define kSoundCacheBudget			(4L * 1024L * 1024L)	// bytes of samples
+#define kNumSoundChannels			4
+#define kMaxSoundVoices				32
+#define kSoundSampleRate			22254L		// bytes per second
+#define kVirtualVoice				-1
+
+
+typedef struct
+{
+	IGpAudioBuffer	*buffer;
+	long		bytes;
+	UInt32		lastUsed;
+	short		soundID;
+	Boolean		fromHouse;
+} cachedSoundType;
+
+typedef struct
+{
+	IGpAudioBuffer	*buffer;
+	long		startTick;
+	long		lengthTicks;
+	short		priority;
+	short		pan;
+	short		channel;
+} soundVoiceType;
 
 
 void CallBack0 (PortabilityLayer::AudioChannel *);
 void CallBack1 (PortabilityLayer::AudioChannel *);
 void CallBack2 (PortabilityLayer::AudioChannel *);
+void CallBack3 (PortabilityLayer::AudioChannel *);
 PLError_t LoadBufferSounds (void);
 void DumpBufferSounds (void);
 PLError_t OpenSoundChannels (void);
 void CloseSoundChannels (void);
 THandle<void> ParseAndConvertSound(const THandle<void> &handle);
-
-PortabilityLayer::AudioChannel *channel0, *channel1, *channel2;
-Ptr					theSoundData[kMaxSounds];
-short				numSoundsLoaded;
+short SoundPanForGlider (void);
+IGpAudioBuffer *DecodeSound (Boolean, short, long *);
+short GetSoundChannelPriority (const SoundSyncState &, short);
+short FindFreeSoundChannel (void);
+Boolean StartSoundVoice (short, short, long);
+void StopSoundVoice (short);
+void RemoveSoundVoice (short);
+void FlushSoundVoices (void);
+
+PortabilityLayer::AudioChannel	*soundChannels[kNumSoundChannels];
+PortabilityLayer::AudioChannelCallback_t	soundCallbacks[kNumSoundChannels] = 
+{
+	CallBack0, CallBack1, CallBack2, CallBack3
+};
+IGpAudioBuffer		*theSoundData[kMaxSounds];
+soundVoiceType		soundVoices[kMaxSoundVoices];
+short				numSoundsLoaded, numSoundVoices;
 Boolean				soundLoaded[kMaxSounds], dontLoadSounds;
 Boolean				channelOpen, isSoundOn, failedSound;
+cachedSoundType		cachedSounds[kMaxCachedSounds];
+long				cachedSoundBytes;
+UInt32				cachedSoundClock;
+short				numCachedSounds;
+
+extern	Boolean		playing, twoPlayerGame;
 
 //==============================================================  Functions
 //--------------------------------------------------------------  PlayPrioritySound
+// Sounds are voices, and only the most important few are on channels.  A
+// new sound takes a free channel, or cuts off the least important playing
+// voice if it's at least as important.  The cut-off voice (or the new one,
+// if it lost) keeps counting time as a virtual voice and picks up where it
+// would have been once a channel frees up.
 
 void PlayPrioritySound (short which, short priority)
 {
-	short		lowestPriority, whosLowest;
+	soundVoiceType	*voice;
+	long		now;
+	short		i, lowest, channel, newVoice;
 	
-	if (failedSound || dontLoadSounds)
+	if (failedSound || dontLoadSounds || !isSoundOn)
 		return;
-
-	SoundSyncState ss = SoundSync_ReadAll();
 	
-	if ((priority == kTriggerPriority) && 
-			((ss.priority0 == kTriggerPriority) ||
-			((ss.priority1 == kTriggerPriority)) ||
-			((ss.priority2 == kTriggerPriority))))
+	if (theSoundData[which] == nil)
 		return;
 	
-	whosLowest = 0;
-	lowestPriority = ss.priority0;
+	UpdateSoundVoices();
 	
-	if (ss.priority1 < lowestPriority)
+	if (priority == kTriggerPriority)
 	{
-		lowestPriority = ss.priority1;
-		whosLowest = 1;
+		for (i = 0; i < numSoundVoices; i++)
+		{
+			if (soundVoices[i].priority == kTriggerPriority)
+				return;
+		}
 	}
 	
-	if (ss.priority2 < lowestPriority)
+	if (numSoundVoices == kMaxSoundVoices)
 	{
-		lowestPriority = ss.priority2;
-		whosLowest = 2;
+		lowest = 0;
+		for (i = 1; i < numSoundVoices; i++)
+		{
+			if ((soundVoices[i].priority < soundVoices[lowest].priority) || 
+					((soundVoices[i].priority == soundVoices[lowest].priority) && 
+					(soundVoices[i].startTick < soundVoices[lowest].startTick)))
+				lowest = i;
+		}
+		
+		if (soundVoices[lowest].priority > priority)
+			return;
+		
+		StopSoundVoice(lowest);
+		RemoveSoundVoice(lowest);
 	}
 	
-	if (priority >= lowestPriority)
+	now = TickCount();
+	
+	voice = &soundVoices[numSoundVoices];
+	voice->buffer = theSoundData[which];
+	voice->buffer->AddRef();
+	voice->startTick = now;
+	voice->lengthTicks = ((long)voice->buffer->GetSize() * 60L + kSoundSampleRate - 1) / kSoundSampleRate;
+	voice->priority = priority;
+	voice->pan = SoundPanForGlider();
+	voice->channel = kVirtualVoice;
+	newVoice = numSoundVoices;
+	numSoundVoices++;
+	
+	channel = FindFreeSoundChannel();
+	if (channel == kVirtualVoice)
 	{
-		PlayExclusiveSoundChannel(whosLowest, which, lowestPriority, priority);
+		lowest = kVirtualVoice;
+		for (i = 0; i < numSoundVoices; i++)
+		{
+			if (soundVoices[i].channel == kVirtualVoice)
+				continue;
+			if ((lowest == kVirtualVoice) || 
+					(soundVoices[i].priority < soundVoices[lowest].priority) || 
+					((soundVoices[i].priority == soundVoices[lowest].priority) && 
+					(soundVoices[i].startTick < soundVoices[lowest].startTick)))
+				lowest = i;
+		}
+		
+		if ((lowest == kVirtualVoice) || (soundVoices[lowest].priority > priority))
+			return;
+		
+		channel = soundVoices[lowest].channel;
+		StopSoundVoice(lowest);
+		
+		// A sound that restarts cuts off its older self for good.  The new
+		// voice is the last one, so it's what moves into the freed slot.
+		if (soundVoices[lowest].buffer == soundVoices[newVoice].buffer)
+		{
+			RemoveSoundVoice(lowest);
+			newVoice = lowest;
+		}
 	}
+	
+	StartSoundVoice(newVoice, channel, now);
 }
 
-//--------------------------------------------------------------  FlushAnyTriggerPlaying
+//--------------------------------------------------------------  UpdateSoundVoices
+// Retires voices that have finished, then puts the most important virtual
+// voices onto any free channels.  Called every game frame.
 
-void FlushAnyTriggerPlaying (void)
+void UpdateSoundVoices (void)
 {
-	SoundSyncState ss = SoundSync_ReadAll();
+	SoundSyncState	ss;
+	long		now;
+	short		i, channel, best;
+	Boolean		finished;
+	
+	if (numSoundVoices == 0)
+		return;
 	
-	if (ss.priority0 == kTriggerPriority)
+	ss = SoundSync_ReadAll();
+	now = TickCount();
+	
+	i = 0;
+	while (i < numSoundVoices)
 	{
-		channel0->ClearAllCommands();
-		channel0->Stop();
+		if (soundVoices[i].channel != kVirtualVoice)
+			finished = (GetSoundChannelPriority(ss, soundVoices[i].channel) == 0);
+		else
+			finished = (now - soundVoices[i].startTick >= soundVoices[i].lengthTicks);
+		
+		if (finished)
+			RemoveSoundVoice(i);
+		else
+			i++;
 	}
 	
-	if (ss.priority1 == kTriggerPriority)
+	for (;;)
 	{
-		channel1->ClearAllCommands();
-		channel1->Stop();
+		channel = FindFreeSoundChannel();
+		if (channel == kVirtualVoice)
+			break;
+		
+		best = kVirtualVoice;
+		for (i = 0; i < numSoundVoices; i++)
+		{
+			if (soundVoices[i].channel != kVirtualVoice)
+				continue;
+			if ((best == kVirtualVoice) || 
+					(soundVoices[i].priority > soundVoices[best].priority) || 
+					((soundVoices[i].priority == soundVoices[best].priority) && 
+					(soundVoices[i].startTick > soundVoices[best].startTick)))
+				best = i;
+		}
+		
+		if (best == kVirtualVoice)
+			break;
+		
+		if (!StartSoundVoice(best, channel, now))
+			RemoveSoundVoice(best);
 	}
+}
+
+//--------------------------------------------------------------  StartSoundVoice
+// Puts a voice on a channel, starting as far into the sound as it would
+// have gotten by now.  Returns false if the voice couldn't be started.
+
+Boolean StartSoundVoice (short which, short channel, long now)
+{
+	soundVoiceType	*voice;
+	size_t		offset;
+	bool		succeeded;
+	
+	voice = &soundVoices[which];
 	
-	if (ss.priority2 == kTriggerPriority)
+	offset = (size_t)((now - voice->startTick) * kSoundSampleRate / 60L);
+	if (offset >= voice->buffer->GetSize())
+		return (false);
+	
+	SoundSync_PutPriority(channel, voice->priority);
+	
+	soundChannels[channel]->SetPan(voice->pan, kMaxSoundPan);
+	
+	succeeded = soundChannels[channel]->AddBufferFrom(voice->buffer, offset, false);
+	succeeded &= soundChannels[channel]->AddCallback(soundCallbacks[channel], false);
+	
+	if (!succeeded)
 	{
-		channel2->ClearAllCommands();
-		channel2->Stop();
+		SoundSync_ClearPriority(channel);
+		return (false);
 	}
+	
+	voice->channel = channel;
+	return (true);
 }
 
-//--------------------------------------------------------------  CallBack0
+//--------------------------------------------------------------  StopSoundVoice
+// Takes a voice off its channel, leaving it virtual.
 
-void CallBack0(PortabilityLayer::AudioChannel *theChannel)
+void StopSoundVoice (short which)
 {
-	SoundSync_ClearPriority(0);
+	short		channel;
+	
+	channel = soundVoices[which].channel;
+	if (channel == kVirtualVoice)
+		return;
+	
+	// Flush the queue and stop the channel, which will remove the pending callback
+	soundChannels[channel]->ClearAllCommands();
+	soundChannels[channel]->Stop();
+	
+	SoundSync_ClearPriority(channel);
+	soundVoices[which].channel = kVirtualVoice;
 }
 
-//--------------------------------------------------------------  CallBack1
+//--------------------------------------------------------------  RemoveSoundVoice
 
-void CallBack1(PortabilityLayer::AudioChannel *theChannel)
+void RemoveSoundVoice (short which)
 {
-	SoundSync_ClearPriority(1);
+	soundVoices[which].buffer->Release();
+	numSoundVoices--;
+	soundVoices[which] = soundVoices[numSoundVoices];
 }
 
-//--------------------------------------------------------------  CallBack2
+//--------------------------------------------------------------  FlushSoundVoices
 
-void CallBack2(PortabilityLayer::AudioChannel *theChannel)
+void FlushSoundVoices (void)
 {
-	SoundSync_ClearPriority(2);
+	while (numSoundVoices > 0)
+	{
+		StopSoundVoice(numSoundVoices - 1);
+		RemoveSoundVoice(numSoundVoices - 1);
+	}
 }
 
-//--------------------------------------------------------------  PlaySound0
+//--------------------------------------------------------------  FlushAnyTriggerPlaying
 
-void PlayExclusiveSoundChannel(short channelIndex, short soundID, short oldPriority, short newPriority)
-{	
-	if (failedSound || dontLoadSounds)
-		return;
+void FlushAnyTriggerPlaying (void)
+{
+	short		i;
+	
+	i = 0;
+	while (i < numSoundVoices)
+	{
+		if (soundVoices[i].priority == kTriggerPriority)
+		{
+			StopSoundVoice(i);
+			RemoveSoundVoice(i);
+		}
+		else
+			i++;
+	}
+}
 
-	PortabilityLayer::AudioChannel *channel = nil;
-	PortabilityLayer::AudioChannelCallback_t callback = nil;
+//--------------------------------------------------------------  GetSoundChannelPriority
 
-	switch (channelIndex)
+short GetSoundChannelPriority (const SoundSyncState &ss, short channel)
+{
+	switch (channel)
 	{
 	case 0:
-		channel = channel0;
-		callback = CallBack0;
-		break;
+		return (ss.priority0);
 	case 1:
-		channel = channel1;
-		callback = CallBack1;
-		break;
+		return (ss.priority1);
 	case 2:
-		channel = channel2;
-		callback = CallBack2;
-		break;
+		return (ss.priority2);
+	case 3:
+		return (ss.priority3);
 	default:
-		return;
+		return (0);
 	}
+}
 
-	if (isSoundOn)
+//--------------------------------------------------------------  FindFreeSoundChannel
+// Returns a channel that no voice is on, or kVirtualVoice if they're all
+// taken.
+
+short FindFreeSoundChannel (void)
+{
+	short		channel, i;
+	Boolean		taken;
+	
+	for (channel = 0; channel < kNumSoundChannels; channel++)
 	{
-		if (oldPriority != 0)
+		taken = false;
+		for (i = 0; i < numSoundVoices; i++)
 		{
-			// Flush the queue and stop the channel, which will remove the pending callback
-			channel->ClearAllCommands();
-			channel->Stop();
-
-			SoundSync_ClearPriority(channelIndex);
+			if (soundVoices[i].channel == channel)
+				taken = true;
 		}
-
-		SoundSync_PutPriority(channelIndex, newPriority);
-
-		bool succeeded = channel->AddBuffer(theSoundData[soundID], false);
-		succeeded &= channel->AddCallback(callback, false);
 		
-		if (!succeeded)
-			SoundSync_ClearPriority(channelIndex);
+		if (!taken)
+			return (channel);
 	}
+	
+	return (kVirtualVoice);
 }
 
-//--------------------------------------------------------------  ParseAndConvertSound
+//--------------------------------------------------------------  CallBack0
+
+void CallBack0(PortabilityLayer::AudioChannel *theChannel)
+{
+	SoundSync_ClearPriority(0);
+}
+
+//--------------------------------------------------------------  CallBack1
+
+void CallBack1(PortabilityLayer::AudioChannel *theChannel)
+{
+	SoundSync_ClearPriority(1);
+}
 
+//--------------------------------------------------------------  CallBack2
+
+void CallBack2(PortabilityLayer::AudioChannel *theChannel)
+{
+	SoundSync_ClearPriority(2);
+}
+
+//--------------------------------------------------------------  CallBack3
+
+void CallBack3(PortabilityLayer::AudioChannel *theChannel)
+{
+	SoundSync_ClearPriority(3);
+}
+
+//--------------------------------------------------------------  SoundPanForGlider
+
+// Pans sounds toward the side of the room the glider is on.  The glider
+// at a room edge is only panned halfway, since kMaxSoundPan is the full
+// room width.  With two gliders (or no game going) sounds stay centered.
+
+short SoundPanForGlider (void)
+{
+	if ((!playing) || (twoPlayerGame))
+		return (0);
+	
+	return ((theGlider.dest.left + theGlider.dest.right) / 2 - kRoomWide / 2);
+}
 
 //--------------------------------------------------------------  LoadTriggerSound
 
 PLError_t LoadTriggerSound (short soundID)
 {
-	Handle		theSound;
-	long		soundDataSize;
 	PLError_t		theErr;
 	
 	if ((dontLoadSounds) || (theSoundData[kMaxSounds - 1] != nil))
@@ -189,26 +429,9 @@ PLError_t LoadTriggerSound (short soundID)
 		
 		theErr = PLErrors::kNone;
 		
-		theSound = ParseAndConvertSound(LoadHouseResource('snd ', soundID));
-		if (theSound == nil)
-		{
+		theSoundData[kMaxSounds - 1] = GetCachedSound(true, soundID);
+		if (theSoundData[kMaxSounds - 1] == nil)
 			theErr = PLErrors::kFileNotFound;
-		}
-		else
-		{
-			soundDataSize = GetHandleSize(theSound);
-			theSoundData[kMaxSounds - 1] = PortabilityLayer::MemoryManager::GetInstance()->Alloc(soundDataSize);
-			if (theSoundData[kMaxSounds - 1] == nil)
-			{
-				theSound.Dispose();
-				theErr = PLErrors::kOutOfMemory;
-			}
-			else
-			{
-				memcpy(theSoundData[kMaxSounds - 1], (Byte*)(*theSound), soundDataSize);
-				theSound.Dispose();
-			}
-		}
 	}
 	
 	return (theErr);
@@ -219,37 +442,55 @@ PLError_t LoadTriggerSound (short soundID)
 void DumpTriggerSound (void)
 {
 	if (theSoundData[kMaxSounds - 1] != nil)
-		PortabilityLayer::MemoryManager::GetInstance()->Release(theSoundData[kMaxSounds - 1]);
+		theSoundData[kMaxSounds - 1]->Release();
 	theSoundData[kMaxSounds - 1] = nil;
 }
 
 //--------------------------------------------------------------  LoadBufferSounds
+// The buffer sounds are all read ahead at once on the loader threads, and
+// each one is decoded here as soon as it comes in.
 
 PLError_t LoadBufferSounds (void)
 {
-	Handle		theSound;
-	long		soundDataSize;
+	PortabilityLayer::ResourceLoadRequest	requests[kMaxSounds - 1];
+	PortabilityLayer::ResourceLoadBatch		*batch;
 	PLError_t		theErr;
-	short		i;
+	size_t			index;
+	short			i, n;
 	
 	theErr = PLErrors::kNone;
 	
 	for (i = 0; i < kMaxSounds - 1; i++)
 	{
-		theSound = ParseAndConvertSound(PortabilityLayer::ResourceManager::GetInstance()->GetAppResource('snd ', i + kBaseBufferSoundID));
-		if (theSound == nil)
-			return (PLErrors::kOutOfMemory);
-		
-		soundDataSize = GetHandleSize(theSound);
+		requests[i].m_archive = PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive();
+		requests[i].m_fallbackArchive = nil;
+		requests[i].m_resTypeID = 'snd ';
+		requests[i].m_resID = i + kBaseBufferSoundID;
+	}
+	
+	batch = PortabilityLayer::ResourceLoadBatch::Create(requests, kMaxSounds - 1);
+	
+	for (n = 0; n < kMaxSounds - 1; n++)
+	{
+		if (batch == nil)		// Just read them one at a time
+			i = n;
+		else
+		{
+			batch->WaitForNextItem(index);
+			i = (short)index;
+		}
 		
-		theSoundData[i] = PortabilityLayer::MemoryManager::GetInstance()->Alloc(soundDataSize);
+		theSoundData[i] = GetCachedSound(false, i + kBaseBufferSoundID);
 		if (theSoundData[i] == nil)
-			return (PLErrors::kOutOfMemory);
-		
-		memcpy(theSoundData[i], *theSound, soundDataSize);
-		theSound.Dispose();
+		{
+			theErr = PLErrors::kOutOfMemory;
+			break;
+		}
 	}
 	
+	if (batch != nil)
+		batch->Destroy();
+	
 	theSoundData[kMaxSounds - 1] = nil;
 	
 	return (theErr);
@@ -264,7 +505,7 @@ void DumpBufferSounds (void)
 	for (i = 0; i < kMaxSounds; i++)
 	{
 		if (theSoundData[i] != nil)
-			PortabilityLayer::MemoryManager::GetInstance()->Release(theSoundData[i]);
+			theSoundData[i]->Release();
 		theSoundData[i] = nil;
 	}
 }
@@ -273,26 +514,19 @@ void DumpBufferSounds (void)
 
 PLError_t OpenSoundChannels (void)
 {
+	short		i;
+	
 	if (channelOpen)
 		return PLErrors::kAudioError;
 	
-	channel0 = PortabilityLayer::SoundSystem::GetInstance()->CreateChannel();
-	if (channel0)
-		channelOpen = true;
-	else
-		return PLErrors::kAudioError;
-
-	channel1 = PortabilityLayer::SoundSystem::GetInstance()->CreateChannel();
-	if (channel1)
-		channelOpen = true;
-	else
-		return PLErrors::kAudioError;
-
-	channel2 = PortabilityLayer::SoundSystem::GetInstance()->CreateChannel();
-	if (channel2)
-		channelOpen = true;
-	else
-		return PLErrors::kAudioError;
+	for (i = 0; i < kNumSoundChannels; i++)
+	{
+		soundChannels[i] = PortabilityLayer::SoundSystem::GetInstance()->CreateChannel();
+		if (soundChannels[i])
+			channelOpen = true;
+		else
+			return PLErrors::kAudioError;
+	}
 	
 	return PLErrors::kNone;
 }
@@ -301,20 +535,19 @@ PLError_t OpenSoundChannels (void)
 
 void CloseSoundChannels (void)
 {
+	short		i;
+	
 	if (!channelOpen)
 		return;
 	
-	if (channel0 != nil)
-		channel0->Destroy(false);
-	channel0 = nil;
-	
-	if (channel1 != nil)
-		channel1->Destroy(false);
-	channel1 = nil;
+	FlushSoundVoices();
 	
-	if (channel2 != nil)
-		channel2->Destroy(false);
-	channel2 = nil;
+	for (i = 0; i < kNumSoundChannels; i++)
+	{
+		if (soundChannels[i] != nil)
+			soundChannels[i]->Destroy(false);
+		soundChannels[i] = nil;
+	}
 
 	channelOpen = false;
 }
@@ -324,19 +557,19 @@ void CloseSoundChannels (void)
 void InitSound (void)
 {
 	PLError_t		theErr;
+	short		i;
 		
 	if (dontLoadSounds)
 		return;
 	
 	failedSound = false;
+	numSoundVoices = 0;
 	
-	channel0 = nil;
-	channel1 = nil;
-	channel2 = nil;
-
-	SoundSync_ClearPriority(0);
-	SoundSync_ClearPriority(1);
-	SoundSync_ClearPriority(2);
+	for (i = 0; i < kNumSoundChannels; i++)
+	{
+		soundChannels[i] = nil;
+		SoundSync_ClearPriority(i);
+	}
 	
 	theErr = LoadBufferSounds();
 	if (theErr != PLErrors::kNone)
@@ -365,6 +598,123 @@ void KillSound (void)
 	
 	CloseSoundChannels();
 	DumpBufferSounds();
+	FlushSoundCache();
+}
+
+//--------------------------------------------------------------  DecodeSound
+// Loads a sound resource from the app or the current house and hands it
+// to the sound system.  The decoded size comes back in bytes.
+
+IGpAudioBuffer *DecodeSound (Boolean fromHouse, short soundID, long *bytes)
+{
+	Handle		theSound;
+	IGpAudioBuffer	*buffer;
+	
+	if (fromHouse)
+		theSound = ParseAndConvertSound(LoadHouseResource('snd ', soundID));
+	else
+		theSound = ParseAndConvertSound(PortabilityLayer::ResourceManager::GetInstance()->GetAppResource('snd ', soundID));
+	if (theSound == nil)
+		return (nil);
+	
+	*bytes = GetHandleSize(theSound) - 4;
+	buffer = PortabilityLayer::SoundSystem::GetInstance()->CreateBuffer(*theSound);
+	theSound.Dispose();
+	
+	return (buffer);
+}
+
+//--------------------------------------------------------------  GetCachedSound
+// Returns a decoded sound, decoding it only if it isn't cached yet.  Sound
+// effects and trigger sounds share the one cache.  The caller
+// gets its own reference and must Release() it when done.  Throwing a
+// sound out of the cache only drops the cache's reference, so sounds that
+// are still in use stay alive until their players let go of them.
+
+IGpAudioBuffer *GetCachedSound (Boolean fromHouse, short soundID)
+{
+	IGpAudioBuffer	*buffer;
+	long		bytes;
+	short		i, oldest;
+	
+	for (i = 0; i < numCachedSounds; i++)
+	{
+		if ((cachedSounds[i].soundID == soundID) && 
+				(cachedSounds[i].fromHouse == fromHouse))
+		{
+			cachedSounds[i].lastUsed = ++cachedSoundClock;
+			cachedSounds[i].buffer->AddRef();
+			return (cachedSounds[i].buffer);
+		}
+	}
+	
+	buffer = DecodeSound(fromHouse, soundID, &bytes);
+	if (buffer == nil)
+		return (nil);
+	
+	while ((numCachedSounds > 0) && ((numCachedSounds == kMaxCachedSounds) || 
+			(cachedSoundBytes + bytes > kSoundCacheBudget)))
+	{
+		oldest = 0;
+		for (i = 1; i < numCachedSounds; i++)
+		{
+			if (cachedSounds[i].lastUsed < cachedSounds[oldest].lastUsed)
+				oldest = i;
+		}
+		
+		cachedSounds[oldest].buffer->Release();
+		cachedSoundBytes -= cachedSounds[oldest].bytes;
+		numCachedSounds--;
+		cachedSounds[oldest] = cachedSounds[numCachedSounds];
+	}
+	
+	i = numCachedSounds;
+	cachedSounds[i].buffer = buffer;
+	cachedSounds[i].bytes = bytes;
+	cachedSounds[i].lastUsed = ++cachedSoundClock;
+	cachedSounds[i].soundID = soundID;
+	cachedSounds[i].fromHouse = fromHouse;
+	cachedSoundBytes += bytes;
+	numCachedSounds++;
+	
+	buffer->AddRef();
+	return (buffer);
+}
+
+//--------------------------------------------------------------  FlushHouseSounds
+// Drops the cached sounds that came out of the house.  Called when the
+// house's resources go away, since another house reuses the same IDs.
+
+void FlushHouseSounds (void)
+{
+	short		i;
+	
+	i = 0;
+	while (i < numCachedSounds)
+	{
+		if (cachedSounds[i].fromHouse)
+		{
+			cachedSounds[i].buffer->Release();
+			cachedSoundBytes -= cachedSounds[i].bytes;
+			numCachedSounds--;
+			cachedSounds[i] = cachedSounds[numCachedSounds];
+		}
+		else
+			i++;
+	}
+}
+
+//--------------------------------------------------------------  FlushSoundCache
+
+void FlushSoundCache (void)
+{
+	short		i;
+	
+	for (i = 0; i < numCachedSounds; i++)
+		cachedSounds[i].buffer->Release();
+	
+	numCachedSounds = 0;
+	cachedSoundBytes = 0;
 }
 
 //--------------------------------------------------------------  TellHerNoSounds
@@ -518,3 +868,65 @@ THandle<void> ParseAndConvertSound(const THandle<void> &handle)
 
 	return converted;
 }
+
+//--------------------------------------------------------------  FindWaveSoundData
+// Streaming counterpart of ParseAndConvertSound.  Reads a WAV header from
+// the stream, checks that it's 8-bit mono PCM, and leaves the stream at
+// the start of the sample data.  The format chunk must come first.
+
+Boolean FindWaveSoundData (GpIOStream *stream, UInt32 *dataSize)
+{
+	PortabilityLayer::RIFFTag				riffTag;
+	PortabilityLayer::WaveFormatChunkV1		formatChunk;
+	LEUInt32_t			waveMarker;
+	UInt32				chunkSize;
+	Boolean				hasFormat;
+	
+	if (!stream->ReadExact(&riffTag, sizeof(riffTag)) || 
+			(riffTag.m_tag != PortabilityLayer::WaveConstants::kRiffChunkID))
+		return (false);
+	
+	if (!stream->ReadExact(&waveMarker, sizeof(waveMarker)) || 
+			(waveMarker != PortabilityLayer::WaveConstants::kWaveChunkID))
+		return (false);
+	
+	hasFormat = false;
+	for (;;)
+	{
+		if (!stream->ReadExact(&riffTag, sizeof(riffTag)))
+			return (false);
+		
+		chunkSize = riffTag.m_chunkSize;
+		if (chunkSize == 0xffffffffU)
+			return (false);
+		
+		if (riffTag.m_tag == PortabilityLayer::WaveConstants::kDataChunkID)
+		{
+			if (!hasFormat)
+				return (false);
+			
+			*dataSize = chunkSize;
+			return (true);
+		}
+		
+		if (riffTag.m_tag == PortabilityLayer::WaveConstants::kFormatChunkID)
+		{
+			if (chunkSize < sizeof(formatChunk))
+				return (false);
+			if (!stream->ReadExact(&formatChunk, sizeof(formatChunk)))
+				return (false);
+			
+			if (formatChunk.m_formatCode != PortabilityLayer::WaveConstants::kFormatPCM || 
+					formatChunk.m_numChannels != 1 || 
+					formatChunk.m_blockAlignmentBytes != 1 || 
+					formatChunk.m_bitsPerSample != 8)
+				return (false);
+			
+			hasFormat = true;
+			chunkSize -= sizeof(formatChunk);
+		}
+		
+		if (!stream->SeekCurrent(chunkSize + (riffTag.m_chunkSize & 1)))
+			return (false);
+	}
+}
@@ -0,0 +1,295 @@
+//============================================================================
+//----------------------------------------------------------------------------
+//								Startup.c
+//----------------------------------------------------------------------------
+//============================================================================
+
+
+#include "Externs.h"
+#include "GpIOStream.h"
+#include "IGpFileSystem.h"
+#include "IGpLogDriver.h"
+#include "IGpSystemServices.h"
+#include "JobSystem.h"
+#include "PLDrivers.h"
+#include "VirtualDirectory.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+
+
+#define kStartupScanHouseFolders	6		// Background steps follow the
+#define kNumStartupSteps			7		// main thread steps in Externs.h
+#define kNoStartupStep				-1
+#define kMaxStartupDepends			2
+#define kMaxStartupSpans			64
+#define kMainStartupThread			0
+
+
+typedef struct
+{
+	const char	*name;
+	void		(*proc)(void);
+	Boolean		onMainThread;
+	short		dependsOn[kMaxStartupDepends];
+} startupStepType;
+
+typedef struct
+{
+	const char	*name;
+	long long	start, duration;		// microseconds since BeginStartup()
+	short		thread;
+} startupSpanType;
+
+
+void ReadInPrefs (void);
+void OpenStartupHouse (void);
+long long StartupMicroseconds (void);
+short StartupThreadIndex (void);
+void RecordStartupSpan (const char *, long long);
+void RunBackgroundStep (void *);
+void WaitForStartupStep (short);
+void WriteStartupTrace (void);
+
+
+// Main thread steps are run by RunStartupStep() from gpAppMain() in the
+// order they're listed there, so they only need to name the background
+// steps that they read from.  Background steps are handed to the job system
+// as soon as BeginStartup() is called.
+
+static const startupStepType	startupSteps[kNumStartupSteps] =
+{
+	{ "ReadInPrefs", ReadInPrefs, true, { kNoStartupStep, kNoStartupStep } },
+	{ "CreateOffscreens", CreateOffscreens, true, { kStartupReadPrefs, kNoStartupStep } },
+	{ "InitSound", InitSound, true, { kNoStartupStep, kNoStartupStep } },
+	{ "InitMusic", InitMusic, true, { kNoStartupStep, kNoStartupStep } },
+	{ "BuildHouseList", BuildHouseList, true, { kStartupReadPrefs, kStartupScanHouseFolders } },
+	{ "OpenHouse", OpenStartupHouse, true, { kStartupBuildHouseList, kNoStartupStep } },
+	{ "ScanHouseFolders", ScanHouseFolders, false, { kNoStartupStep, kNoStartupStep } }
+};
+
+PortabilityLayer::Job		*startupJobs[kNumStartupSteps];
+Boolean						startupStepDone[kNumStartupSteps];
+startupSpanType				startupSpans[kMaxStartupSpans];
+std::atomic<int>			numStartupSpans, numStartupThreads;
+std::chrono::steady_clock::time_point	startupEpoch;
+
+static thread_local short	startupThread = -1;
+
+
+//==============================================================  Functions
+//--------------------------------------------------------------  OpenStartupHouse
+
+void OpenStartupHouse (void)
+{
+	OpenHouse(true);
+}
+
+//--------------------------------------------------------------  StartupMicroseconds
+
+long long StartupMicroseconds (void)
+{
+	return (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startupEpoch).count());
+}
+
+//--------------------------------------------------------------  StartupThreadIndex
+// Numbers the threads in the order they first record a span.  The main
+// thread is always thread 0.
+
+short StartupThreadIndex (void)
+{
+	if (startupThread < 0)
+		startupThread = (short)(numStartupThreads.fetch_add(1) + 1);
+	
+	return (startupThread);
+}
+
+//--------------------------------------------------------------  RecordStartupSpan
+// Records a span that began at startTime and ends now.  Spans past the
+// end of the table are dropped.
+
+void RecordStartupSpan (const char *name, long long startTime)
+{
+	long long	now;
+	int			index;
+	
+	now = StartupMicroseconds();
+	index = numStartupSpans.fetch_add(1);
+	if (index >= kMaxStartupSpans)
+		return;
+	
+	startupSpans[index].name = name;
+	startupSpans[index].start = startTime;
+	startupSpans[index].duration = now - startTime;
+	startupSpans[index].thread = StartupThreadIndex();
+}
+
+//--------------------------------------------------------------  RunBackgroundStep
+
+void RunBackgroundStep (void *context)
+{
+	const startupStepType	*theStep;
+	long long	startTime;
+	
+	theStep = static_cast<const startupStepType *>(context);
+	startTime = StartupMicroseconds();
+	theStep->proc();
+	RecordStartupSpan(theStep->name, startTime);
+}
+
+//--------------------------------------------------------------  BeginStartup
+// Starts the clock, submits every background step and queues up the reads
+// for CreateOffscreens().  Must be called from the main thread after PL_Init().
+
+void BeginStartup (void)
+{
+	PortabilityLayer::JobSystem	*jobSystem;
+	PortabilityLayer::Job		*depends[kMaxStartupDepends];
+	short		i, d, numDepends;
+	
+	startupEpoch = std::chrono::steady_clock::now();
+	startupThread = kMainStartupThread;
+	numStartupSpans = 0;
+	numStartupThreads = 0;
+	
+	jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	
+	for (i = 0; i < kNumStartupSteps; i++)
+	{
+		startupJobs[i] = nil;
+		startupStepDone[i] = false;
+		if (startupSteps[i].onMainThread)
+			continue;
+		
+		numDepends = 0;
+		for (d = 0; d < kMaxStartupDepends; d++)
+		{
+			if (startupSteps[i].dependsOn[d] == kNoStartupStep)
+				continue;
+			assert(!startupSteps[startupSteps[i].dependsOn[d]].onMainThread);
+			assert(startupSteps[i].dependsOn[d] < i);
+			depends[numDepends++] = startupJobs[startupSteps[i].dependsOn[d]];
+		}
+		
+		startupJobs[i] = jobSystem->SubmitJob(RunBackgroundStep,
+				const_cast<startupStepType *>(&startupSteps[i]), depends, numDepends);
+	}
+	
+	QueueOffscreenGraphics();
+}
+
+//--------------------------------------------------------------  WaitForStartupStep
+// Background steps are waited on, with the time spent waiting recorded
+// as a span of its own.  Main thread steps must simply have run already.
+
+void WaitForStartupStep (short which)
+{
+	long long	startTime;
+	
+	if (startupSteps[which].onMainThread)
+	{
+		assert(startupStepDone[which]);
+		return;
+	}
+	
+	if (startupJobs[which] == nil)		// Ran when it was submitted, or already waited for
+		return;
+	
+	if (!PortabilityLayer::JobSystem::GetInstance()->IsJobFinished(startupJobs[which]))
+	{
+		startTime = StartupMicroseconds();
+		PortabilityLayer::JobSystem::GetInstance()->WaitForJob(startupJobs[which]);
+		RecordStartupSpan("Wait", startTime);
+	}
+	
+	PortabilityLayer::JobSystem::GetInstance()->ReleaseJob(startupJobs[which]);
+	startupJobs[which] = nil;
+}
+
+//--------------------------------------------------------------  RunStartupStep
+// Runs one of the main thread steps once the steps it depends on are done.
+
+void RunStartupStep (short which)
+{
+	long long	startTime;
+	short		d;
+	
+	assert(startupSteps[which].onMainThread);
+	
+	for (d = 0; d < kMaxStartupDepends; d++)
+	{
+		if (startupSteps[which].dependsOn[d] != kNoStartupStep)
+			WaitForStartupStep(startupSteps[which].dependsOn[d]);
+	}
+	
+	startTime = StartupMicroseconds();
+	startupSteps[which].proc();
+	RecordStartupSpan(startupSteps[which].name, startTime);
+	
+	startupStepDone[which] = true;
+}
+
+//--------------------------------------------------------------  WriteStartupTrace
+// Writes the spans out in the Chrome trace event format, which can be
+// loaded into chrome://tracing or Perfetto.
+
+void WriteStartupTrace (void)
+{
+	GpIOStream	*stream;
+	char		line[256];
+	int			i, numSpans, length;
+	
+	stream = PLDrivers::GetFileSystem()->OpenFile(PortabilityLayer::VirtualDirectories::kPrefs,
+			"StartupTrace.json", true, GpFileCreationDispositions::kCreateOrOverwrite);
+	if (stream == nil)
+		return;
+	
+	numSpans = numStartupSpans;
+	if (numSpans > kMaxStartupSpans)
+		numSpans = kMaxStartupSpans;
+	
+	length = snprintf(line, sizeof(line), "{\"traceEvents\":[\n");
+	stream->Write(line, length);
+	
+	for (i = 0; i < numSpans; i++)
+	{
+		length = snprintf(line, sizeof(line),
+				"{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}%s\n",
+				startupSpans[i].name, (int)startupSpans[i].thread, startupSpans[i].start,
+				startupSpans[i].duration, (i == numSpans - 1) ? "" : ",");
+		if ((length > 0) && (length < (int)sizeof(line)))
+			stream->Write(line, length);
+	}
+	
+	length = snprintf(line, sizeof(line), "]}\n");
+	stream->Write(line, length);
+	
+	stream->Close();
+}
+
+//--------------------------------------------------------------  EndStartup
+// Waits for anything still running in the background, writes the trace
+// if the host asked for one, and logs how long startup took.
+
+void EndStartup (void)
+{
+	IGpLogDriver	*logger;
+	short		i;
+	
+	for (i = 0; i < kNumStartupSteps; i++)
+	{
+		if (!startupSteps[i].onMainThread)
+			WaitForStartupStep(i);
+	}
+	
+	RecordStartupSpan("Startup", 0);
+	if (PLDrivers::GetSystemServices()->IsStartupTraceEnabled())
+		WriteStartupTrace();
+	
+	logger = PLDrivers::GetLogDriver();
+	if (logger != nil)
+		logger->Printf(IGpLogDriver::Category_Information, "Startup took %lld us on %u job workers",
+				StartupMicroseconds(), PortabilityLayer::JobSystem::GetInstance()->GetNumWorkers());
+}
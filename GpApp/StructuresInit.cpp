@@ -14,6 +14,7 @@
 #include "Play.h"
 #include "Player.h"
 #include "RectUtils.h"
+#include "ResourceLoadBatch.h"
 #include "ResourceManager.h"
 #include "RubberBands.h"
 #include "Scoreboard.h"
@@ -41,6 +42,38 @@
 #define kFishPictID				4017
 
 #define kBadgePictID			1996
+#define kNumStructurePicts		(sizeof(structurePictIDs) / sizeof(structurePictIDs[0]))
+
+
+static const short	structurePictIDs[] =
+{
+	kScoreboardPictID, kBadgePictID,
+	kGliderPictID, kGlider2PictID, kGliderPictID + 1000,
+	kShadowPictID, kShadowPictID + 1000,
+	kRubberBandsPictID, kRubberBandsPictID + 1000,
+	kBlowerPictID, kBlowerPictID + 1000,
+	kFurniturePictID, kFurniturePictID + 1000,
+	kBonusPictID, kBonusPictID + 1000,
+	kPointsPictID, kPointsPictID + 1000,
+	kTransportPictID, kTransportPictID + 1000,
+	kSwitchPictID,
+	kLightPictID, kLightPictID + 1000,
+	kAppliancePictID, kAppliancePictID + 1000,
+	kToastPictID, kToastPictID + 1000,
+	kShreddedPictID, kShreddedPictID + 1000,
+	kBalloonPictID, kBalloonPictID + 1000,
+	kCopterPictID, kCopterPictID + 1000,
+	kDartPictID, kDartPictID + 1000,
+	kBallPictID, kBallPictID + 1000,
+	kDripPictID, kDripPictID + 1000,
+	kEnemyPictID, kEnemyPictID + 1000,
+	kFishPictID, kFishPictID + 1000,
+	kClutterPictID, kClutterPictID + 1000,
+	kSupportPictID,
+	kAngelPictID, kAngelPictID + 1
+};
+
+PortabilityLayer::ResourceLoadBatch	*offscreenBatch;
 
 
 extern	Rect		glidSrcRect, leftStartGliderSrc, rightStartGliderSrc;
@@ -623,3 +656,40 @@ void InitEnemies (void)
 	}
 }
 
+//--------------------------------------------------------------  QueueOffscreenGraphics
+// Starts reading every picture that CreateOffscreens() loads on the resource
+// loader threads, in the order that it loads them.  Called from the main
+// thread, since the batch may only be used from the thread that made it.
+
+void QueueOffscreenGraphics (void)
+{
+	PortabilityLayer::ResourceLoadRequest	requests[kNumStructurePicts];
+	PortabilityLayer::IResourceArchive	*appArchive;
+	size_t		i;
+	
+	appArchive = PortabilityLayer::ResourceManager::GetInstance()->GetAppResourceArchive();
+	if (appArchive == nil)
+		return;
+	
+	for (i = 0; i < kNumStructurePicts; i++)
+	{
+		requests[i].m_archive = appArchive;
+		requests[i].m_fallbackArchive = nil;
+		requests[i].m_resTypeID = PortabilityLayer::ResTypeID('PICT');
+		requests[i].m_resID = structurePictIDs[i];
+	}
+	
+	offscreenBatch = PortabilityLayer::ResourceLoadBatch::Create(requests, kNumStructurePicts);
+}
+
+//--------------------------------------------------------------  DoneWithOffscreenGraphics
+// Called once CreateOffscreens() has loaded everything it queued.
+
+void DoneWithOffscreenGraphics (void)
+{
+	if (offscreenBatch != nil)
+	{
+		offscreenBatch->Destroy();
+		offscreenBatch = nil;
+	}
+}
@@ -19,11 +19,6 @@
 #include "Utilities.h"
 
 
-#define kAngelPictID			1019
-#define kSupportPictID			1999
-#define kClutterPictID			4018
-
-
 void InitClutter (void);
 void InitSupport (void);
 void InitAngel (void);
@@ -164,6 +159,7 @@ void CreateOffscreens (void)
 	InitClutter();			SpinCursor(1);
 	InitSupport();			SpinCursor(1);
 	InitAngel();			SpinCursor(1);
+	DoneWithOffscreenGraphics();
 	
 	QSetRect(&tileSrcRect, 0, 0, 128, 80);
 	tileSrcMap = nil;
@@ -0,0 +1,52 @@
+#include "GpAudioBufferXAudio2.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+GpAudioBufferXAudio2 *GpAudioBufferXAudio2::Create(const void *data, size_t size)
+{
+	void *storage = malloc(sizeof(GpAudioBufferXAudio2) + size);
+	if (!storage)
+		return nullptr;
+
+	uint8_t *dataCopy = static_cast<uint8_t*>(storage) + sizeof(GpAudioBufferXAudio2);
+	memcpy(dataCopy, data, size);
+
+	return new (storage) GpAudioBufferXAudio2(dataCopy, size);
+}
+
+void GpAudioBufferXAudio2::AddRef()
+{
+	m_refCount.fetch_add(1);
+}
+
+void GpAudioBufferXAudio2::Release()
+{
+	if (m_refCount.fetch_sub(1) == 1)
+	{
+		this->~GpAudioBufferXAudio2();
+		free(this);
+	}
+}
+
+const uint8_t *GpAudioBufferXAudio2::GetData() const
+{
+	return m_data;
+}
+
+size_t GpAudioBufferXAudio2::GetSize() const
+{
+	return m_size;
+}
+
+GpAudioBufferXAudio2::GpAudioBufferXAudio2(uint8_t *data, size_t size)
+	: m_refCount(1)
+	, m_data(data)
+	, m_size(size)
+{
+}
+
+GpAudioBufferXAudio2::~GpAudioBufferXAudio2()
+{
+}
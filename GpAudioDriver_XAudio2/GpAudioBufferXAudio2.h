@@ -0,0 +1,27 @@
+#pragma once
+
+#include "IGpAudioBuffer.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class GpAudioBufferXAudio2 final : public IGpAudioBuffer
+{
+public:
+	static GpAudioBufferXAudio2 *Create(const void *data, size_t size);
+
+	void AddRef() override;
+	void Release() override;
+
+	const uint8_t *GetData() const;
+	size_t GetSize() const override;
+
+private:
+	GpAudioBufferXAudio2(uint8_t *data, size_t size);
+	~GpAudioBufferXAudio2();
+
+	std::atomic<unsigned int> m_refCount;
+	uint8_t *m_data;
+	size_t m_size;
+};
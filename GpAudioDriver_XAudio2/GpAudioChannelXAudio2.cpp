@@ -1,8 +1,10 @@
 #include "GpAudioChannelXAudio2.h"
+#include "GpAudioBufferXAudio2.h"
 #include "GpAudioDriverXAudio2.h"
 #include "IGpAudioChannelCallbacks.h"
 #include "IGpLogDriver.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <new>
 
@@ -77,20 +79,34 @@ void GpAudioChannelXAudio2::SetAudioChannelContext(IGpAudioChannelCallbacks *cal
 	m_contextCallbacks = callbacks;
 }
 
-void GpAudioChannelXAudio2::PostBuffer(const void *buffer, size_t bufferSize)
+void GpAudioChannelXAudio2::PostBuffer(IGpAudioBuffer *buffer, size_t startOffset)
 {
+	GpAudioBufferXAudio2 *xa2AudioBuffer = static_cast<GpAudioBufferXAudio2*>(buffer);
+
+	// Samples are 8-bit mono, so the offset is also in samples.  XAudio2 needs at least one sample to play.
+	const size_t size = xa2AudioBuffer->GetSize();
+	if (startOffset >= size)
+		startOffset = (size > 0) ? size - 1 : 0;
+
 	XAUDIO2_BUFFER xa2Buffer;
 	xa2Buffer.Flags = 0;
-	xa2Buffer.AudioBytes = static_cast<UINT32>(bufferSize);
-	xa2Buffer.pAudioData = static_cast<const BYTE*>(buffer);
-	xa2Buffer.PlayBegin = 0;
+	xa2Buffer.AudioBytes = static_cast<UINT32>(xa2AudioBuffer->GetSize());
+	xa2Buffer.pAudioData = static_cast<const BYTE*>(xa2AudioBuffer->GetData());
+	xa2Buffer.PlayBegin = static_cast<UINT32>(startOffset);
 	xa2Buffer.PlayLength = 0;
 	xa2Buffer.LoopBegin = 0;
 	xa2Buffer.LoopLength = 0;
 	xa2Buffer.LoopCount = 0;
-	xa2Buffer.pContext = nullptr;
+	xa2Buffer.pContext = xa2AudioBuffer;
+
+	// Released in OnBufferEnd, which is also called for buffers flushed by Stop
+	xa2AudioBuffer->AddRef();
+	if (FAILED(m_sourceVoice->SubmitSourceBuffer(&xa2Buffer, nullptr)))
+	{
+		xa2AudioBuffer->Release();
+		return;
+	}
 
-	m_sourceVoice->SubmitSourceBuffer(&xa2Buffer, nullptr);
 	if (m_voiceState == VoiceState_Idle)
 	{
 		m_voiceState = VoiceState_Active;
@@ -98,6 +114,31 @@ void GpAudioChannelXAudio2::PostBuffer(const void *buffer, size_t bufferSize)
 	}
 }
 
+void GpAudioChannelXAudio2::SetPan(int32_t pan, int32_t maxPan)
+{
+	const double kPi = 3.14159265358979323846;
+	const double kSqrt2 = 1.41421356237309504880;
+
+	if (maxPan <= 0)
+	{
+		pan = 0;
+		maxPan = 1;
+	}
+	else if (pan < -maxPan)
+		pan = -maxPan;
+	else if (pan > maxPan)
+		pan = maxPan;
+
+	// Constant-power pan law, scaled so that the center position is at unity gain on both sides, same as the SDL mixer
+	const double angle = (static_cast<double>(pan) / maxPan + 1.0) * kPi * 0.25;
+
+	float levels[2];
+	levels[0] = static_cast<float>(cos(angle) * kSqrt2);
+	levels[1] = static_cast<float>(sin(angle) * kSqrt2);
+
+	m_sourceVoice->SetOutputMatrix(m_driver->GetMasteringVoice(), 1, 2, levels);
+}
+
 void GpAudioChannelXAudio2::Stop()
 {
 	// Set voice state BEFORE calling FlushSourceBuffers so state is idle before any callbacks trigger
@@ -113,8 +154,10 @@ void GpAudioChannelXAudio2::Destroy()
 	free(this);
 }
 
-void GpAudioChannelXAudio2::OnBufferEnd()
+void GpAudioChannelXAudio2::OnBufferEnd(void *bufferContext)
 {
+	static_cast<GpAudioBufferXAudio2*>(bufferContext)->Release();
+
 	if (m_contextCallbacks)
 		m_contextCallbacks->NotifyBufferFinished();
 }
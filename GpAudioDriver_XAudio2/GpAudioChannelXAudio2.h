@@ -16,14 +16,15 @@ public:
 	static GpAudioChannelXAudio2 *Create(GpAudioDriverXAudio2 *driver);
 
 	void SetAudioChannelContext(IGpAudioChannelCallbacks *callbacks) override;
-	void PostBuffer(const void *buffer, size_t bufferSize) override;
+	void PostBuffer(IGpAudioBuffer *buffer, size_t startOffset) override;
+	void SetPan(int32_t pan, int32_t maxPan) override;
 	void Stop() override;
 	void Destroy() override;
 
 	bool Init();
 
 protected:
-	void OnBufferEnd();
+	void OnBufferEnd(void *bufferContext);
 
 private:
 	enum VoiceState
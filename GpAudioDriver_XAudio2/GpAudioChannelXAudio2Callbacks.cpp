@@ -24,7 +24,7 @@ void GpAudioChannelXAudio2Callbacks::OnBufferStart(void* pBufferContext)
 
 void GpAudioChannelXAudio2Callbacks::OnBufferEnd(void* pBufferContext)
 {
-	m_owner->OnBufferEnd();
+	m_owner->OnBufferEnd(pBufferContext);
 }
 
 void GpAudioChannelXAudio2Callbacks::OnLoopEnd(void* pBufferContext)
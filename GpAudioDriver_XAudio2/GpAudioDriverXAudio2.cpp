@@ -1,6 +1,7 @@
 #include "GpAudioDriverXAudio2.h"
 
 #include "IGpLogDriver.h"
+#include "GpAudioBufferXAudio2.h"
 #include "GpAudioChannelXAudio2.h"
 
 #include <xaudio2.h>
@@ -101,11 +102,20 @@ IGpAudioChannel *GpAudioDriverXAudio2::CreateChannel()
 	return GpAudioChannelXAudio2::Create(this);
 }
 
+IGpAudioBuffer *GpAudioDriverXAudio2::CreateBuffer(const void *data, size_t size)
+{
+	return GpAudioBufferXAudio2::Create(data, size);
+}
+
 void GpAudioDriverXAudio2::SetMasterVolume(uint32_t vol, uint32_t maxVolume)
 {
 	m_mv->SetVolume(static_cast<float>(vol) / static_cast<float>(maxVolume));
 }
 
+void GpAudioDriverXAudio2::ServeTicks(int tickCount)
+{
+}
+
 GpAudioDriverXAudio2::GpAudioDriverXAudio2(const GpAudioDriverProperties &properties, unsigned int realSampleRate, IXAudio2* xa2, IXAudio2MasteringVoice *mv)
 	: m_properties(properties)
 	, m_realSampleRate(realSampleRate)
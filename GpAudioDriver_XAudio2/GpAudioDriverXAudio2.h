@@ -11,7 +11,9 @@ class GpAudioDriverXAudio2 : public IGpAudioDriver
 {
 public:
 	IGpAudioChannel *CreateChannel() override;
+	IGpAudioBuffer *CreateBuffer(const void *data, size_t size) override;
 	void SetMasterVolume(uint32_t vol, uint32_t maxVolume) override;
+	void ServeTicks(int tickCount) override;
 	void Shutdown() override;
 
 	IGpPrefsHandler *GetPrefsHandler() const override;
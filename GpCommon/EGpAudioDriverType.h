@@ -6,6 +6,7 @@ enum EGpAudioDriverType
 
 	EGpAudioDriverType_XAudio2,
 	EGpAudioDriverType_SDL2,
+	EGpAudioDriverType_Offline,
 
 	EGpAudioDriverType_Count,
 };
@@ -13,6 +13,8 @@ struct GpAudioDriverProperties
 	unsigned int m_sampleRate;
 	bool m_debug;
 
+	const char *m_renderPath;	// Offline driver only, WAV file to write to
+
 	IGpLogDriver *m_logger;
 	IGpSystemServices *m_systemServices;
 };
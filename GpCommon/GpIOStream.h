@@ -20,10 +20,19 @@ public:
 	virtual void Close() = 0;
 	virtual void Flush() = 0;
 
+	// Returns the entire stream as read-only memory that stays valid until the stream is closed,
+	// or null if the stream can't be mapped.
+	virtual const void *MapContents();
+
 	bool ReadExact(void *bytesOut, size_t size);
 	bool WriteExact(const void *bytesOut, size_t size);
 };
 
+inline const void *GpIOStream::MapContents()
+{
+	return nullptr;
+}
+
 inline bool GpIOStream::ReadExact(void *bytesOut, size_t size)
 {
 	const size_t nRead = this->Read(bytesOut, size);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+// Immutable, reference-counted sample data owned by the audio driver.
+// Channels play straight out of it, so posting a buffer doesn't copy it.
+struct IGpAudioBuffer
+{
+public:
+	virtual void AddRef() = 0;
+	virtual void Release() = 0;
+
+	virtual size_t GetSize() const = 0;	// In bytes
+};
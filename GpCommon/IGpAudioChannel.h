@@ -1,13 +1,18 @@
 #pragma once
 
-#include <stddef.h>
+#include <stdint.h>
 
+struct IGpAudioBuffer;
 struct IGpAudioChannelCallbacks;
 
 struct IGpAudioChannel
 {
 	virtual void SetAudioChannelContext(IGpAudioChannelCallbacks *callbacks) = 0;
-	virtual void PostBuffer(const void *buffer, size_t bufferSize) = 0;
+
+	// The channel holds a reference to the buffer until NotifyBufferFinished is called for it or the channel is stopped.
+	// Playback starts startOffset bytes into the buffer.
+	virtual void PostBuffer(IGpAudioBuffer *buffer, size_t startOffset) = 0;
+	virtual void SetPan(int32_t pan, int32_t maxPan) = 0;	// -maxPan is full left, maxPan is full right
 	virtual void Stop() = 0;
 	virtual void Destroy() = 0;
 };
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
+struct IGpAudioBuffer;
 struct IGpAudioChannel;
 struct IGpPrefsHandler;
 
@@ -9,9 +11,13 @@ struct IGpAudioDriver
 {
 public:
 	virtual IGpAudioChannel *CreateChannel() = 0;
+	virtual IGpAudioBuffer *CreateBuffer(const void *data, size_t size) = 0;	// Copies the data, returned buffer has 1 reference
 
 	virtual void SetMasterVolume(uint32_t vol, uint32_t maxVolume) = 0;
 
+	// Advances drivers that don't run in real time by a number of 1/60 second ticks
+	virtual void ServeTicks(int tickCount) = 0;
+
 	virtual void Shutdown() = 0;
 
 	virtual IGpPrefsHandler *GetPrefsHandler() const = 0;
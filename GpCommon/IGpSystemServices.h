@@ -31,6 +31,7 @@ public:
 	virtual bool IsUsingMouseAsTouch() const = 0;
 	virtual bool IsFullscreenPreferred() const = 0;
 	virtual bool IsFullscreenOnStartup() const = 0;
+	virtual bool IsStartupTraceEnabled() const = 0;	// Write a trace of the startup steps to the prefs directory
 	virtual bool IsTextInputObstructive() const = 0;
 	virtual unsigned int GetCPUCount() const = 0;
 	virtual void SetTextInputEnabled(bool isEnabled) = 0;
@@ -20,6 +20,8 @@ struct GpGlobalConfig
 	const EGpInputDriverType *m_inputDriverTypes;
 	size_t m_numInputDrivers;
 
+	const char *m_audioRenderPath;
+
 	IGpLogDriver *m_logger;
 	IGpSystemServices *m_systemServices;
 	void *m_osGlobals;
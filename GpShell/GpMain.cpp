@@ -78,6 +78,7 @@ int GpMain::Run()
 #else
 	adProps.m_debug = true;
 #endif
+	adProps.m_renderPath = g_gpGlobalConfig.m_audioRenderPath;
 	adProps.m_logger = g_gpGlobalConfig.m_logger;
 	adProps.m_systemServices = g_gpGlobalConfig.m_systemServices;
 
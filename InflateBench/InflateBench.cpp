@@ -0,0 +1,263 @@
+#include "CFileStream.h"
+#include "DeflateCodec.h"
+#include "PLUnalignedPtr.h"
+#include "ZipFile.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Compares the one-shot inflate path against zlib on every deflated entry of a set of archives, and checks that both
+// reject truncated and corrupted copies of each entry without writing past the end of the output
+
+struct BenchTotals
+{
+	size_t m_numEntries;
+	size_t m_compressedBytes;
+	size_t m_uncompressedBytes;
+	size_t m_numFastFailures;
+	size_t m_numMismatches;
+
+	size_t m_numDamagedInputs;
+	size_t m_numDamagedAccepted;	// Accepted by a decoder when zlib rejected them or decoded them differently
+	size_t m_numOverruns;
+
+	double m_zlibSeconds;
+	double m_fastSeconds;
+	double m_crcSeconds;
+};
+
+static bool ReadEntireFile(const char *path, std::vector<uint8_t> &outContents)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+	{
+		fprintf(stderr, "Could not open input file '%s'\n", path);
+		return false;
+	}
+
+	PortabilityLayer::CFileStream stream(f, true, false, true);
+
+	const GpUFilePos_t sz = stream.Size();
+	outContents.resize(static_cast<size_t>(sz));
+
+	const bool readOK = (sz == 0 || stream.Read(&outContents[0], outContents.size()) == outContents.size());
+	stream.Close();
+
+	if (!readOK)
+		fprintf(stderr, "Could not read input file '%s'\n", path);
+
+	return readOK;
+}
+
+static double SecondsSince(const std::chrono::high_resolution_clock::time_point &startTime)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+static const size_t kNumGuardBytes = 16;
+static const uint8_t kGuardByte = 0xcd;
+
+typedef bool (*DecompressFunc_t)(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
+
+// Decompresses into a buffer with guard bytes after the output, returns false if any of them were written
+static bool DecompressGuarded(DecompressFunc_t decompress, const std::vector<uint8_t> &input, size_t outSize, std::vector<uint8_t> &outBuffer, bool &outDecompressed)
+{
+	outBuffer.assign(outSize + kNumGuardBytes, kGuardByte);
+
+	outDecompressed = decompress(input.empty() ? nullptr : &input[0], input.size(), &outBuffer[0], outSize);
+
+	for (size_t i = 0; i < kNumGuardBytes; i++)
+	{
+		if (outBuffer[outSize + i] != kGuardByte)
+			return false;
+	}
+
+	return true;
+}
+
+static void CheckDamagedInput(const std::vector<uint8_t> &input, size_t uncompressedSize, BenchTotals &totals)
+{
+	std::vector<uint8_t> zlibOutput;
+	std::vector<uint8_t> output;
+	bool zlibOK = false;
+
+	totals.m_numDamagedInputs++;
+
+	if (!DecompressGuarded(PortabilityLayer::DeflateCodec::DecompressMemoryZlib, input, uncompressedSize, zlibOutput, zlibOK))
+		totals.m_numOverruns++;
+
+	const DecompressFunc_t decoders[] = { PortabilityLayer::DeflateCodec::DecompressMemoryFast, PortabilityLayer::DeflateCodec::DecompressMemory };
+	for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++)
+	{
+		bool decoderOK = false;
+		if (!DecompressGuarded(decoders[i], input, uncompressedSize, output, decoderOK))
+			totals.m_numOverruns++;
+
+		if (decoderOK && (!zlibOK || memcmp(&output[0], &zlibOutput[0], uncompressedSize) != 0))
+			totals.m_numDamagedAccepted++;
+	}
+}
+
+static void CheckDamagedEntry(const uint8_t *compressedData, size_t compressedSize, size_t uncompressedSize, BenchTotals &totals)
+{
+	const size_t kNumCorruptions = 8;
+
+	std::vector<uint8_t> damaged;
+
+	// Cut off at the start, in the middle, and just before the end
+	const size_t truncatedSizes[] = { 0, compressedSize / 2, compressedSize - 1 };
+	for (size_t i = 0; i < sizeof(truncatedSizes) / sizeof(truncatedSizes[0]); i++)
+	{
+		if (truncatedSizes[i] >= compressedSize)
+			continue;
+
+		damaged.assign(compressedData, compressedData + truncatedSizes[i]);
+		CheckDamagedInput(damaged, uncompressedSize, totals);
+	}
+
+	// Invert one byte at a time, spread evenly through the entry
+	for (size_t i = 0; i < kNumCorruptions && i < compressedSize; i++)
+	{
+		damaged.assign(compressedData, compressedData + compressedSize);
+		damaged[i * compressedSize / kNumCorruptions] ^= 0xff;
+		CheckDamagedInput(damaged, uncompressedSize, totals);
+	}
+}
+
+static bool BenchArchive(const char *path, int numIterations, BenchTotals &totals)
+{
+	std::vector<uint8_t> archive;
+	if (!ReadEntireFile(path, archive))
+		return false;
+
+	PortabilityLayer::ZipEndOfCentralDirectoryRecord eocd;
+	if (archive.size() < sizeof(eocd))
+	{
+		fprintf(stderr, "'%s' is not a valid archive\n", path);
+		return false;
+	}
+
+	eocd = PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipEndOfCentralDirectoryRecord>(reinterpret_cast<const PortabilityLayer::ZipEndOfCentralDirectoryRecord*>(&archive[archive.size() - sizeof(eocd)])).Get();
+	if (eocd.m_signature != PortabilityLayer::ZipEndOfCentralDirectoryRecord::kSignature)
+	{
+		fprintf(stderr, "'%s' is not a valid archive\n", path);
+		return false;
+	}
+
+	std::vector<uint8_t> fastOutput;
+	std::vector<uint8_t> zlibOutput;
+
+	size_t cdOffset = eocd.m_centralDirStartOffset;
+	const size_t numFiles = eocd.m_numCentralDirRecords;
+
+	for (size_t i = 0; i < numFiles; i++)
+	{
+		PortabilityLayer::ZipCentralDirectoryFileHeader cdh;
+		if (archive.size() - cdOffset < sizeof(cdh))
+		{
+			fprintf(stderr, "'%s' has a truncated central directory\n", path);
+			return false;
+		}
+
+		cdh = PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader>(reinterpret_cast<const PortabilityLayer::ZipCentralDirectoryFileHeader*>(&archive[cdOffset])).Get();
+		cdOffset += sizeof(cdh) + cdh.m_fileNameLength + cdh.m_extraFieldLength + cdh.m_commentLength;
+
+		if (cdh.m_method != PortabilityLayer::ZipConstants::kDeflatedMethod)
+			continue;
+
+		PortabilityLayer::ZipFileLocalHeader lh;
+		const size_t lhOffset = cdh.m_localHeaderOffset;
+		if (archive.size() - lhOffset < sizeof(lh))
+		{
+			fprintf(stderr, "'%s' has a truncated entry\n", path);
+			return false;
+		}
+
+		lh = PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipFileLocalHeader>(reinterpret_cast<const PortabilityLayer::ZipFileLocalHeader*>(&archive[lhOffset])).Get();
+
+		const size_t dataOffset = lhOffset + sizeof(lh) + lh.m_fileNameLength + lh.m_extraFieldLength;
+		const size_t compressedSize = cdh.m_compressedSize;
+		const size_t uncompressedSize = cdh.m_uncompressedSize;
+
+		if (dataOffset > archive.size() || archive.size() - dataOffset < compressedSize)
+		{
+			fprintf(stderr, "'%s' has a truncated entry\n", path);
+			return false;
+		}
+
+		const uint8_t *compressedData = &archive[dataOffset];
+
+		fastOutput.resize(uncompressedSize + 1);
+		zlibOutput.resize(uncompressedSize + 1);
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		bool zlibOK = true;
+		for (int iter = 0; iter < numIterations; iter++)
+			zlibOK = PortabilityLayer::DeflateCodec::DecompressMemoryZlib(compressedData, compressedSize, &zlibOutput[0], uncompressedSize) && zlibOK;
+		totals.m_zlibSeconds += SecondsSince(startTime);
+
+		startTime = std::chrono::high_resolution_clock::now();
+		bool fastOK = true;
+		for (int iter = 0; iter < numIterations; iter++)
+			fastOK = PortabilityLayer::DeflateCodec::DecompressMemoryFast(compressedData, compressedSize, &fastOutput[0], uncompressedSize) && fastOK;
+		totals.m_fastSeconds += SecondsSince(startTime);
+
+		startTime = std::chrono::high_resolution_clock::now();
+		uint32_t crc = 0;
+		for (int iter = 0; iter < numIterations; iter++)
+			crc = PortabilityLayer::DeflateContext::CRC32(0, &fastOutput[0], uncompressedSize);
+		totals.m_crcSeconds += SecondsSince(startTime);
+
+		totals.m_numEntries++;
+		totals.m_compressedBytes += compressedSize;
+		totals.m_uncompressedBytes += uncompressedSize;
+
+		if (!fastOK)
+			totals.m_numFastFailures++;
+		else if (!zlibOK || memcmp(&fastOutput[0], &zlibOutput[0], uncompressedSize) != 0 || crc != cdh.m_crc)
+			totals.m_numMismatches++;
+
+		CheckDamagedEntry(compressedData, compressedSize, uncompressedSize, totals);
+	}
+
+	return true;
+}
+
+int main(int argc, const char **argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: InflateBench <iterations> <archive.gpa> [<archive.gpa> ...]\n");
+		return -1;
+	}
+
+	const int numIterations = atoi(argv[1]);
+	if (numIterations <= 0)
+	{
+		fprintf(stderr, "Iteration count must be positive\n");
+		return -1;
+	}
+
+	BenchTotals totals;
+	memset(&totals, 0, sizeof(totals));
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (!BenchArchive(argv[i], numIterations, totals))
+			return -1;
+	}
+
+	const double totalMB = static_cast<double>(totals.m_uncompressedBytes) * numIterations / (1024.0 * 1024.0);
+
+	fprintf(stdout, "%zu deflated entries, %zu bytes compressed, %zu bytes uncompressed, %i iterations\n", totals.m_numEntries, totals.m_compressedBytes, totals.m_uncompressedBytes, numIterations);
+	fprintf(stdout, "zlib:  %.3fs (%.1f MB/s)\n", totals.m_zlibSeconds, totalMB / totals.m_zlibSeconds);
+	fprintf(stdout, "fast:  %.3fs (%.1f MB/s)\n", totals.m_fastSeconds, totalMB / totals.m_fastSeconds);
+	fprintf(stdout, "crc32: %.3fs (%.1f MB/s)\n", totals.m_crcSeconds, totalMB / totals.m_crcSeconds);
+	fprintf(stdout, "%zu fast path failures, %zu mismatches\n", totals.m_numFastFailures, totals.m_numMismatches);
+	fprintf(stdout, "%zu damaged inputs, %zu wrongly accepted, %zu output overruns\n", totals.m_numDamagedInputs, totals.m_numDamagedAccepted, totals.m_numOverruns);
+
+	return (totals.m_numFastFailures == 0 && totals.m_numMismatches == 0 && totals.m_numDamagedAccepted == 0 && totals.m_numOverruns == 0) ? 0 : 1;
+}
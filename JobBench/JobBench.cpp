@@ -0,0 +1,347 @@
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
+#include "JobSystem.h"
+#include "MemoryManager.h"
+#include "PLDrivers.h"
+#include "WorkerThread.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Measures the scheduling overhead of the job system with jobs that do little or no work
+
+class BenchMutex final : public IGpMutex
+{
+public:
+	void Destroy() override { delete this; }
+	void Lock() override { m_mutex.lock(); }
+	void Unlock() override { m_mutex.unlock(); }
+
+private:
+	std::mutex m_mutex;
+};
+
+class BenchThreadEvent final : public IGpThreadEvent
+{
+public:
+	BenchThreadEvent(bool autoReset, bool startSignaled)
+		: m_isSignaled(startSignaled)
+		, m_autoReset(autoReset)
+	{
+	}
+
+	void Wait() override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this] { return m_isSignaled; });
+		if (m_autoReset)
+			m_isSignaled = false;
+	}
+
+	bool WaitTimed(uint32_t msec) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_cv.wait_for(lock, std::chrono::milliseconds(msec), [this] { return m_isSignaled; }))
+			return false;
+		if (m_autoReset)
+			m_isSignaled = false;
+		return true;
+	}
+
+	void Signal() override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isSignaled = true;
+		if (m_autoReset)
+			m_cv.notify_one();
+		else
+			m_cv.notify_all();
+	}
+
+	void Destroy() override { delete this; }
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_isSignaled;
+	bool m_autoReset;
+};
+
+// Only what the job system needs
+class BenchSystemServices final : public IGpSystemServices
+{
+public:
+	explicit BenchSystemServices(unsigned int cpuCount) : m_cpuCount(cpuCount) { }
+
+	int64_t GetTime() const override { return 0; }
+	void GetLocalDateTime(unsigned int &year, unsigned int &month, unsigned int &day, unsigned int &hour, unsigned int &minute, unsigned int &second) const override { year = month = day = hour = minute = second = 0; }
+	IGpMutex *CreateMutex() override { return new BenchMutex(); }
+	IGpMutex *CreateRecursiveMutex() override { return nullptr; }
+	void *CreateThread(ThreadFunc_t threadFunc, void *context) override { std::thread(threadFunc, context).detach(); return this; }
+	IGpThreadEvent *CreateThreadEvent(bool autoReset, bool startSignaled) override { return new BenchThreadEvent(autoReset, startSignaled); }
+	uint64_t GetFreeMemoryCosmetic() const override { return 0; }
+	void Beep() const override { }
+	bool IsTouchscreen() const override { return false; }
+	bool IsUsingMouseAsTouch() const override { return false; }
+	bool IsFullscreenPreferred() const override { return false; }
+	bool IsFullscreenOnStartup() const override { return false; }
+	bool IsStartupTraceEnabled() const override { return false; }
+	bool IsTextInputObstructive() const override { return false; }
+	unsigned int GetCPUCount() const override { return m_cpuCount; }
+	void SetTextInputEnabled(bool isEnabled) override { }
+	bool IsTextInputEnabled() const override { return false; }
+	bool AreFontResourcesSeekable() const override { return false; }
+	IGpClipboardContents *GetClipboardContents() const override { return nullptr; }
+	void SetClipboardContents(IGpClipboardContents *contents) override { }
+
+private:
+	unsigned int m_cpuCount;
+};
+
+static std::atomic<size_t> gs_jobsRun(0);
+
+static double SecondsSince(const std::chrono::high_resolution_clock::time_point &startTime)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+static void EmptyJob(void *context)
+{
+	gs_jobsRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void ReportPerItem(const char *name, double seconds, size_t numItems)
+{
+	fprintf(stdout, "%-24s %8.1f ns each (%zu in %.3fs)\n", name, seconds * 1e9 / static_cast<double>(numItems), numItems, seconds);
+}
+
+static bool CheckJobsRun(const char *name, size_t expected)
+{
+	const size_t jobsRun = gs_jobsRun.exchange(0);
+	if (jobsRun == expected)
+		return true;
+
+	fprintf(stderr, "%s: expected %zu jobs to run, %zu ran\n", name, expected, jobsRun);
+	return false;
+}
+
+// Submit from the main thread, then wait for all of them
+static bool BenchSubmitAndWait(size_t numJobs)
+{
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	std::vector<PortabilityLayer::Job*> jobs(numJobs);
+
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < numJobs; i++)
+		jobs[i] = jobSystem->SubmitJob(EmptyJob, nullptr);
+
+	for (size_t i = 0; i < numJobs; i++)
+	{
+		jobSystem->WaitForJob(jobs[i]);
+		jobSystem->ReleaseJob(jobs[i]);
+	}
+
+	ReportPerItem("submit and wait", SecondsSince(startTime), numJobs);
+	return CheckJobsRun("submit and wait", numJobs);
+}
+
+struct FanOutParams
+{
+	size_t m_numChildren;
+	std::vector<PortabilityLayer::Job*> *m_children;
+};
+
+static void FanOutRootJob(void *context)
+{
+	const FanOutParams *params = static_cast<const FanOutParams*>(context);
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	std::vector<PortabilityLayer::Job*> &children = *params->m_children;
+
+	for (size_t i = 0; i < params->m_numChildren; i++)
+		children[i] = jobSystem->SubmitJob(EmptyJob, nullptr);
+
+	for (size_t i = 0; i < params->m_numChildren; i++)
+	{
+		jobSystem->WaitForJob(children[i]);
+		jobSystem->ReleaseJob(children[i]);
+	}
+}
+
+// Submit from inside a job, so the children go on a worker's deque and the other workers have to steal them
+static bool BenchFanOut(size_t numJobs)
+{
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	std::vector<PortabilityLayer::Job*> children(numJobs);
+
+	FanOutParams params;
+	params.m_numChildren = numJobs;
+	params.m_children = &children;
+
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	PortabilityLayer::Job *root = jobSystem->SubmitJob(FanOutRootJob, &params);
+	jobSystem->WaitForJob(root);
+	jobSystem->ReleaseJob(root);
+
+	ReportPerItem("fan out from a job", SecondsSince(startTime), numJobs);
+	return CheckJobsRun("fan out from a job", numJobs);
+}
+
+// Each job depends on the one before it, so this measures the latency of handing a job on
+static bool BenchDependencyChain(size_t numJobs)
+{
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	std::vector<PortabilityLayer::Job*> jobs(numJobs);
+
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	PortabilityLayer::Job *prevJob = nullptr;
+	for (size_t i = 0; i < numJobs; i++)
+	{
+		jobs[i] = jobSystem->SubmitJob(EmptyJob, nullptr, &prevJob, 1);
+		prevJob = jobs[i];
+	}
+
+	jobSystem->WaitForJob(prevJob);
+
+	for (size_t i = 0; i < numJobs; i++)
+		jobSystem->ReleaseJob(jobs[i]);
+
+	ReportPerItem("dependency chain", SecondsSince(startTime), numJobs);
+	return CheckJobsRun("dependency chain", numJobs);
+}
+
+static void CountRangeJob(void *context, size_t startIndex, size_t endIndex)
+{
+	gs_jobsRun.fetch_add(endIndex - startIndex, std::memory_order_relaxed);
+}
+
+// A parallel-for with one item per thread, so nearly all of the time is overhead
+static bool BenchTinyParallelFor(size_t numCalls)
+{
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	const size_t count = jobSystem->GetNumWorkers() + 1;
+
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < numCalls; i++)
+		jobSystem->ParallelFor(CountRangeJob, nullptr, count, 1);
+
+	ReportPerItem("tiny parallel for", SecondsSince(startTime), numCalls);
+	return CheckJobsRun("tiny parallel for", numCalls * count);
+}
+
+static void SqrtRangeJob(void *context, size_t startIndex, size_t endIndex)
+{
+	float *values = static_cast<float*>(context);
+
+	for (size_t i = startIndex; i < endIndex; i++)
+		values[i] = sqrtf(values[i] + 1.0f);
+}
+
+// Some real work per item, compared to the same loop on one thread
+static bool BenchParallelForThroughput(size_t numItems, int numIterations)
+{
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	std::vector<float> serialValues(numItems, 0.0f);
+	std::vector<float> parallelValues(numItems, 0.0f);
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+	for (int iter = 0; iter < numIterations; iter++)
+		SqrtRangeJob(&serialValues[0], 0, numItems);
+	const double serialSeconds = SecondsSince(startTime);
+
+	startTime = std::chrono::high_resolution_clock::now();
+	for (int iter = 0; iter < numIterations; iter++)
+		jobSystem->ParallelFor(SqrtRangeJob, &parallelValues[0], numItems, 4096);
+	const double parallelSeconds = SecondsSince(startTime);
+
+	fprintf(stdout, "%-24s %8.3fs serial, %.3fs parallel, %.2fx\n", "parallel for throughput", serialSeconds, parallelSeconds, serialSeconds / parallelSeconds);
+
+	if (serialValues != parallelValues)
+	{
+		fprintf(stderr, "parallel for throughput: results differ from the serial loop\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void EmptyTask(void *context)
+{
+	gs_jobsRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The old single-thread API, now a chain of jobs
+static bool BenchWorkerThread(size_t numTasks)
+{
+	const std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	PortabilityLayer::WorkerThread *thread = PortabilityLayer::WorkerThread::Create();
+	if (!thread)
+	{
+		fprintf(stderr, "Could not create a worker thread\n");
+		return false;
+	}
+
+	for (size_t i = 0; i < numTasks; i++)
+		thread->AsyncExecuteTask(EmptyTask, nullptr);
+
+	thread->Destroy();
+
+	ReportPerItem("worker thread task", SecondsSince(startTime), numTasks);
+	return CheckJobsRun("worker thread task", numTasks);
+}
+
+int main(int argc, const char **argv)
+{
+	int numIterations = 10;
+	if (argc >= 2)
+		numIterations = atoi(argv[1]);
+
+	// The CPU count can be overridden to see how scheduling scales with the number of workers
+	int cpuCount = static_cast<int>(std::thread::hardware_concurrency());
+	if (argc >= 3)
+		cpuCount = atoi(argv[2]);
+
+	if (numIterations <= 0 || cpuCount <= 0)
+	{
+		fprintf(stderr, "Usage: JobBench [<iterations> [<cpu count>]]\n");
+		return -1;
+	}
+
+	BenchSystemServices sysServices(static_cast<unsigned int>(cpuCount));
+	PLDrivers::GetDriverCollection()->SetDriver<GpDriverIDs::kSystemServices>(&sysServices);
+
+	PortabilityLayer::MemoryManager::GetInstance()->Init();
+
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+	jobSystem->Init();
+
+	fprintf(stdout, "%i CPUs, %u workers, %i iterations\n", cpuCount, jobSystem->GetNumWorkers(), numIterations);
+
+	bool passed = true;
+	for (int iter = 0; iter < numIterations && passed; iter++)
+	{
+		passed = BenchSubmitAndWait(100000) && passed;
+		passed = BenchFanOut(100000) && passed;
+		passed = BenchDependencyChain(100000) && passed;
+		passed = BenchTinyParallelFor(10000) && passed;
+		passed = BenchParallelForThroughput(1 << 20, 20) && passed;
+		passed = BenchWorkerThread(100000) && passed;
+	}
+
+	jobSystem->Shutdown();
+	PortabilityLayer::MemoryManager::GetInstance()->Shutdown();
+
+	return passed ? 0 : 1;
+}
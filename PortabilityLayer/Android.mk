@@ -38,6 +38,7 @@ LOCAL_SRC_FILES := \
 	IconLoader.cpp	\
 	InflateStream.cpp	\
 	InputManager.cpp	\
+	JobSystem.cpp	\
 	LinePlotter.cpp	\
 	MacBinary2.cpp	\
 	MacFileInfo.cpp	\
@@ -88,8 +89,10 @@ LOCAL_SRC_FILES := \
 	QDStandardPalette.cpp	\
 	RandomNumberGenerator.cpp	\
 	ResolveCachingColor.cpp	\
+	ResourceCache.cpp	\
 	ResourceCompiledRef.cpp	\
 	ResourceFile.cpp	\
+	ResourceLoadBatch.cpp	\
 	ScanlineMask.cpp	\
 	ScanlineMaskBuilder.cpp	\
 	ScanlineMaskConverter.cpp	\
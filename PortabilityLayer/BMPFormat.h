@@ -41,4 +41,27 @@ namespace PortabilityLayer
 		uint8_t m_r;
 		uint8_t m_reserved;
 	};
+
+	// Version 2 archives append the image already converted to the surface formats after the end of the bitmap
+	// file, at the first multiple of kAlignment at or after m_fileSize.  Planes are stored top-down, at offsets
+	// from the start of the bitmap file, with offsets and pitches that are multiples of kAlignment.
+	struct PrebakedBitmapHeader
+	{
+		static const uint32_t kSignature = 0x4b425047;	// "GPBK"
+		static const uint32_t kAlignment = 16;
+
+		static const uint32_t kFlag8BitStandard = 1;
+		static const uint32_t kFlag8BitDithered = 2;		// 8-bit plane was converted from direct color with error diffusion
+		static const uint32_t kFlagRGB32 = 4;
+		static const uint32_t kFlagRGB32FromPalette = 8;	// RGB32 is the standard palette expansion of the 8-bit plane and isn't stored
+
+		LEUInt32_t m_signature;
+		LEUInt32_t m_flags;
+		LEUInt32_t m_width;
+		LEUInt32_t m_height;
+		LEUInt32_t m_pitch8;
+		LEUInt32_t m_offset8;
+		LEUInt32_t m_pitch32;
+		LEUInt32_t m_offset32;
+	};
 }
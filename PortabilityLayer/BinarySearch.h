@@ -2,6 +2,7 @@
 #ifndef __PL_BINARY_SEARCH_H__
 #define __PL_BINARY_SEARCH_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace PortabilityLayer
@@ -10,3 +10,69 @@ Rect BitmapImage::GetRect() const
 
 	return Rect::Create(0, 0, static_cast<int16_t>(height), static_cast<int16_t>(width));
 }
+
+
+static bool CheckPrebakedPlane(uint32_t offset, uint32_t pitch, uint32_t minPitch, uint32_t height, size_t handleSize)
+{
+	const uint32_t alignment = PortabilityLayer::PrebakedBitmapHeader::kAlignment;
+
+	if (offset % alignment != 0 || pitch % alignment != 0 || pitch < minPitch)
+		return false;
+
+	if (offset > handleSize)
+		return false;
+
+	return static_cast<uint64_t>(pitch) * height <= handleSize - offset;
+}
+
+const PortabilityLayer::PrebakedBitmapHeader *BitmapImage::GetPrebakedHeader(size_t handleSize) const
+{
+	const uint32_t alignment = PortabilityLayer::PrebakedBitmapHeader::kAlignment;
+
+	if (handleSize < sizeof(PortabilityLayer::BitmapFileHeader) + sizeof(PortabilityLayer::BitmapInfoHeader))
+		return nullptr;
+
+	const size_t fileSize = m_fileHeader.m_fileSize;
+	if (fileSize > handleSize)
+		return nullptr;
+
+	const size_t headerOffset = (fileSize + alignment - 1) / alignment * alignment;
+	if (headerOffset > handleSize || handleSize - headerOffset < sizeof(PortabilityLayer::PrebakedBitmapHeader))
+		return nullptr;
+
+	const uint8_t *bytes = reinterpret_cast<const uint8_t*>(this);
+	const PortabilityLayer::BitmapInfoHeader *infoHeader = reinterpret_cast<const PortabilityLayer::BitmapInfoHeader*>(bytes + sizeof(PortabilityLayer::BitmapFileHeader));
+	const PortabilityLayer::PrebakedBitmapHeader *prebakedHeader = reinterpret_cast<const PortabilityLayer::PrebakedBitmapHeader*>(bytes + headerOffset);
+
+	if (prebakedHeader->m_signature != PortabilityLayer::PrebakedBitmapHeader::kSignature)
+		return nullptr;
+
+	const uint32_t width = prebakedHeader->m_width;
+	const uint32_t height = prebakedHeader->m_height;
+	if (width != infoHeader->m_width || height != infoHeader->m_height)
+		return nullptr;
+
+	const uint32_t flags = prebakedHeader->m_flags;
+
+	if (flags & PortabilityLayer::PrebakedBitmapHeader::kFlag8BitStandard)
+	{
+		if (!CheckPrebakedPlane(prebakedHeader->m_offset8, prebakedHeader->m_pitch8, width, height, handleSize))
+			return nullptr;
+	}
+
+	if (flags & PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32)
+	{
+		if (width > 0x3fffffff)
+			return nullptr;
+
+		if (flags & PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32FromPalette)
+		{
+			if (!(flags & PortabilityLayer::PrebakedBitmapHeader::kFlag8BitStandard))
+				return nullptr;
+		}
+		else if (!CheckPrebakedPlane(prebakedHeader->m_offset32, prebakedHeader->m_pitch32, width * 4, height, handleSize))
+			return nullptr;
+	}
+
+	return prebakedHeader;
+}
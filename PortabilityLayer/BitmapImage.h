@@ -8,4 +8,7 @@ struct BitmapImage
 	PortabilityLayer::BitmapFileHeader m_fileHeader;
 
 	Rect GetRect() const;
+
+	// Returns null if the bitmap has no valid pre-baked pixel data
+	const PortabilityLayer::PrebakedBitmapHeader *GetPrebakedHeader(size_t handleSize) const;
 };
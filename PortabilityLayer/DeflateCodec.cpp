@@ -22,6 +22,839 @@ namespace
 	{
 		static_cast<PortabilityLayer::MemoryManager*>(opaque)->Release(address);
 	}
+
+	struct CRC32Tables
+	{
+		CRC32Tables();
+
+		uint32_t m_tables[8][256];
+	};
+
+	CRC32Tables::CRC32Tables()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0);
+
+			m_tables[0][i] = crc;
+		}
+
+		// Table N advances a byte's CRC through N more zero bytes, so 8 bytes can be folded in at once
+		for (int t = 1; t < 8; t++)
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				const uint32_t prev = m_tables[t - 1][i];
+				m_tables[t][i] = (prev >> 8) ^ m_tables[0][prev & 0xff];
+			}
+		}
+	}
+
+	static const CRC32Tables &GetCRC32Tables()
+	{
+		static CRC32Tables tables;
+		return tables;
+	}
+
+	struct BitReverseTable
+	{
+		BitReverseTable();
+
+		uint8_t m_table[256];
+	};
+
+	BitReverseTable::BitReverseTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int reversed = 0;
+			for (int bit = 0; bit < 8; bit++)
+				reversed |= ((i >> bit) & 1) << (7 - bit);
+
+			m_table[i] = static_cast<uint8_t>(reversed);
+		}
+	}
+
+	static const BitReverseTable &GetBitReverseTable()
+	{
+		static BitReverseTable table;
+		return table;
+	}
+
+	static uint64_t LoadLittleEndian64(const uint8_t *bytes)
+	{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		uint64_t word = 0;
+		for (int i = 0; i < 8; i++)
+			word |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+#else
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+#endif
+
+		return word;
+	}
+}
+
+namespace
+{
+	// Huffman table entries are packed as:
+	//   bits 0-7: Number of bits to consume
+	//   bits 8-11: Entry kind
+	//   bits 12-15: Extra bit count, sub-table bit count, or the first code's length for a literal pair
+	//   bits 16-31: Value, sub-table offset, or two literals
+	enum HuffmanEntryKind
+	{
+		kHuffmanEntryInvalid,
+		kHuffmanEntryLiteral,
+		kHuffmanEntryLiteralPair,
+		kHuffmanEntryLength,
+		kHuffmanEntryEndOfBlock,
+		kHuffmanEntryDistance,
+		kHuffmanEntryCodeLength,
+		kHuffmanEntrySubTable,
+	};
+
+	enum HuffmanTableType
+	{
+		kHuffmanTableLitLen,
+		kHuffmanTableDistance,
+		kHuffmanTableCodeLength,
+	};
+
+	static const unsigned int kLitLenTableBits = 10;
+	static const unsigned int kDistanceTableBits = 8;
+	static const unsigned int kCodeLengthTableBits = 7;
+	static const unsigned int kMaxCodeLength = 15;
+	static const size_t kFastPathOutputSlack = 258 + 8;
+
+	// Merging literal pairs costs a pass over the primary table, which small blocks don't decode enough to repay.
+	// Block sizes aren't known in advance, so this goes by how much output is left.
+	static const size_t kLiteralPairMinOutput = 16 * 1024;
+
+	// Primary table plus worst-case sub-tables, one per long code
+	static const size_t kLitLenTableCapacity = (1 << kLitLenTableBits) + 288 * (1 << (kMaxCodeLength - kLitLenTableBits));
+	static const size_t kDistanceTableCapacity = (1 << kDistanceTableBits) + 32 * (1 << (kMaxCodeLength - kDistanceTableBits));
+	static const size_t kCodeLengthTableCapacity = (1 << kCodeLengthTableBits);
+
+	static const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t kLengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t kDistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	static const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	static uint32_t MakeHuffmanEntry(unsigned int length, HuffmanEntryKind kind, unsigned int nibble, unsigned int value)
+	{
+		return static_cast<uint32_t>(length | (kind << 8) | (nibble << 12) | (value << 16));
+	}
+
+	static uint32_t MakeSymbolEntry(HuffmanTableType tableType, unsigned int symbol, unsigned int length)
+	{
+		switch (tableType)
+		{
+		case kHuffmanTableLitLen:
+			if (symbol < 256)
+				return MakeHuffmanEntry(length, kHuffmanEntryLiteral, 0, symbol);
+			else if (symbol == 256)
+				return MakeHuffmanEntry(length, kHuffmanEntryEndOfBlock, 0, 0);
+			else if (symbol < 286)
+				return MakeHuffmanEntry(length, kHuffmanEntryLength, kLengthExtraBits[symbol - 257], kLengthBase[symbol - 257]);
+			break;
+		case kHuffmanTableDistance:
+			if (symbol < 30)
+				return MakeHuffmanEntry(length, kHuffmanEntryDistance, kDistanceExtraBits[symbol], kDistanceBase[symbol]);
+			break;
+		case kHuffmanTableCodeLength:
+			return MakeHuffmanEntry(length, kHuffmanEntryCodeLength, 0, symbol);
+		}
+
+		// Symbols that are allowed in a code but must never be decoded
+		return MakeHuffmanEntry(length, kHuffmanEntryInvalid, 0, 0);
+	}
+
+	// Entries for each symbol with a length of 0, so tables are built by just adding in the code length
+	struct HuffmanSymbolEntries
+	{
+		HuffmanSymbolEntries();
+
+		uint32_t m_entries[3][288];
+	};
+
+	HuffmanSymbolEntries::HuffmanSymbolEntries()
+	{
+		for (int tableType = 0; tableType < 3; tableType++)
+		{
+			for (unsigned int symbol = 0; symbol < 288; symbol++)
+				m_entries[tableType][symbol] = MakeSymbolEntry(static_cast<HuffmanTableType>(tableType), symbol, 0);
+		}
+	}
+
+	static const HuffmanSymbolEntries &GetHuffmanSymbolEntries()
+	{
+		static HuffmanSymbolEntries entries;
+		return entries;
+	}
+
+	static unsigned int HuffmanEntryLength(uint32_t entry)
+	{
+		return entry & 0xff;
+	}
+
+	static HuffmanEntryKind HuffmanEntryKindOf(uint32_t entry)
+	{
+		return static_cast<HuffmanEntryKind>((entry >> 8) & 0xf);
+	}
+
+	static unsigned int HuffmanEntryNibble(uint32_t entry)
+	{
+		return (entry >> 12) & 0xf;
+	}
+
+	static unsigned int HuffmanEntryValue(uint32_t entry)
+	{
+		return entry >> 16;
+	}
+
+	// Builds a two-level lookup table for a canonical Huffman code.  Codes that fit in the primary table are
+	// replicated across every index that they're a prefix of, longer codes go in sub-tables.
+	static bool BuildHuffmanTable(const uint8_t *lengths, unsigned int numSymbols, HuffmanTableType tableType, unsigned int tableBits, uint32_t *table, size_t tableCapacity)
+	{
+		unsigned int lengthCounts[kMaxCodeLength + 1];
+		for (unsigned int i = 0; i <= kMaxCodeLength; i++)
+			lengthCounts[i] = 0;
+
+		unsigned int maxLength = 0;
+		for (unsigned int i = 0; i < numSymbols; i++)
+		{
+			lengthCounts[lengths[i]]++;
+			if (lengths[i] > maxLength)
+				maxLength = lengths[i];
+		}
+
+		// Reject over-subscribed codes.  Incomplete codes are allowed since the unused entries are invalid.
+		int codesLeft = 1;
+		for (unsigned int length = 1; length <= kMaxCodeLength; length++)
+		{
+			codesLeft = codesLeft * 2 - static_cast<int>(lengthCounts[length]);
+			if (codesLeft < 0)
+				return false;
+		}
+
+		unsigned int nextCode[kMaxCodeLength + 1];
+		unsigned int code = 0;
+		lengthCounts[0] = 0;
+		for (unsigned int length = 1; length <= kMaxCodeLength; length++)
+		{
+			code = (code + lengthCounts[length - 1]) << 1;
+			nextCode[length] = code;
+		}
+
+		const size_t primarySize = static_cast<size_t>(1) << tableBits;
+		const unsigned int subTableBits = (maxLength > tableBits) ? (maxLength - tableBits) : 0;
+		const size_t subTableSize = static_cast<size_t>(1) << subTableBits;
+		size_t tableUsed = primarySize;
+
+		const uint8_t *bitReverse = GetBitReverseTable().m_table;
+		const uint32_t *symbolEntries = GetHuffmanSymbolEntries().m_entries[tableType];
+
+		const uint32_t invalidEntry = MakeHuffmanEntry(0, kHuffmanEntryInvalid, 0, 0);
+		for (size_t i = 0; i < primarySize; i++)
+			table[i] = invalidEntry;
+
+		for (unsigned int symbol = 0; symbol < numSymbols; symbol++)
+		{
+			const unsigned int length = lengths[symbol];
+			if (length == 0)
+				continue;
+
+			// Deflate packs Huffman codes starting from the most significant bit
+			const unsigned int canonicalCode = nextCode[length]++;
+			const unsigned int reversedCode = ((bitReverse[canonicalCode & 0xff] << 8) | bitReverse[canonicalCode >> 8]) >> (16 - length);
+
+			if (length <= tableBits)
+			{
+				const uint32_t entry = symbolEntries[symbol] | length;
+				for (size_t index = reversedCode; index < primarySize; index += (static_cast<size_t>(1) << length))
+					table[index] = entry;
+			}
+			else
+			{
+				const size_t primaryIndex = reversedCode & (primarySize - 1);
+
+				size_t subTableOffset = 0;
+				if (HuffmanEntryKindOf(table[primaryIndex]) == kHuffmanEntrySubTable)
+					subTableOffset = HuffmanEntryValue(table[primaryIndex]);
+				else
+				{
+					if (tableCapacity - tableUsed < subTableSize)
+						return false;
+
+					subTableOffset = tableUsed;
+					tableUsed += subTableSize;
+
+					for (size_t i = 0; i < subTableSize; i++)
+						table[subTableOffset + i] = invalidEntry;
+
+					table[primaryIndex] = MakeHuffmanEntry(tableBits, kHuffmanEntrySubTable, subTableBits, static_cast<unsigned int>(subTableOffset));
+				}
+
+				const unsigned int subLength = length - tableBits;
+				const uint32_t entry = symbolEntries[symbol] | subLength;
+				for (size_t index = (reversedCode >> tableBits); index < subTableSize; index += (static_cast<size_t>(1) << subLength))
+					table[subTableOffset + index] = entry;
+			}
+		}
+
+		return true;
+	}
+
+	// Merges short literal codes that are followed by another short literal code into one lookup.  Entries are
+	// only merged with lower indexes, so going from the top down never merges an entry twice.
+	static void MergeLiteralPairs(uint32_t *table, unsigned int tableBits)
+	{
+		for (size_t index = (static_cast<size_t>(1) << tableBits); index > 0; index--)
+		{
+			const uint32_t firstEntry = table[index - 1];
+			if (HuffmanEntryKindOf(firstEntry) != kHuffmanEntryLiteral)
+				continue;
+
+			const unsigned int firstLength = HuffmanEntryLength(firstEntry);
+			if (firstLength >= tableBits)
+				continue;
+
+			const uint32_t secondEntry = table[(index - 1) >> firstLength];
+			const unsigned int secondLength = HuffmanEntryLength(secondEntry);
+			if (HuffmanEntryKindOf(secondEntry) != kHuffmanEntryLiteral || secondLength > tableBits - firstLength)
+				continue;
+
+			table[index - 1] = MakeHuffmanEntry(firstLength + secondLength, kHuffmanEntryLiteralPair, firstLength, HuffmanEntryValue(firstEntry) | (HuffmanEntryValue(secondEntry) << 8));
+		}
+	}
+
+	// Raw deflate decoder for when all of the input and output are in memory and the output size is known.
+	// It decodes straight into the output buffer and refills a 64-bit bit buffer a word at a time.
+	class MemoryInflater
+	{
+	public:
+		MemoryInflater(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
+
+		bool Inflate();
+
+	private:
+		void Refill();
+		bool ReadBits(unsigned int numBits, unsigned int &outValue);
+		bool DecodeSymbol(const uint32_t *table, unsigned int tableBits, uint32_t &outEntry);
+
+		bool InflateStoredBlock();
+		bool InflateFixedBlock();
+		bool InflateDynamicBlock();
+		bool InflateHuffmanBlock();
+
+		enum FastDecodeResult
+		{
+			kFastDecodeEndOfBlock,
+			kFastDecodeNeedsChecks,
+			kFastDecodeFailed,
+		};
+
+		FastDecodeResult InflateHuffmanFast();
+
+		const uint8_t *m_in;
+		const uint8_t *m_inEnd;
+		uint8_t *m_outStart;
+		uint8_t *m_out;
+		uint8_t *m_outEnd;
+
+		uint64_t m_bitBuffer;
+		unsigned int m_bitCount;
+
+		uint32_t m_litLenTable[kLitLenTableCapacity];
+		uint32_t m_distanceTable[kDistanceTableCapacity];
+	};
+
+	MemoryInflater::MemoryInflater(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize)
+		: m_in(static_cast<const uint8_t*>(inBuffer))
+		, m_inEnd(static_cast<const uint8_t*>(inBuffer) + inSize)
+		, m_outStart(static_cast<uint8_t*>(outBuffer))
+		, m_out(static_cast<uint8_t*>(outBuffer))
+		, m_outEnd(static_cast<uint8_t*>(outBuffer) + outSize)
+		, m_bitBuffer(0)
+		, m_bitCount(0)
+	{
+	}
+
+	bool MemoryInflater::Inflate()
+	{
+		for (;;)
+		{
+			unsigned int header = 0;
+			if (!ReadBits(3, header))
+				return false;
+
+			bool blockOK = false;
+			switch (header >> 1)
+			{
+			case 0:
+				blockOK = InflateStoredBlock();
+				break;
+			case 1:
+				blockOK = InflateFixedBlock();
+				break;
+			case 2:
+				blockOK = InflateDynamicBlock();
+				break;
+			default:
+				return false;
+			}
+
+			if (!blockOK)
+				return false;
+
+			if (header & 1)
+				break;
+		}
+
+		return m_out == m_outEnd;
+	}
+
+	void MemoryInflater::Refill()
+	{
+		if (m_inEnd - m_in >= 8)
+		{
+			// Loads a whole word and then only counts the bytes that fit.  Bits of a partially-fitting byte are
+			// loaded again by the next refill, which is harmless because they're the same.
+			m_bitBuffer |= LoadLittleEndian64(m_in) << m_bitCount;
+			m_in += (63 - m_bitCount) >> 3;
+			m_bitCount |= 56;
+		}
+		else
+		{
+			while (m_bitCount <= 56 && m_in != m_inEnd)
+			{
+				m_bitBuffer |= static_cast<uint64_t>(*m_in++) << m_bitCount;
+				m_bitCount += 8;
+			}
+		}
+	}
+
+	bool MemoryInflater::ReadBits(unsigned int numBits, unsigned int &outValue)
+	{
+		if (m_bitCount < numBits)
+		{
+			Refill();
+			if (m_bitCount < numBits)
+				return false;
+		}
+
+		outValue = static_cast<unsigned int>(m_bitBuffer & ((static_cast<uint64_t>(1) << numBits) - 1));
+		m_bitBuffer >>= numBits;
+		m_bitCount -= numBits;
+
+		return true;
+	}
+
+	bool MemoryInflater::DecodeSymbol(const uint32_t *table, unsigned int tableBits, uint32_t &outEntry)
+	{
+		if (m_bitCount < kMaxCodeLength)
+			Refill();
+
+		uint32_t entry = table[m_bitBuffer & ((1u << tableBits) - 1)];
+
+		if (HuffmanEntryKindOf(entry) == kHuffmanEntrySubTable)
+		{
+			if (m_bitCount < tableBits)
+				return false;
+
+			m_bitBuffer >>= tableBits;
+			m_bitCount -= tableBits;
+
+			const unsigned int subTableBits = HuffmanEntryNibble(entry);
+			entry = table[HuffmanEntryValue(entry) + (m_bitBuffer & ((1u << subTableBits) - 1))];
+		}
+
+		const unsigned int length = HuffmanEntryLength(entry);
+		if (HuffmanEntryKindOf(entry) == kHuffmanEntryInvalid || length > m_bitCount)
+			return false;
+
+		m_bitBuffer >>= length;
+		m_bitCount -= length;
+
+		outEntry = entry;
+		return true;
+	}
+
+	bool MemoryInflater::InflateStoredBlock()
+	{
+		// Give back whole bytes that are still in the bit buffer
+		const unsigned int bitsToAlign = m_bitCount & 7;
+		m_bitBuffer >>= bitsToAlign;
+		m_bitCount -= bitsToAlign;
+
+		m_in -= m_bitCount >> 3;
+		m_bitBuffer = 0;
+		m_bitCount = 0;
+
+		if (m_inEnd - m_in < 4)
+			return false;
+
+		const size_t length = m_in[0] | (m_in[1] << 8);
+		const size_t invLength = m_in[2] | (m_in[3] << 8);
+		m_in += 4;
+
+		if ((length ^ 0xffff) != invLength)
+			return false;
+
+		if (static_cast<size_t>(m_inEnd - m_in) < length || static_cast<size_t>(m_outEnd - m_out) < length)
+			return false;
+
+		memcpy(m_out, m_in, length);
+		m_in += length;
+		m_out += length;
+
+		return true;
+	}
+
+	bool MemoryInflater::InflateFixedBlock()
+	{
+		uint8_t lengths[288 + 32];
+
+		for (unsigned int i = 0; i < 144; i++)
+			lengths[i] = 8;
+		for (unsigned int i = 144; i < 256; i++)
+			lengths[i] = 9;
+		for (unsigned int i = 256; i < 280; i++)
+			lengths[i] = 7;
+		for (unsigned int i = 280; i < 288; i++)
+			lengths[i] = 8;
+		for (unsigned int i = 288; i < 288 + 32; i++)
+			lengths[i] = 5;
+
+		if (!BuildHuffmanTable(lengths, 288, kHuffmanTableLitLen, kLitLenTableBits, m_litLenTable, kLitLenTableCapacity))
+			return false;
+
+		if (!BuildHuffmanTable(lengths + 288, 32, kHuffmanTableDistance, kDistanceTableBits, m_distanceTable, kDistanceTableCapacity))
+			return false;
+
+		if (static_cast<size_t>(m_outEnd - m_out) >= kLiteralPairMinOutput)
+			MergeLiteralPairs(m_litLenTable, kLitLenTableBits);
+
+		return InflateHuffmanBlock();
+	}
+
+	bool MemoryInflater::InflateDynamicBlock()
+	{
+		unsigned int numLitLenCodes = 0;
+		unsigned int numDistanceCodes = 0;
+		unsigned int numCodeLengthCodes = 0;
+
+		if (!ReadBits(5, numLitLenCodes) || !ReadBits(5, numDistanceCodes) || !ReadBits(4, numCodeLengthCodes))
+			return false;
+
+		numLitLenCodes += 257;
+		numDistanceCodes += 1;
+		numCodeLengthCodes += 4;
+
+		if (numLitLenCodes > 286 || numDistanceCodes > 30)
+			return false;
+
+		uint8_t codeLengthLengths[19];
+		for (unsigned int i = 0; i < 19; i++)
+			codeLengthLengths[i] = 0;
+
+		for (unsigned int i = 0; i < numCodeLengthCodes; i++)
+		{
+			unsigned int codeLengthLength = 0;
+			if (!ReadBits(3, codeLengthLength))
+				return false;
+
+			codeLengthLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(codeLengthLength);
+		}
+
+		uint32_t codeLengthTable[kCodeLengthTableCapacity];
+		if (!BuildHuffmanTable(codeLengthLengths, 19, kHuffmanTableCodeLength, kCodeLengthTableBits, codeLengthTable, kCodeLengthTableCapacity))
+			return false;
+
+		// Literal/length and distance code lengths are one sequence, repeats can cross from one to the other
+		uint8_t lengths[286 + 30];
+		const unsigned int numLengths = numLitLenCodes + numDistanceCodes;
+
+		unsigned int lengthIndex = 0;
+		while (lengthIndex < numLengths)
+		{
+			uint32_t entry = 0;
+			if (!DecodeSymbol(codeLengthTable, kCodeLengthTableBits, entry))
+				return false;
+
+			const unsigned int symbol = HuffmanEntryValue(entry);
+			if (symbol < 16)
+			{
+				lengths[lengthIndex++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+
+			uint8_t repeatedLength = 0;
+			unsigned int repeatCount = 0;
+
+			if (symbol == 16)
+			{
+				if (lengthIndex == 0 || !ReadBits(2, repeatCount))
+					return false;
+
+				repeatedLength = lengths[lengthIndex - 1];
+				repeatCount += 3;
+			}
+			else if (symbol == 17)
+			{
+				if (!ReadBits(3, repeatCount))
+					return false;
+
+				repeatCount += 3;
+			}
+			else
+			{
+				if (!ReadBits(7, repeatCount))
+					return false;
+
+				repeatCount += 11;
+			}
+
+			if (numLengths - lengthIndex < repeatCount)
+				return false;
+
+			for (unsigned int i = 0; i < repeatCount; i++)
+				lengths[lengthIndex++] = repeatedLength;
+		}
+
+		// A block with no end-of-block code can't be terminated
+		if (lengths[256] == 0)
+			return false;
+
+		if (!BuildHuffmanTable(lengths, numLitLenCodes, kHuffmanTableLitLen, kLitLenTableBits, m_litLenTable, kLitLenTableCapacity))
+			return false;
+
+		if (!BuildHuffmanTable(lengths + numLitLenCodes, numDistanceCodes, kHuffmanTableDistance, kDistanceTableBits, m_distanceTable, kDistanceTableCapacity))
+			return false;
+
+		if (static_cast<size_t>(m_outEnd - m_out) >= kLiteralPairMinOutput)
+			MergeLiteralPairs(m_litLenTable, kLitLenTableBits);
+
+		return InflateHuffmanBlock();
+	}
+
+	MemoryInflater::FastDecodeResult MemoryInflater::InflateHuffmanFast()
+	{
+		// The state is copied into locals because output stores may alias anything, which would otherwise force
+		// the bit buffer and pointers to be reloaded from the object after every byte written
+		const uint8_t *in = m_in;
+		const uint8_t *const inEnd = m_inEnd;
+		uint8_t *out = m_out;
+		uint8_t *const outStart = m_outStart;
+		uint8_t *const outEnd = m_outEnd;
+		uint64_t bitBuffer = m_bitBuffer;
+		unsigned int bitCount = m_bitCount;
+
+		const uint32_t *litLenTable = m_litLenTable;
+		const uint32_t *distanceTable = m_distanceTable;
+
+		const uint64_t litLenMask = (1 << kLitLenTableBits) - 1;
+		const uint64_t distanceMask = (1 << kDistanceTableBits) - 1;
+
+		FastDecodeResult result = kFastDecodeNeedsChecks;
+
+		// With 8 bytes of input and room for the longest match plus a word of copy overrun, a refill gives enough
+		// bits for a whole length/distance pair and nothing needs to be bounds checked until the next one
+		while (inEnd - in >= 8 && static_cast<size_t>(outEnd - out) >= kFastPathOutputSlack)
+		{
+			// Loads a whole word and then only counts the bytes that fit.  Bits of a partially-fitting byte are
+			// loaded again by the next refill, which is harmless because they're the same.
+			bitBuffer |= LoadLittleEndian64(in) << bitCount;
+			in += (63 - bitCount) >> 3;
+			bitCount |= 56;
+
+			uint32_t entry = litLenTable[bitBuffer & litLenMask];
+			if (HuffmanEntryKindOf(entry) == kHuffmanEntrySubTable)
+			{
+				bitBuffer >>= kLitLenTableBits;
+				bitCount -= kLitLenTableBits;
+				entry = litLenTable[HuffmanEntryValue(entry) + (bitBuffer & ((1u << HuffmanEntryNibble(entry)) - 1))];
+			}
+
+			const unsigned int entryLength = HuffmanEntryLength(entry);
+			bitBuffer >>= entryLength;
+			bitCount -= entryLength;
+
+			const HuffmanEntryKind kind = HuffmanEntryKindOf(entry);
+			if (kind == kHuffmanEntryLiteral)
+			{
+				*out++ = static_cast<uint8_t>(HuffmanEntryValue(entry));
+				continue;
+			}
+
+			if (kind == kHuffmanEntryLiteralPair)
+			{
+				const unsigned int literals = HuffmanEntryValue(entry);
+				out[0] = static_cast<uint8_t>(literals & 0xff);
+				out[1] = static_cast<uint8_t>(literals >> 8);
+				out += 2;
+				continue;
+			}
+
+			if (kind == kHuffmanEntryEndOfBlock)
+			{
+				result = kFastDecodeEndOfBlock;
+				break;
+			}
+
+			if (kind != kHuffmanEntryLength)
+			{
+				result = kFastDecodeFailed;
+				break;
+			}
+
+			const unsigned int lengthExtraBits = HuffmanEntryNibble(entry);
+			const size_t length = HuffmanEntryValue(entry) + static_cast<size_t>(bitBuffer & ((static_cast<uint64_t>(1) << lengthExtraBits) - 1));
+			bitBuffer >>= lengthExtraBits;
+			bitCount -= lengthExtraBits;
+
+			uint32_t distanceEntry = distanceTable[bitBuffer & distanceMask];
+			if (HuffmanEntryKindOf(distanceEntry) == kHuffmanEntrySubTable)
+			{
+				bitBuffer >>= kDistanceTableBits;
+				bitCount -= kDistanceTableBits;
+				distanceEntry = distanceTable[HuffmanEntryValue(distanceEntry) + (bitBuffer & ((1u << HuffmanEntryNibble(distanceEntry)) - 1))];
+			}
+
+			if (HuffmanEntryKindOf(distanceEntry) != kHuffmanEntryDistance)
+			{
+				result = kFastDecodeFailed;
+				break;
+			}
+
+			const unsigned int distanceLength = HuffmanEntryLength(distanceEntry);
+			bitBuffer >>= distanceLength;
+			bitCount -= distanceLength;
+
+			const unsigned int distanceExtraBits = HuffmanEntryNibble(distanceEntry);
+			const size_t distance = HuffmanEntryValue(distanceEntry) + static_cast<size_t>(bitBuffer & ((static_cast<uint64_t>(1) << distanceExtraBits) - 1));
+			bitBuffer >>= distanceExtraBits;
+			bitCount -= distanceExtraBits;
+
+			if (distance > static_cast<size_t>(out - outStart))
+			{
+				result = kFastDecodeFailed;
+				break;
+			}
+
+			// Copies may run up to 7 bytes past the end of the match, which the slack allows for
+			const uint8_t *copySrc = out - distance;
+			if (distance >= 8)
+			{
+				for (size_t i = 0; i < length; i += 8)
+				{
+					uint64_t copyWord;
+					memcpy(&copyWord, copySrc + i, 8);
+					memcpy(out + i, &copyWord, 8);
+				}
+			}
+			else if (distance == 1)
+			{
+				const uint64_t runWord = copySrc[0] * static_cast<uint64_t>(0x0101010101010101ULL);
+				for (size_t i = 0; i < length; i += 8)
+					memcpy(out + i, &runWord, 8);
+			}
+			else
+			{
+				// Overlapping copies repeat the last "distance" bytes
+				for (size_t i = 0; i < length; i++)
+					out[i] = copySrc[i];
+			}
+
+			out += length;
+		}
+
+		m_in = in;
+		m_out = out;
+		m_bitBuffer = bitBuffer;
+		m_bitCount = bitCount;
+
+		return result;
+	}
+
+	bool MemoryInflater::InflateHuffmanBlock()
+	{
+		for (;;)
+		{
+			const FastDecodeResult fastResult = InflateHuffmanFast();
+			if (fastResult == kFastDecodeEndOfBlock)
+				return true;
+			if (fastResult == kFastDecodeFailed)
+				return false;
+
+			// Near the end of the input or output, decode one symbol at a time with every read and write checked
+			uint32_t entry = 0;
+			if (!DecodeSymbol(m_litLenTable, kLitLenTableBits, entry))
+				return false;
+
+			switch (HuffmanEntryKindOf(entry))
+			{
+			case kHuffmanEntryLiteralPair:
+				{
+					// Codes are prefix-free, so the second literal is always the next symbol and needs room too
+					if (m_outEnd - m_out < 2)
+						return false;
+
+					const unsigned int literals = HuffmanEntryValue(entry);
+					m_out[0] = static_cast<uint8_t>(literals & 0xff);
+					m_out[1] = static_cast<uint8_t>(literals >> 8);
+					m_out += 2;
+				}
+				break;
+
+			case kHuffmanEntryLiteral:
+				if (m_out == m_outEnd)
+					return false;
+
+				*m_out++ = static_cast<uint8_t>(HuffmanEntryValue(entry));
+				break;
+
+			case kHuffmanEntryEndOfBlock:
+				return true;
+
+			case kHuffmanEntryLength:
+				{
+					unsigned int extra = 0;
+					if (!ReadBits(HuffmanEntryNibble(entry), extra))
+						return false;
+
+					const size_t length = HuffmanEntryValue(entry) + extra;
+
+					uint32_t distanceEntry = 0;
+					if (!DecodeSymbol(m_distanceTable, kDistanceTableBits, distanceEntry) || HuffmanEntryKindOf(distanceEntry) != kHuffmanEntryDistance)
+						return false;
+
+					if (!ReadBits(HuffmanEntryNibble(distanceEntry), extra))
+						return false;
+
+					const size_t distance = HuffmanEntryValue(distanceEntry) + extra;
+
+					if (distance > static_cast<size_t>(m_out - m_outStart) || length > static_cast<size_t>(m_outEnd - m_out))
+						return false;
+
+					const uint8_t *copySrc = m_out - distance;
+					for (size_t i = 0; i < length; i++)
+						m_out[i] = copySrc[i];
+
+					m_out += length;
+				}
+				break;
+
+			default:
+				return false;
+			}
+		}
+	}
 }
 
 bool PortabilityLayer::DeflateCodec::DecompressStream(GpIOStream *stream, size_t inSize, void *outBuffer, size_t outSize)
@@ -86,6 +919,61 @@ bool PortabilityLayer::DeflateCodec::DecompressStream(GpIOStream *stream, size_t
 	return !failed;
 }
 
+bool PortabilityLayer::DeflateCodec::DecompressMemory(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize)
+{
+	// Below this, setting up the fast decoder's tables costs as much as it saves
+	const size_t kFastMinOutSize = 16 * 1024;
+
+	if (outSize < kFastMinOutSize)
+		return DecompressMemoryZlib(inBuffer, inSize, outBuffer, outSize);
+
+	if (DecompressMemoryFast(inBuffer, inSize, outBuffer, outSize))
+		return true;
+
+	// Anything the fast path rejects gets a second opinion from zlib
+	return DecompressMemoryZlib(inBuffer, inSize, outBuffer, outSize);
+}
+
+bool PortabilityLayer::DeflateCodec::DecompressMemoryFast(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize)
+{
+	// The decoder's tables are too big for the stack
+	void *storage = MemoryManager::GetInstance()->Alloc(sizeof(MemoryInflater));
+	if (!storage)
+		return false;
+
+	MemoryInflater *inflater = new (storage) MemoryInflater(inBuffer, inSize, outBuffer, outSize);
+	const bool succeeded = inflater->Inflate();
+
+	inflater->~MemoryInflater();
+	MemoryManager::GetInstance()->Release(storage);
+
+	return succeeded;
+}
+
+bool PortabilityLayer::DeflateCodec::DecompressMemoryZlib(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize)
+{
+	z_stream zstream;
+	zstream.zalloc = ZlibAllocShim;
+	zstream.zfree = ZlibFreeShim;
+	zstream.opaque = MemoryManager::GetInstance();
+
+	if (inflateInit2(&zstream, -15) != Z_OK)
+		return false;
+
+	// All of the input is available, so this runs to the end in one call unless the data is bad
+	zstream.avail_in = static_cast<uInt>(inSize);
+	zstream.next_in = static_cast<Bytef*>(const_cast<void*>(inBuffer));
+	zstream.avail_out = static_cast<uInt>(outSize);
+	zstream.next_out = static_cast<Bytef*>(outBuffer);
+
+	const int result = inflate(&zstream, Z_FINISH);
+	const bool succeeded = (result == Z_STREAM_END && zstream.avail_out == 0);
+
+	inflateEnd(&zstream);
+
+	return succeeded;
+}
+
 namespace PortabilityLayer
 {
 	class DeflateContextImpl final : public DeflateContext
@@ -366,7 +1254,28 @@ PortabilityLayer::DeflateContext *PortabilityLayer::DeflateContext::Create(GpIOS
 
 uint32_t PortabilityLayer::DeflateContext::CRC32(uint32_t inputValue, const void *buffer, size_t bufferLength)
 {
-	return crc32(inputValue, static_cast<const Bytef*>(buffer), bufferLength);
+	// Slice-by-8, same results as zlib's crc32
+	const uint32_t (&tables)[8][256] = GetCRC32Tables().m_tables;
+	const uint8_t *bytes = static_cast<const uint8_t*>(buffer);
+
+	uint32_t crc = ~inputValue;
+
+	while (bufferLength >= 8)
+	{
+		const uint32_t low = crc ^ (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24));
+		const uint32_t high = bytes[4] | (bytes[5] << 8) | (bytes[6] << 16) | (static_cast<uint32_t>(bytes[7]) << 24);
+
+		crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^ tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24]
+			^ tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^ tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+
+		bytes += 8;
+		bufferLength -= 8;
+	}
+
+	while (bufferLength--)
+		crc = tables[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
 }
 
 
@@ -37,5 +37,10 @@ namespace PortabilityLayer
 	{
 	public:
 		static bool DecompressStream(GpIOStream *stream, size_t inSize, void *outBuffer, size_t outSize);
+		// Decompresses large outputs with the fast one-shot decoder, falling back to zlib if it fails, and small ones with zlib
+		static bool DecompressMemory(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
+
+		static bool DecompressMemoryFast(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
+		static bool DecompressMemoryZlib(const void *inBuffer, size_t inSize, void *outBuffer, size_t outSize);
 	};
 }
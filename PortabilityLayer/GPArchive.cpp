@@ -1,5 +1,6 @@
 #include "GPArchive.h"
 #include "ResTypeID.h"
+#include "ZipFileProxy.h"
 
 #include <string.h>
 
@@ -143,4 +144,15 @@ namespace PortabilityLayer
 		outTag = ResTypeID(decodedChars);
 		return true;
 	}
+
+	const char *GpArchiveIndexHeader::GetFileName()
+	{
+		return "ArchiveIndex.bin";
+	}
+
+	size_t GpArchiveIndexHeader::GetMaxSize(size_t numFiles)
+	{
+		// Every file could be a resource
+		return sizeof(GpArchiveIndexHeader) + numFiles * sizeof(uint32_t) + ZipFileProxy::GetPathHashTableSize(numFiles) * sizeof(uint32_t) + numFiles * sizeof(GpArchiveIndexTypedRef);
+	}
 }
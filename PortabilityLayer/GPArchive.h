@@ -1,5 +1,9 @@
 #pragma once
 
+#include "PLLittleEndian.h"
+
+#include <stddef.h>
+
 namespace PortabilityLayer
 {
 	class ResTypeID;
@@ -13,4 +17,33 @@ namespace PortabilityLayer
 		bool Load(const char *str);
 		bool Decode(ResTypeID &outTag);
 	};
+
+	// Version 2 archives start with a stored file holding the indexes that the loader would otherwise build by sorting and
+	// hashing the central directory and parsing every resource path.  Archives without one, or with one that doesn't match
+	// the central directory, are indexed the slow way.
+	struct GpArchiveIndexHeader
+	{
+		static const uint32_t kSignature = 0x32415047;	// "GPA2"
+
+		LEUInt32_t m_signature;
+		LEUInt32_t m_numFiles;			// Must match the central directory
+		LEUInt32_t m_centralDirSize;	// Must match the central directory
+		LEUInt32_t m_pathHashTableSize;
+		LEUInt32_t m_numTypedRefs;
+
+		// LEUInt32_t[m_numFiles]: Offset of each file's central directory header, in path order
+		// LEUInt32_t[m_pathHashTableSize]: Path hash table of path order indexes + 1
+		// GpArchiveIndexTypedRef[m_numTypedRefs]: Resources sorted by type and then ID
+
+		static const char *GetFileName();
+		static size_t GetMaxSize(size_t numFiles);
+	};
+
+	struct GpArchiveIndexTypedRef
+	{
+		LEInt32_t m_resType;
+		LEInt16_t m_resID;
+		LEUInt16_t m_reserved;
+		LEUInt32_t m_fileIndex;
+	};
 }
@@ -4,6 +4,7 @@
 #include "DisplayDeviceManager.h"
 
 #include "PLDrivers.h"
+#include "IGpAudioDriver.h"
 #include "IGpDisplayDriver.h"
 
 
@@ -13,5 +14,9 @@ namespace PortabilityLayer
 	{
 		PLDrivers::GetDisplayDriver()->ServeTicks(ticks);
 		DisplayDeviceManager::GetInstance()->IncrementTickCount(ticks);
+
+		// Offline audio is mixed in step with game time, not with display frames
+		if (IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver())
+			audioDriver->ServeTicks(ticks);
 	}
 }
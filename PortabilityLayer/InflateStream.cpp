@@ -194,11 +194,11 @@ namespace PortabilityLayer
 		}
 		else if (loc > 0)
 		{
-			GpUFilePos_t positivePos = static_cast<GpUFilePos_t>(-loc);
+			GpUFilePos_t positivePos = static_cast<GpUFilePos_t>(loc);
 			if (positivePos > m_decompressedSize - m_decompressedPos)
 				return false;
 
-			return this->Read(nullptr, static_cast<size_t>(positivePos));
+			return this->Read(nullptr, static_cast<size_t>(positivePos)) == positivePos;
 		}
 		else
 			return true;
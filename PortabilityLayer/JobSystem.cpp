@@ -0,0 +1,778 @@
+#include "JobSystem.h"
+
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
+#include "MemoryManager.h"
+
+#include "PLDrivers.h"
+
+#include <assert.h>
+#include <atomic>
+#include <new>
+
+namespace PortabilityLayer
+{
+	struct JobDependentLink
+	{
+		Job *m_dependent;
+		JobDependentLink *m_next;
+	};
+
+	struct Job
+	{
+		Job(JobSystem::JobFunc_t func, void *context, size_t numDependencies);
+
+		JobDependentLink *GetLinks();
+
+		JobSystem::JobFunc_t m_func;
+		void *m_context;
+
+		std::atomic<size_t> m_numUnfinishedDependencies;	// Plus one while it's being submitted
+		std::atomic<unsigned int> m_refCount;				// The handle, plus the scheduler until it has finished
+		std::atomic<JobDependentLink*> m_firstDependent;	// Jobs to notify when this one finishes, or the closed link once it has
+		std::atomic<bool> m_isFinished;
+	};
+
+	// A worker's jobs.  The worker pushes and pops at the back, everyone else steals from the front.
+	class JobDeque
+	{
+	public:
+		JobDeque();
+
+		bool Init(IGpSystemServices *sysServices);
+		void Shutdown();
+
+		bool PushBack(Job *job);
+		Job *PopBack();
+		Job *PopFront();
+
+	private:
+		static const size_t kInitialCapacity = 256;
+
+		bool GrowLocked();
+
+		IGpMutex *m_mutex;
+		Job **m_jobs;
+		size_t m_capacity;		// Always a power of 2
+		size_t m_start;
+		std::atomic<size_t> m_count;	// Read without the lock to skip empty deques
+	};
+
+	struct JobWorker
+	{
+		class JobSystemImpl *m_system;
+		unsigned int m_index;
+		JobDeque m_deque;
+	};
+
+	struct JobWaiter
+	{
+		const Job *m_job;
+		IGpThreadEvent *m_event;
+		JobWaiter *m_next;
+	};
+
+	class JobSystemImpl final : public JobSystem
+	{
+	public:
+		JobSystemImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		unsigned int GetNumWorkers() const override;
+
+		Job *SubmitJob(JobFunc_t func, void *context, Job *const *dependencies, size_t numDependencies) override;
+		void ReleaseJob(Job *job) override;
+
+		bool IsJobFinished(const Job *job) const override;
+		void WaitForJob(Job *job) override;
+
+		void ParallelFor(ParallelForFunc_t func, void *context, size_t count, size_t minRangeSize) override;
+
+		static JobSystemImpl *GetInstance();
+
+	private:
+		static const unsigned int kMaxWorkers = 16;
+		static const size_t kRangesPerThread = 4;
+
+		struct ParallelForState
+		{
+			ParallelForFunc_t m_func;
+			void *m_context;
+			size_t m_count;
+			size_t m_rangeSize;
+			std::atomic<size_t> m_nextStart;
+		};
+
+		static int StaticThreadFuncThunk(void *context);
+		int ThreadFunc(JobWorker *worker);
+
+		static void ParallelForRangesThunk(void *context);
+
+		void Enqueue(Job *job);
+		Job *TakeJob(JobWorker *worker);
+		void RunJob(Job *job);
+		void WakeWaiters(const Job *job);
+		void BlockUntilFinishedOrQueued(Job *job);
+
+		IGpThreadEvent *AcquireWaitEventLocked();
+		void ReleaseWaitEventLocked(IGpThreadEvent *evt);
+
+		JobWorker m_workers[kMaxWorkers];
+		JobDeque m_sharedDeque;		// Jobs submitted from threads other than the workers
+		unsigned int m_numDeques;	// Worker deques, including any whose thread failed to start
+		unsigned int m_numWorkers;
+
+		IGpMutex *m_mutex;				// Guards the waiter list, the wait event pool, and threads exiting
+		IGpThreadEvent *m_wakeSignal;	// Auto-reset, a worker that takes a job passes it on if there's more
+		IGpThreadEvent *m_threadExitedSignal;
+
+		JobWaiter *m_firstWaiter;
+		IGpThreadEvent *m_freeWaitEvents[kMaxWorkers + 1];
+		size_t m_numFreeWaitEvents;
+
+		std::atomic<size_t> m_numQueued;
+		std::atomic<unsigned int> m_numSleeping;
+		std::atomic<unsigned int> m_numBlockedWaiters;
+		std::atomic<bool> m_terminating;
+		unsigned int m_numThreadsRunning;
+
+		static JobDependentLink ms_closedLink;
+		static JobSystemImpl ms_instance;
+	};
+
+	static thread_local JobWorker *gs_currentWorker = nullptr;
+
+	Job::Job(JobSystem::JobFunc_t func, void *context, size_t numDependencies)
+		: m_func(func)
+		, m_context(context)
+		, m_numUnfinishedDependencies(numDependencies + 1)
+		, m_refCount(2)
+		, m_firstDependent(nullptr)
+		, m_isFinished(false)
+	{
+	}
+
+	JobDependentLink *Job::GetLinks()
+	{
+		return reinterpret_cast<JobDependentLink*>(this + 1);
+	}
+
+	JobDeque::JobDeque()
+		: m_mutex(nullptr)
+		, m_jobs(nullptr)
+		, m_capacity(0)
+		, m_start(0)
+		, m_count(0)
+	{
+	}
+
+	bool JobDeque::Init(IGpSystemServices *sysServices)
+	{
+		m_mutex = sysServices->CreateMutex();
+		m_jobs = static_cast<Job**>(MemoryManager::GetInstance()->Alloc(sizeof(Job*) * kInitialCapacity));
+
+		if (!m_mutex || !m_jobs)
+		{
+			Shutdown();
+			return false;
+		}
+
+		m_capacity = kInitialCapacity;
+		m_start = 0;
+		m_count.store(0, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	void JobDeque::Shutdown()
+	{
+		assert(m_count.load(std::memory_order_relaxed) == 0);
+
+		if (m_mutex)
+			m_mutex->Destroy();
+
+		MemoryManager::GetInstance()->Release(m_jobs);
+
+		m_mutex = nullptr;
+		m_jobs = nullptr;
+		m_capacity = 0;
+	}
+
+	bool JobDeque::PushBack(Job *job)
+	{
+		m_mutex->Lock();
+
+		const size_t count = m_count.load(std::memory_order_relaxed);
+		if (count == m_capacity && !GrowLocked())
+		{
+			m_mutex->Unlock();
+			return false;
+		}
+
+		m_jobs[(m_start + count) & (m_capacity - 1)] = job;
+		m_count.store(count + 1, std::memory_order_relaxed);
+
+		m_mutex->Unlock();
+
+		return true;
+	}
+
+	Job *JobDeque::PopBack()
+	{
+		if (m_count.load(std::memory_order_relaxed) == 0)
+			return nullptr;
+
+		m_mutex->Lock();
+
+		Job *job = nullptr;
+		const size_t count = m_count.load(std::memory_order_relaxed);
+		if (count > 0)
+		{
+			job = m_jobs[(m_start + count - 1) & (m_capacity - 1)];
+			m_count.store(count - 1, std::memory_order_relaxed);
+		}
+
+		m_mutex->Unlock();
+
+		return job;
+	}
+
+	Job *JobDeque::PopFront()
+	{
+		if (m_count.load(std::memory_order_relaxed) == 0)
+			return nullptr;
+
+		m_mutex->Lock();
+
+		Job *job = nullptr;
+		const size_t count = m_count.load(std::memory_order_relaxed);
+		if (count > 0)
+		{
+			job = m_jobs[m_start];
+			m_start = (m_start + 1) & (m_capacity - 1);
+			m_count.store(count - 1, std::memory_order_relaxed);
+		}
+
+		m_mutex->Unlock();
+
+		return job;
+	}
+
+	bool JobDeque::GrowLocked()
+	{
+		const size_t newCapacity = m_capacity * 2;
+
+		Job **newJobs = static_cast<Job**>(MemoryManager::GetInstance()->Alloc(sizeof(Job*) * newCapacity));
+		if (!newJobs)
+			return false;
+
+		const size_t count = m_count.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < count; i++)
+			newJobs[i] = m_jobs[(m_start + i) & (m_capacity - 1)];
+
+		MemoryManager::GetInstance()->Release(m_jobs);
+
+		m_jobs = newJobs;
+		m_capacity = newCapacity;
+		m_start = 0;
+
+		return true;
+	}
+
+	JobSystemImpl::JobSystemImpl()
+		: m_numDeques(0)
+		, m_numWorkers(0)
+		, m_mutex(nullptr)
+		, m_wakeSignal(nullptr)
+		, m_threadExitedSignal(nullptr)
+		, m_firstWaiter(nullptr)
+		, m_numFreeWaitEvents(0)
+		, m_numQueued(0)
+		, m_numSleeping(0)
+		, m_numBlockedWaiters(0)
+		, m_terminating(false)
+		, m_numThreadsRunning(0)
+	{
+	}
+
+	void JobSystemImpl::Init()
+	{
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+		if (!sysServices)
+			return;
+
+		// The main thread runs jobs too when it waits on them, so leave it a core
+		unsigned int numWorkers = sysServices->GetCPUCount();
+		if (numWorkers > 1)
+			numWorkers--;
+		if (numWorkers < 1)
+			numWorkers = 1;
+		if (numWorkers > kMaxWorkers)
+			numWorkers = kMaxWorkers;
+
+		m_mutex = sysServices->CreateMutex();
+		m_wakeSignal = sysServices->CreateThreadEvent(true, false);
+		m_threadExitedSignal = sysServices->CreateThreadEvent(true, false);
+
+		if (!m_mutex || !m_wakeSignal || !m_threadExitedSignal || !m_sharedDeque.Init(sysServices))
+		{
+			Shutdown();
+			return;
+		}
+
+		for (unsigned int i = 0; i < numWorkers; i++)
+		{
+			JobWorker &worker = m_workers[i];
+			worker.m_system = this;
+			worker.m_index = i;
+
+			if (!worker.m_deque.Init(sysServices))
+				break;
+
+			m_numDeques++;
+		}
+
+		m_terminating.store(false);
+
+		unsigned int numStarted = 0;
+		for (unsigned int i = 0; i < m_numDeques; i++)
+		{
+			m_mutex->Lock();
+			m_numThreadsRunning++;
+			m_mutex->Unlock();
+
+			if (!sysServices->CreateThread(JobSystemImpl::StaticThreadFuncThunk, &m_workers[i]))
+			{
+				m_mutex->Lock();
+				m_numThreadsRunning--;
+				m_mutex->Unlock();
+				break;
+			}
+
+			numStarted++;
+		}
+
+		if (numStarted == 0)
+		{
+			Shutdown();
+			return;
+		}
+
+		m_numWorkers = numStarted;
+	}
+
+	void JobSystemImpl::Shutdown()
+	{
+		if (m_mutex)
+		{
+			assert(m_numQueued.load() == 0);
+			m_terminating.store(true);
+
+			m_wakeSignal->Signal();
+
+			for (;;)
+			{
+				m_mutex->Lock();
+				const unsigned int numThreadsRunning = m_numThreadsRunning;
+				m_mutex->Unlock();
+
+				if (numThreadsRunning == 0)
+					break;
+
+				m_threadExitedSignal->Wait();
+			}
+
+			assert(m_firstWaiter == nullptr);
+		}
+
+		for (unsigned int i = 0; i < m_numDeques; i++)
+			m_workers[i].m_deque.Shutdown();
+
+		m_sharedDeque.Shutdown();
+
+		for (size_t i = 0; i < m_numFreeWaitEvents; i++)
+			m_freeWaitEvents[i]->Destroy();
+
+		if (m_threadExitedSignal)
+			m_threadExitedSignal->Destroy();
+		if (m_wakeSignal)
+			m_wakeSignal->Destroy();
+		if (m_mutex)
+			m_mutex->Destroy();
+
+		m_numFreeWaitEvents = 0;
+		m_numDeques = 0;
+		m_numWorkers = 0;
+		m_threadExitedSignal = nullptr;
+		m_wakeSignal = nullptr;
+		m_mutex = nullptr;
+	}
+
+	unsigned int JobSystemImpl::GetNumWorkers() const
+	{
+		return m_numWorkers;
+	}
+
+	Job *JobSystemImpl::SubmitJob(JobFunc_t func, void *context, Job *const *dependencies, size_t numDependencies)
+	{
+		void *storage = MemoryManager::GetInstance()->Alloc(sizeof(Job) + sizeof(JobDependentLink) * numDependencies);
+		if (!storage)
+		{
+			for (size_t i = 0; i < numDependencies; i++)
+			{
+				if (dependencies[i])
+					WaitForJob(dependencies[i]);
+			}
+
+			func(context);
+			return nullptr;
+		}
+
+		Job *job = new (storage) Job(func, context, numDependencies);
+		JobDependentLink *links = job->GetLinks();
+
+		size_t numFinishedDependencies = 0;
+		for (size_t i = 0; i < numDependencies; i++)
+		{
+			Job *dependency = dependencies[i];
+			if (!dependency)
+			{
+				numFinishedDependencies++;
+				continue;
+			}
+
+			JobDependentLink *link = links + i;
+			link->m_dependent = job;
+
+			JobDependentLink *firstDependent = dependency->m_firstDependent.load();
+			for (;;)
+			{
+				if (firstDependent == &ms_closedLink)
+				{
+					numFinishedDependencies++;
+					break;
+				}
+
+				link->m_next = firstDependent;
+				if (dependency->m_firstDependent.compare_exchange_weak(firstDependent, link))
+					break;
+			}
+		}
+
+		// Drop the submission count along with the dependencies that were already done
+		if (job->m_numUnfinishedDependencies.fetch_sub(numFinishedDependencies + 1) == numFinishedDependencies + 1)
+			Enqueue(job);
+
+		return job;
+	}
+
+	void JobSystemImpl::ReleaseJob(Job *job)
+	{
+		if (!job)
+			return;
+
+		if (job->m_refCount.fetch_sub(1) == 1)
+		{
+			job->~Job();
+			MemoryManager::GetInstance()->Release(job);
+		}
+	}
+
+	bool JobSystemImpl::IsJobFinished(const Job *job) const
+	{
+		return job == nullptr || job->m_isFinished.load();
+	}
+
+	void JobSystemImpl::WaitForJob(Job *job)
+	{
+		if (!job)
+			return;
+
+		JobWorker *worker = gs_currentWorker;
+
+		while (!job->m_isFinished.load())
+		{
+			Job *otherJob = TakeJob(worker);
+			if (otherJob)
+				RunJob(otherJob);
+			else
+				BlockUntilFinishedOrQueued(job);
+		}
+	}
+
+	void JobSystemImpl::ParallelFor(ParallelForFunc_t func, void *context, size_t count, size_t minRangeSize)
+	{
+		if (count == 0)
+			return;
+
+		if (minRangeSize < 1)
+			minRangeSize = 1;
+
+		// Split into a few ranges per thread so that threads that finish early can pick up the slack
+		const size_t numTargetRanges = (static_cast<size_t>(m_numWorkers) + 1) * kRangesPerThread;
+		size_t rangeSize = (count + numTargetRanges - 1) / numTargetRanges;
+		if (rangeSize < minRangeSize)
+			rangeSize = minRangeSize;
+
+		const size_t numRanges = (count + rangeSize - 1) / rangeSize;
+
+		size_t numHelpers = numRanges - 1;
+		if (numHelpers > m_numWorkers)
+			numHelpers = m_numWorkers;
+
+		if (numHelpers == 0)
+		{
+			func(context, 0, count);
+			return;
+		}
+
+		ParallelForState state;
+		state.m_func = func;
+		state.m_context = context;
+		state.m_count = count;
+		state.m_rangeSize = rangeSize;
+		state.m_nextStart.store(0);
+
+		Job *helpers[kMaxWorkers];
+		for (size_t i = 0; i < numHelpers; i++)
+			helpers[i] = SubmitJob(JobSystemImpl::ParallelForRangesThunk, &state, nullptr, 0);
+
+		ParallelForRangesThunk(&state);
+
+		for (size_t i = 0; i < numHelpers; i++)
+		{
+			WaitForJob(helpers[i]);
+			ReleaseJob(helpers[i]);
+		}
+	}
+
+	JobSystemImpl *JobSystemImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	int JobSystemImpl::StaticThreadFuncThunk(void *context)
+	{
+		JobWorker *worker = static_cast<JobWorker*>(context);
+		return worker->m_system->ThreadFunc(worker);
+	}
+
+	int JobSystemImpl::ThreadFunc(JobWorker *worker)
+	{
+		gs_currentWorker = worker;
+
+		for (;;)
+		{
+			Job *job = TakeJob(worker);
+			if (job)
+			{
+				RunJob(job);
+				continue;
+			}
+
+			if (m_terminating.load())
+				break;
+
+			// Announce that we're going to sleep before checking for work one last time, anything queued after
+			// the check will see us and signal
+			m_numSleeping.fetch_add(1);
+			if (m_numQueued.load() == 0 && !m_terminating.load())
+				m_wakeSignal->Wait();
+			m_numSleeping.fetch_sub(1);
+		}
+
+		// Pass the wake-up on so that every worker sees it
+		m_wakeSignal->Signal();
+
+		gs_currentWorker = nullptr;
+
+		m_mutex->Lock();
+		m_numThreadsRunning--;
+		m_threadExitedSignal->Signal();
+		m_mutex->Unlock();
+
+		return 0;
+	}
+
+	void JobSystemImpl::ParallelForRangesThunk(void *context)
+	{
+		ParallelForState *state = static_cast<ParallelForState*>(context);
+
+		for (;;)
+		{
+			const size_t startIndex = state->m_nextStart.fetch_add(state->m_rangeSize);
+			if (startIndex >= state->m_count)
+				break;
+
+			size_t endIndex = startIndex + state->m_rangeSize;
+			if (endIndex > state->m_count)
+				endIndex = state->m_count;
+
+			state->m_func(state->m_context, startIndex, endIndex);
+		}
+	}
+
+	void JobSystemImpl::Enqueue(Job *job)
+	{
+		// Without workers, jobs run as soon as they're ready
+		if (m_numWorkers == 0)
+		{
+			RunJob(job);
+			return;
+		}
+
+		JobWorker *worker = gs_currentWorker;
+		JobDeque &deque = worker ? worker->m_deque : m_sharedDeque;
+
+		// Count the job before it can be taken, so that the count never drops below the number in the deques
+		m_numQueued.fetch_add(1);
+
+		if (!deque.PushBack(job))
+		{
+			m_numQueued.fetch_sub(1);
+			RunJob(job);
+			return;
+		}
+
+		if (m_numSleeping.load() > 0)
+			m_wakeSignal->Signal();
+		else if (m_numBlockedWaiters.load() > 0)
+			WakeWaiters(nullptr);	// Every worker is busy, so let anyone blocked on a job help out
+	}
+
+	Job *JobSystemImpl::TakeJob(JobWorker *worker)
+	{
+		Job *job = nullptr;
+
+		if (worker)
+			job = worker->m_deque.PopBack();
+
+		if (!job)
+			job = m_sharedDeque.PopFront();
+
+		if (!job)
+		{
+			const unsigned int firstVictim = worker ? (worker->m_index + 1) : 0;
+			for (unsigned int i = 0; i < m_numDeques && !job; i++)
+			{
+				unsigned int victim = firstVictim + i;
+				if (victim >= m_numDeques)
+					victim -= m_numDeques;
+
+				JobWorker *victimWorker = m_workers + victim;
+				if (victimWorker != worker)
+					job = victimWorker->m_deque.PopFront();
+			}
+		}
+
+		if (!job)
+			return nullptr;
+
+		if (m_numQueued.fetch_sub(1) > 1 && m_numSleeping.load() > 0)
+			m_wakeSignal->Signal();
+
+		return job;
+	}
+
+	void JobSystemImpl::RunJob(Job *job)
+	{
+		job->m_func(job->m_context);
+
+		JobDependentLink *link = job->m_firstDependent.exchange(&ms_closedLink);
+		while (link)
+		{
+			// The dependent may run and be released as soon as it's enqueued, so read the link first
+			JobDependentLink *nextLink = link->m_next;
+			Job *dependent = link->m_dependent;
+
+			if (dependent->m_numUnfinishedDependencies.fetch_sub(1) == 1)
+				Enqueue(dependent);
+
+			link = nextLink;
+		}
+
+		job->m_isFinished.store(true);
+
+		if (m_numBlockedWaiters.load() > 0)
+			WakeWaiters(job);
+
+		ReleaseJob(job);
+	}
+
+	// Wakes the threads blocked on a job, or every blocked thread if the job is null
+	void JobSystemImpl::WakeWaiters(const Job *job)
+	{
+		m_mutex->Lock();
+		for (JobWaiter *waiter = m_firstWaiter; waiter; waiter = waiter->m_next)
+		{
+			if (job == nullptr || waiter->m_job == job)
+				waiter->m_event->Signal();
+		}
+		m_mutex->Unlock();
+	}
+
+	void JobSystemImpl::BlockUntilFinishedOrQueued(Job *job)
+	{
+		JobWaiter waiter;
+		waiter.m_job = job;
+
+		m_mutex->Lock();
+		waiter.m_event = AcquireWaitEventLocked();
+		if (!waiter.m_event)
+		{
+			m_mutex->Unlock();
+			return;	// Spin instead
+		}
+
+		waiter.m_next = m_firstWaiter;
+		m_firstWaiter = &waiter;
+		m_numBlockedWaiters.fetch_add(1);
+		m_mutex->Unlock();
+
+		// Anything queued or finished after these checks sees the waiter and signals it.  Events are reused, so
+		// the wake-up may be stale, but the caller checks again anyway.
+		if (!job->m_isFinished.load() && m_numQueued.load() == 0)
+			waiter.m_event->Wait();
+
+		m_mutex->Lock();
+
+		JobWaiter **waiterLink = &m_firstWaiter;
+		while (*waiterLink != &waiter)
+			waiterLink = &(*waiterLink)->m_next;
+		*waiterLink = waiter.m_next;
+
+		m_numBlockedWaiters.fetch_sub(1);
+		ReleaseWaitEventLocked(waiter.m_event);
+
+		m_mutex->Unlock();
+	}
+
+	IGpThreadEvent *JobSystemImpl::AcquireWaitEventLocked()
+	{
+		if (m_numFreeWaitEvents > 0)
+			return m_freeWaitEvents[--m_numFreeWaitEvents];
+
+		return PLDrivers::GetSystemServices()->CreateThreadEvent(true, false);
+	}
+
+	void JobSystemImpl::ReleaseWaitEventLocked(IGpThreadEvent *evt)
+	{
+		const size_t kMaxFreeWaitEvents = sizeof(m_freeWaitEvents) / sizeof(m_freeWaitEvents[0]);
+
+		if (m_numFreeWaitEvents < kMaxFreeWaitEvents)
+			m_freeWaitEvents[m_numFreeWaitEvents++] = evt;
+		else
+			evt->Destroy();
+	}
+
+	JobDependentLink JobSystemImpl::ms_closedLink;
+	JobSystemImpl JobSystemImpl::ms_instance;
+
+	JobSystem *JobSystem::GetInstance()
+	{
+		return JobSystemImpl::GetInstance();
+	}
+}
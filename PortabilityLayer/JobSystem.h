@@ -0,0 +1,48 @@
+#pragma once
+#ifndef __PL_JOB_SYSTEM_H__
+#define __PL_JOB_SYSTEM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	struct Job;
+
+	// Runs short jobs on one worker thread per core, less one for the main thread.  Each worker has its own
+	// deque: jobs submitted from a worker go on that worker's deque and run newest-first, and idle workers steal
+	// the oldest jobs from the other deques.  Jobs submitted from any other thread go on a shared deque.
+	//
+	// All functions may be called from any thread, including from inside a job.
+	class JobSystem
+	{
+	public:
+		typedef void(*JobFunc_t)(void *context);
+		typedef void(*ParallelForFunc_t)(void *context, size_t startIndex, size_t endIndex);
+
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		// Number of threads that run jobs, not counting threads that help out while waiting
+		virtual unsigned int GetNumWorkers() const = 0;
+
+		// Schedules a job to run once all of its dependencies have finished.  Null dependencies are ignored.  The
+		// returned job must be released with ReleaseJob.  If the job can't be allocated, it's run before
+		// returning, and null is returned.
+		virtual Job *SubmitJob(JobFunc_t func, void *context, Job *const *dependencies = nullptr, size_t numDependencies = 0) = 0;
+		virtual void ReleaseJob(Job *job) = 0;
+
+		virtual bool IsJobFinished(const Job *job) const = 0;
+
+		// Runs other jobs until the job has finished, then blocks if there's nothing left to run
+		virtual void WaitForJob(Job *job) = 0;
+
+		// Calls func over [0, count) split into ranges of at least minRangeSize, on the calling thread and the
+		// workers.  Returns once every range has been run.
+		virtual void ParallelFor(ParallelForFunc_t func, void *context, size_t count, size_t minRangeSize) = 0;
+
+		static JobSystem *GetInstance();
+	};
+}
+
+#endif
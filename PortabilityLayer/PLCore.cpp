@@ -22,6 +22,7 @@
 #include "IGpSystemServices.h"
 #include "IGpThreadRelay.h"
 #include "InputManager.h"
+#include "JobSystem.h"
 #include "ResourceManager.h"
 #include "MacFileInfo.h"
 #include "MacRomanConversion.h"
@@ -643,6 +644,7 @@ void PL_Init()
 {
 	PortabilityLayer::FontManager::GetInstance()->Init();
 	PortabilityLayer::MemoryManager::GetInstance()->Init();
+	PortabilityLayer::JobSystem::GetInstance()->Init();
 	PortabilityLayer::ResourceManager::GetInstance()->Init();
 	PortabilityLayer::DisplayDeviceManager::GetInstance()->Init();
 	PortabilityLayer::QDManager::GetInstance()->Init();
@@ -652,6 +654,14 @@ void PL_Init()
 	PLDrivers::GetFileSystem()->SetDelayCallback(PLSysCalls::Sleep);
 }
 
+// Closes the application resources and stops the background threads started by PL_Init.  Nothing may be queued on
+// them when this is called.
+void PL_Shutdown()
+{
+	PortabilityLayer::ResourceManager::GetInstance()->Shutdown();
+	PortabilityLayer::JobSystem::GetInstance()->Shutdown();
+}
+
 WindowPtr PL_GetPutInFrontWindowPtr()
 {
 	return PortabilityLayer::WindowManager::GetInstance()->GetPutInFrontSentinel();
@@ -276,5 +276,6 @@ void PL_NotYetImplemented();
 void PL_NotYetImplemented_Minor();
 void PL_NotYetImplemented_TODO(const char *category);
 void PL_Init();
+void PL_Shutdown();
 
 void PL_CopyStringToClipboard(const uint8_t *chars, size_t length);
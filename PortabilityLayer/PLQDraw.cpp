@@ -493,6 +493,93 @@ static void RedistributeError(int16_t *errorDiffusionNextRow, int16_t *errorDiff
 	}
 }
 
+// Copies pre-baked pixels for an untruncated, unscaled draw.  Returns false if the picture needs to be converted.
+static bool DrawPrebakedPicture(const BitmapImage *bmpPtr, size_t handleSize, PortabilityLayer::PixMapImpl *pixMap, const Rect &bounds, bool errorDiffusion)
+{
+	const PortabilityLayer::PrebakedBitmapHeader *prebakedHeader = bmpPtr->GetPrebakedHeader(handleSize);
+	if (!prebakedHeader)
+		return false;
+
+	const uint32_t flags = prebakedHeader->m_flags;
+	const uint32_t width = prebakedHeader->m_width;
+	const uint32_t height = prebakedHeader->m_height;
+	const size_t offset8 = prebakedHeader->m_offset8;
+	const size_t pitch8 = prebakedHeader->m_pitch8;
+
+	const uint8_t *bmpBytes = reinterpret_cast<const uint8_t*>(bmpPtr);
+
+	const Rect targetPixMapRect = pixMap->m_rect;
+	const size_t destPitch = pixMap->GetPitch();
+	uint8_t *firstDestRow = static_cast<uint8_t*>(pixMap->GetPixelData()) + destPitch * static_cast<uint32_t>(bounds.top - targetPixMapRect.top);
+	const size_t firstDestCol = static_cast<uint32_t>(bounds.left - targetPixMapRect.left);
+
+	switch (pixMap->GetPixelFormat())
+	{
+	case GpPixelFormats::k8BitStandard:
+		{
+			if (!(flags & PortabilityLayer::PrebakedBitmapHeader::kFlag8BitStandard))
+				return false;
+
+			if ((flags & PortabilityLayer::PrebakedBitmapHeader::kFlag8BitDithered) && !errorDiffusion)
+				return false;
+
+			const uint8_t *sourceRow = bmpBytes + offset8;
+			uint8_t *destRow = firstDestRow + firstDestCol;
+
+			for (uint32_t row = 0; row < height; row++)
+			{
+				memcpy(destRow, sourceRow, width);
+				sourceRow += pitch8;
+				destRow += destPitch;
+			}
+		}
+		return true;
+	case GpPixelFormats::kRGB32:
+		{
+			if (!(flags & PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32))
+				return false;
+
+			uint8_t *destRow = firstDestRow + firstDestCol * 4;
+
+			if (flags & PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32FromPalette)
+			{
+				const PortabilityLayer::RGBAColor *stdColors = PortabilityLayer::StandardPalette::GetInstance()->GetColors();
+
+				uint32_t unpackedColors[256];
+				for (size_t i = 0; i < 256; i++)
+					unpackedColors[i] = stdColors[i].AsUInt32();
+
+				const uint8_t *sourceRow = bmpBytes + offset8;
+
+				for (uint32_t row = 0; row < height; row++)
+				{
+					uint32_t *destRow32 = reinterpret_cast<uint32_t*>(destRow);
+					for (uint32_t col = 0; col < width; col++)
+						destRow32[col] = unpackedColors[sourceRow[col]];
+
+					sourceRow += pitch8;
+					destRow += destPitch;
+				}
+			}
+			else
+			{
+				const size_t pitch32 = prebakedHeader->m_pitch32;
+				const uint8_t *sourceRow = bmpBytes + static_cast<size_t>(prebakedHeader->m_offset32);
+
+				for (uint32_t row = 0; row < height; row++)
+				{
+					memcpy(destRow, sourceRow, width * 4);
+					sourceRow += pitch32;
+					destRow += destPitch;
+				}
+			}
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
 void DrawSurface::DrawPicture(THandle<BitmapImage> pictHdl, const Rect &bounds, bool errorDiffusion)
 {
 	if (!pictHdl)
@@ -559,6 +646,15 @@ void DrawSurface::DrawPicture(THandle<BitmapImage> pictHdl, const Rect &bounds,
 	const int32_t truncatedLeft = std::max<int32_t>(0, targetPixMapRect.left - bounds.left);
 	const int32_t truncatedRight = std::max<int32_t>(0, bounds.right - targetPixMapRect.right);
 
+	if (truncatedTop == 0 && truncatedBottom == 0 && truncatedLeft == 0 && truncatedRight == 0)
+	{
+		if (DrawPrebakedPicture(bmpPtr, static_cast<size_t>(handleSize), pixMap, bounds, errorDiffusion))
+		{
+			m_port.SetDirty(PortabilityLayer::QDPortDirtyFlag_Contents);
+			return;
+		}
+	}
+
 	uint8_t paletteMapping[256];
 	for (int i = 0; i < 256; i++)
 		paletteMapping[i] = 0;
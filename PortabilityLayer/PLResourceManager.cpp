@@ -2,6 +2,7 @@
 
 #include "BinarySearch.h"
 #include "BMPFormat.h"
+#include "DeflateCodec.h"
 #include "FileManager.h"
 #include "GPArchive.h"
 #include "IGpDirectoryCursor.h"
@@ -12,8 +13,10 @@
 #include "MemReaderStream.h"
 #include "MemoryManager.h"
 #include "MMHandleBlock.h"
+#include "ResourceCache.h"
 #include "ResourceCompiledTypeList.h"
 #include "ResourceFile.h"
+#include "ResourceLoadBatch.h"
 #include "VirtualDirectory.h"
 #include "WaveFormat.h"
 #include "ZipFileProxy.h"
@@ -95,6 +98,189 @@ namespace
 
 		return false;
 	}
+
+	// Parses a resource ID in the same form IndexResource formats it, so there is exactly one name per ID
+	static bool ParseResourceID(const char *idChars, size_t idCharsRemaining, int16_t &outID)
+	{
+		bool isNegative = false;
+
+		if (idChars[0] == '-')
+		{
+			isNegative = true;
+			idCharsRemaining--;
+			idChars++;
+		}
+
+		if (idCharsRemaining == 0)
+			return false;
+
+		if (idChars[0] == '0' && (idCharsRemaining > 1 || isNegative))
+			return false;
+
+		int32_t resID = 0;
+		while (idCharsRemaining)
+		{
+			const char idChar = *idChars;
+
+			if (idChar < '0' || idChar > '9')
+				return false;
+
+			resID = resID * 10;
+			if (isNegative)
+			{
+				resID -= (idChar - '0');
+				if (resID < -32768)
+					return false;
+			}
+			else
+			{
+				resID += (idChar - '0');
+				if (resID > 32767)
+					return false;
+			}
+
+			idChars++;
+			idCharsRemaining--;
+		}
+
+		outID = static_cast<int16_t>(resID);
+		return true;
+	}
+
+	// Parses a "type/id.ext" path, accepting only names that IndexResource could have produced
+	static bool ParseResourcePath(const char *path, size_t length, PortabilityLayer::ResTypeID &outResType, int16_t &outID)
+	{
+		const char *slash = static_cast<const char*>(memchr(path, '/', length));
+		if (!slash)
+			return false;
+
+		const size_t tagLength = static_cast<size_t>(slash - path);
+
+		PortabilityLayer::GpArcResourceTypeTag tag;
+		if (tagLength >= sizeof(tag.m_id))
+			return false;
+
+		memcpy(tag.m_id, path, tagLength);
+		tag.m_id[tagLength] = '\0';
+
+		PortabilityLayer::ResTypeID resType;
+		if (!tag.Decode(resType) || strcmp(PortabilityLayer::GpArcResourceTypeTag::Encode(resType).m_id, tag.m_id))
+			return false;
+
+		int validationRule = 0;
+		const char *extension = PortabilityLayer::ResourceArchiveBase::GetFileExtensionForResType(resType, validationRule);
+		const size_t extLength = strlen(extension);
+
+		const char *idChars = slash + 1;
+		const size_t idLength = length - tagLength - 1;
+
+		if (idLength <= extLength || memcmp(idChars + idLength - extLength, extension, extLength))
+			return false;
+
+		if (!ParseResourceID(idChars, idLength - extLength, outID))
+			return false;
+
+		outResType = resType;
+		return true;
+	}
+
+	static int TypedRefSortPredicate(const void *a, const void *b)
+	{
+		const PortabilityLayer::ResourceArchiveTypedRef *typedA = static_cast<const PortabilityLayer::ResourceArchiveTypedRef*>(a);
+		const PortabilityLayer::ResourceArchiveTypedRef *typedB = static_cast<const PortabilityLayer::ResourceArchiveTypedRef*>(b);
+
+		if (typedA->m_resType != typedB->m_resType)
+			return (typedA->m_resType < typedB->m_resType) ? -1 : 1;
+
+		if (typedA->m_resID != typedB->m_resID)
+			return (typedA->m_resID < typedB->m_resID) ? -1 : 1;
+
+		return 0;
+	}
+
+	// Parses every resource path in the archive.  typedRefs must have room for every file.
+	static void BuildTypedRefs(const PortabilityLayer::ZipFileProxy *zipFileProxy, PortabilityLayer::ResourceArchiveTypedRef *typedRefs, size_t &outNumTypedRefs)
+	{
+		const size_t numFiles = zipFileProxy->NumFiles();
+		size_t numTypedRefs = 0;
+
+		for (size_t i = 0; i < numFiles; i++)
+		{
+			const char *fileName = nullptr;
+			size_t fnLength = 0;
+			zipFileProxy->GetFileName(i, fileName, fnLength);
+
+			PortabilityLayer::ResTypeID resTypeID;
+			int16_t resID = 0;
+			if (!ParseResourcePath(fileName, fnLength, resTypeID, resID))
+				continue;
+
+			PortabilityLayer::ResourceArchiveTypedRef &typedRef = typedRefs[numTypedRefs++];
+			typedRef.m_resType = resTypeID.ExportAsInt32();
+			typedRef.m_resID = resID;
+			typedRef.m_fileIndex = i;
+		}
+
+		qsort(typedRefs, numTypedRefs, sizeof(PortabilityLayer::ResourceArchiveTypedRef), TypedRefSortPredicate);
+
+		outNumTypedRefs = numTypedRefs;
+	}
+
+	// Copies the typed refs out of the archive index, if there is one.  typedRefs must have room for every file.
+	static bool LoadIndexedTypedRefs(const PortabilityLayer::ZipFileProxy *zipFileProxy, PortabilityLayer::ResourceArchiveTypedRef *typedRefs, size_t &outNumTypedRefs)
+	{
+		const size_t numFiles = zipFileProxy->NumFiles();
+
+		size_t numIndexedRefs = 0;
+		const PortabilityLayer::GpArchiveIndexTypedRef *indexedRefs = zipFileProxy->GetIndexedResources(numIndexedRefs);
+		if (!indexedRefs || numIndexedRefs > numFiles)
+			return false;
+
+		bool isSorted = true;
+		for (size_t i = 0; i < numIndexedRefs; i++)
+		{
+			const PortabilityLayer::GpArchiveIndexTypedRef &indexedRef = indexedRefs[i];
+
+			const size_t fileIndex = indexedRef.m_fileIndex;
+			if (fileIndex >= numFiles)
+				return false;
+
+			PortabilityLayer::ResourceArchiveTypedRef &typedRef = typedRefs[i];
+			typedRef.m_resType = indexedRef.m_resType;
+			typedRef.m_resID = indexedRef.m_resID;
+			typedRef.m_fileIndex = fileIndex;
+
+			if (i > 0 && TypedRefSortPredicate(typedRefs + (i - 1), typedRefs + i) >= 0)
+				isSorted = false;
+		}
+
+		// Lookups are binary searches, so a bad order would only hide resources, but keep it correct anyway
+		if (!isSorted)
+			qsort(typedRefs, numIndexedRefs, sizeof(PortabilityLayer::ResourceArchiveTypedRef), TypedRefSortPredicate);
+
+		outNumTypedRefs = numIndexedRefs;
+		return true;
+	}
+
+	// Returns the index of the first ref that doesn't sort before the type and ID, or the ref count if there isn't one
+	static size_t FindFirstTypedRef(const PortabilityLayer::ResourceArchiveTypedRef *refs, size_t numRefs, int32_t resType, int16_t resID)
+	{
+		size_t first = 0;
+		size_t lastExclusive = numRefs;
+
+		while (first != lastExclusive)
+		{
+			const size_t mid = (first + lastExclusive) / 2;
+			const PortabilityLayer::ResourceArchiveTypedRef &ref = refs[mid];
+
+			if (ref.m_resType < resType || (ref.m_resType == resType && ref.m_resID < resID))
+				first = mid + 1;
+			else
+				lastExclusive = mid;
+		}
+
+		return first;
+	}
 }
 
 
@@ -140,6 +326,9 @@ namespace PortabilityLayer
 
 	void ResourceManagerImpl::Init()
 	{
+		ResourceCache::GetInstance()->Init();
+		ResourceLoadBatch::StartThreads();
+
 		m_appResFile = PortabilityLayer::FileManager::GetInstance()->OpenCompositeFile(VirtualDirectories::kApplicationData, PSTR("ApplicationResources"));
 		if (m_appResFile)
 			m_appResArchive = LoadResFile(m_appResFile);
@@ -147,6 +336,8 @@ namespace PortabilityLayer
 
 	void ResourceManagerImpl::Shutdown()
 	{
+		ResourceLoadBatch::StopThreads();
+
 		if (m_appResArchive)
 			m_appResArchive->Destroy();
 
@@ -154,13 +345,24 @@ namespace PortabilityLayer
 			m_appResFile->Close();
 
 		m_appResArchive = nullptr;
+
+		ResourceCache::GetInstance()->Shutdown();
 	}
 
 	void ResourceManagerImpl::DissociateHandle(MMHandleBlock *hdl) const
 	{
-		assert(hdl->m_rmSelfRef);
-		assert(hdl->m_rmSelfRef->m_handle == hdl);
-		hdl->m_rmSelfRef->m_handle = nullptr;
+		ResourceArchiveRef *ref = hdl->m_rmSelfRef;
+
+		assert(ref);
+		assert(ref->m_handle == hdl);
+
+		if (hdl->m_contents && ref->m_archive && ref->m_archive->CacheReleasedContents(ref, hdl->m_contents, hdl->m_size))
+		{
+			hdl->m_contents = nullptr;
+			hdl->m_size = 0;
+		}
+
+		ref->m_handle = nullptr;
 		hdl->m_rmSelfRef = nullptr;
 	}
 
@@ -273,6 +475,7 @@ namespace PortabilityLayer
 
 	ResourceArchiveRef::ResourceArchiveRef()
 		: m_handle(nullptr)
+		, m_archive(nullptr)
 		, m_size(0)
 		, m_resID(0)
 	{
@@ -297,154 +500,193 @@ namespace PortabilityLayer
 				new (refs + i) ResourceArchiveRef();
 		}
 
+		// Index every resource by type and ID up front so lookups and type scans don't go through paths
+		ResourceArchiveTypedRef *typedRefs = nullptr;
+		size_t numTypedRefs = 0;
+		if (numFiles > 0)
+		{
+			typedRefs = static_cast<ResourceArchiveTypedRef*>(mm->Alloc(sizeof(ResourceArchiveTypedRef) * numFiles));
+			if (!typedRefs)
+			{
+				mm->Release(refs);
+				return nullptr;
+			}
+
+			if (!LoadIndexedTypedRefs(zipFileProxy, typedRefs, numTypedRefs))
+				BuildTypedRefs(zipFileProxy, typedRefs, numTypedRefs);
+		}
+
 		void *storage = mm->Alloc(sizeof(ResourceArchiveZipFile));
 		if (!storage)
 		{
+			mm->Release(typedRefs);
 			mm->Release(refs);
 			return nullptr;
 		}
 
-		return new (storage) ResourceArchiveZipFile(zipFileProxy, proxyIsShared, stream, refs);
+		return new (storage) ResourceArchiveZipFile(zipFileProxy, proxyIsShared, stream, refs, typedRefs, numTypedRefs);
 	}
 
-	void ResourceArchiveZipFile::Destroy()
+	bool ResourceArchiveZipFile::WriteArchiveIndex(const ZipFileProxy *zipFileProxy, void *buffer, size_t bufferSize)
 	{
-		this->~ResourceArchiveZipFile();
-		PortabilityLayer::MemoryManager::GetInstance()->Release(this);
-	}
+		PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
 
-	THandle<void> ResourceArchiveZipFile::LoadResource(const ResTypeID &resTypeID, int id)
-	{
-		return GetResource(resTypeID, id, true);
-	}
+		const size_t numFiles = zipFileProxy->NumFiles();
 
-	bool ResourceArchiveZipFile::HasAnyResourcesOfType(const ResTypeID &resTypeID) const
-	{
-		char resPrefix[6];
-		resTypeID.ExportAsChars(resPrefix);
-		resPrefix[4] = '/';
-		resPrefix[5] = '\0';
+		size_t pathHashTableSize = 0;
+		const uint32_t *pathHashTable = zipFileProxy->GetPathHashTable(pathHashTableSize);
 
-		return m_zipFileProxy->HasPrefix(resPrefix);
-	}
+		ResourceArchiveTypedRef *typedRefs = nullptr;
+		size_t numTypedRefs = 0;
+		if (numFiles > 0)
+		{
+			typedRefs = static_cast<ResourceArchiveTypedRef*>(mm->Alloc(sizeof(ResourceArchiveTypedRef) * numFiles));
+			if (!typedRefs)
+				return false;
 
-	bool ResourceArchiveZipFile::FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const
-	{
-		char resPrefix[6];
-		resTypeID.ExportAsChars(resPrefix);
-		resPrefix[4] = '/';
-		resPrefix[5] = '\0';
+			BuildTypedRefs(zipFileProxy, typedRefs, numTypedRefs);
+		}
 
-		size_t firstFileIndex = 0;
-		if (!m_zipFileProxy->FindFirstWithPrefix(resPrefix, firstFileIndex))
+		const size_t indexSize = sizeof(GpArchiveIndexHeader) + (numFiles + pathHashTableSize) * sizeof(uint32_t) + numTypedRefs * sizeof(GpArchiveIndexTypedRef);
+		if (indexSize > bufferSize)
+		{
+			mm->Release(typedRefs);
 			return false;
+		}
 
-		const size_t numFiles = m_zipFileProxy->NumFiles();
+		uint8_t *bytes = static_cast<uint8_t*>(buffer);
+		memset(bytes, 0, bufferSize);
+
+		GpArchiveIndexHeader header;
+		header.m_signature = GpArchiveIndexHeader::kSignature;
+		header.m_numFiles = static_cast<uint32_t>(numFiles);
+		header.m_centralDirSize = static_cast<uint32_t>(zipFileProxy->GetCentralDirSize());
+		header.m_pathHashTableSize = static_cast<uint32_t>(pathHashTableSize);
+		header.m_numTypedRefs = static_cast<uint32_t>(numTypedRefs);
 
-		bool haveAny = false;
-		int16_t lowestID = 32767;
+		memcpy(bytes, &header, sizeof(header));
+		bytes += sizeof(header);
 
-		for (size_t fileIndex = firstFileIndex; fileIndex < numFiles; fileIndex++)
+		for (size_t i = 0; i < numFiles; i++)
 		{
-			const char *resName = nullptr;
-			size_t fnLength = 0;
-			m_zipFileProxy->GetFileName(fileIndex, resName, fnLength);
+			LEUInt32_t offset;
+			offset = static_cast<uint32_t>(zipFileProxy->GetCentralDirOffset(i));
+			memcpy(bytes, &offset, sizeof(offset));
+			bytes += sizeof(offset);
+		}
 
-			if (fnLength <= 5 || memcmp(resName, resPrefix, 5))
-				break;
+		for (size_t i = 0; i < pathHashTableSize; i++)
+		{
+			LEUInt32_t slot;
+			slot = pathHashTable[i];
+			memcpy(bytes, &slot, sizeof(slot));
+			bytes += sizeof(slot);
+		}
 
-			const char *idChars = resName + 5;
-			size_t idCharsRemaining = fnLength - 5;
+		for (size_t i = 0; i < numTypedRefs; i++)
+		{
+			GpArchiveIndexTypedRef indexedRef;
+			indexedRef.m_resType = typedRefs[i].m_resType;
+			indexedRef.m_resID = typedRefs[i].m_resID;
+			indexedRef.m_reserved = 0;
+			indexedRef.m_fileIndex = static_cast<uint32_t>(typedRefs[i].m_fileIndex);
+			memcpy(bytes, &indexedRef, sizeof(indexedRef));
+			bytes += sizeof(indexedRef);
+		}
 
-			const size_t extLength = strlen(kPICTExtension);
+		mm->Release(typedRefs);
 
-			if (idCharsRemaining <= extLength)
-				continue;
+		return true;
+	}
 
-			if (memcmp(idChars + idCharsRemaining - extLength, kPICTExtension, extLength))
-				continue;
+	void ResourceArchiveZipFile::Destroy()
+	{
+		this->~ResourceArchiveZipFile();
+		PortabilityLayer::MemoryManager::GetInstance()->Release(this);
+	}
 
-			idCharsRemaining -= extLength;
+	THandle<void> ResourceArchiveZipFile::LoadResource(const ResTypeID &resTypeID, int id)
+	{
+		return GetResource(resTypeID, id, true);
+	}
 
-			bool isNegative = false;
+	bool ResourceArchiveZipFile::PrefetchResource(const ResTypeID &resTypeID, int id)
+	{
+		int validationRule = 0;
+		size_t index = 0;
+		if (!IndexResource(resTypeID, id, index, validationRule))
+			return false;
 
-			if (idChars[0] == '-')
-			{
-				isNegative = true;
-				idCharsRemaining--;
-				idChars++;
-			}
+		ResourceCache *cache = ResourceCache::GetInstance();
+		if (cache->Contains(this, index))
+			return true;
 
-			if (idCharsRemaining == 0)
-				continue;
+		MemoryManager *mm = MemoryManager::GetInstance();
 
-			if (idChars[0] == '0' && (idCharsRemaining > 1 || isNegative))
-				continue;
+		const size_t size = m_zipFileProxy->GetFileSize(index);
+		if (size == 0)
+			return false;
 
-			int32_t resID = 0;
-			bool failedName = false;
-			while (idCharsRemaining)
-			{
-				const char idChar = *idChars;
+		void *contents = mm->Alloc(size);
+		if (!contents)
+			return false;
 
-				if (idChar < '0' || idChar > '9')
-				{
-					failedName = true;
-					break;
-				}
+		if (!m_zipFileProxy->LoadFile(index, contents) || (validationRule != ResourceValidationRules::kNone && !ValidateResource(contents, size, static_cast<ResourceValidationRule_t>(validationRule))))
+		{
+			mm->Release(contents);
+			return false;
+		}
 
-				resID = resID * 10;
-				if (isNegative)
-				{
-					resID -= (idChar - '0');
-					if (resID < -32768)
-					{
-						failedName = true;
-						break;
-					}
-				}
-				else
-				{
-					resID += (idChar - '0');
-					if (resID > 32767)
-					{
-						failedName = true;
-						break;
-					}
-				}
+		cache->Insert(this, index, contents, size);
 
-				idChars++;
-				idCharsRemaining--;
-			}
+		return true;
+	}
 
-			if (failedName)
-				continue;
+	GpIOStream *ResourceArchiveZipFile::OpenResourceStream(const ResTypeID &resTypeID, int id)
+	{
+		int validationRule = 0;
+		size_t index = 0;
+		if (!IndexResource(resTypeID, id, index, validationRule))
+			return nullptr;
 
-			if (haveAny == false || resID < lowestID)
-			{
-				lowestID = resID;
-				haveAny = true;
-			}
-		}
+		return m_zipFileProxy->OpenFile(index);
+	}
 
-		if (haveAny)
-			outID = static_cast<int16_t>(lowestID);
+	bool ResourceArchiveZipFile::HasAnyResourcesOfType(const ResTypeID &resTypeID) const
+	{
+		int16_t firstID = 0;
+		return FindFirstResourceOfType(resTypeID, firstID);
+	}
 
-		return haveAny;
+	bool ResourceArchiveZipFile::FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const
+	{
+		const int32_t resType = resTypeID.ExportAsInt32();
+
+		// IDs of a type are sorted, so the first one is the lowest
+		const size_t refIndex = FindFirstTypedRef(m_typedRefs, m_numTypedRefs, resType, -32768);
+		if (refIndex == m_numTypedRefs || m_typedRefs[refIndex].m_resType != resType)
+			return false;
+
+		outID = m_typedRefs[refIndex].m_resID;
+		return true;
 	}
 
 	bool ResourceArchiveZipFile::IndexResource(const ResTypeID &resTypeID, int id, size_t &outIndex, int &outValidationRule) const
 	{
-		const char *extension = GetFileExtensionForResType(resTypeID, outValidationRule);
+		GetFileExtensionForResType(resTypeID, outValidationRule);
 
-		char resourceFile[64];
+		if (id < -32768 || id > 32767)
+			return false;
 
-		GpArcResourceTypeTag resTag = GpArcResourceTypeTag::Encode(resTypeID);
+		const int32_t resType = resTypeID.ExportAsInt32();
+		const int16_t resID = static_cast<int16_t>(id);
 
-		snprintf(resourceFile, sizeof(resourceFile) - 1, "%s/%i%s", resTag.m_id, id, extension);
+		const size_t refIndex = FindFirstTypedRef(m_typedRefs, m_numTypedRefs, resType, resID);
+		if (refIndex == m_numTypedRefs || m_typedRefs[refIndex].m_resType != resType || m_typedRefs[refIndex].m_resID != resID)
+			return false;
 
-		size_t index = 0;
-		return m_zipFileProxy->IndexFile(resourceFile, outIndex);
+		outIndex = m_typedRefs[refIndex].m_fileIndex;
+		return true;
 	}
 
 	THandle<void> ResourceArchiveZipFile::GetResource(const ResTypeID &resTypeID, int id, bool load)
@@ -467,6 +709,7 @@ namespace PortabilityLayer
 
 			handle->m_rmSelfRef = ref;
 			ref->m_handle = handle;
+			ref->m_archive = this;
 			ref->m_resID = static_cast<int16_t>(id);
 			ref->m_size = m_zipFileProxy->GetFileSize(index);
 		}
@@ -475,29 +718,51 @@ namespace PortabilityLayer
 		{
 			if (ref->m_size > 0)
 			{
-				void *contents = MemoryManager::GetInstance()->Alloc(ref->m_size);
-				handle->m_contents = contents;
-				handle->m_size = ref->m_size;
-
-				if (!m_zipFileProxy->LoadFile(index, contents) || (validationRule != ResourceValidationRules::kNone && !ValidateResource(contents, ref->m_size, static_cast<ResourceValidationRule_t>(validationRule))))
+				// Prefetched and released resources are cached, and the handle takes them over rather than copying them
+				void *contents = nullptr;
+				if (!ResourceCache::GetInstance()->Take(this, index, ref->m_size, contents))
 				{
-					MemoryManager::GetInstance()->Release(contents);
-					handle->m_contents = nullptr;
-					handle->m_size = 0;
+					contents = MemoryManager::GetInstance()->Alloc(ref->m_size);
+					if (!contents)
+						return THandle<void>();
 
-					return THandle<void>();
+					if (!m_zipFileProxy->LoadFile(index, contents) || (validationRule != ResourceValidationRules::kNone && !ValidateResource(contents, ref->m_size, static_cast<ResourceValidationRule_t>(validationRule))))
+					{
+						MemoryManager::GetInstance()->Release(contents);
+						return THandle<void>();
+					}
 				}
+
+				handle->m_contents = contents;
+				handle->m_size = ref->m_size;
 			}
 		}
 
 		return THandle<void>(handle);
 	}
 
-	ResourceArchiveZipFile::ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles)
+	bool ResourceArchiveZipFile::CacheReleasedContents(const ResourceArchiveRef *ref, void *contents, size_t size)
+	{
+		const size_t index = static_cast<size_t>(ref - m_resourceHandles);
+
+		if (size == 0 || size != ref->m_size)
+			return false;
+
+		// Resources can be modified while they're loaded, so only keep them if they're still what the archive has
+		if (DeflateContext::CRC32(0, contents, size) != m_zipFileProxy->GetFileCRC(index))
+			return false;
+
+		ResourceCache::GetInstance()->Insert(this, index, contents, size);
+		return true;
+	}
+
+	ResourceArchiveZipFile::ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles, ResourceArchiveTypedRef *typedRefs, size_t numTypedRefs)
 		: m_zipFileProxy(zipFileProxy)
 		, m_proxyIsShared(proxyIsShared)
 		, m_stream(stream)
 		, m_resourceHandles(resourceHandles)
+		, m_typedRefs(typedRefs)
+		, m_numTypedRefs(numTypedRefs)
 	{
 	}
 
@@ -510,12 +775,19 @@ namespace PortabilityLayer
 		{
 			ResourceArchiveRef &ref = m_resourceHandles[numFiles - 1 - i];
 			if (ref.m_handle)
+			{
+				// Not worth caching, since the archive's cache entries are about to be purged
+				ref.m_archive = nullptr;
 				mm->ReleaseHandle(ref.m_handle);
+			}
 
 			ref.~ResourceArchiveRef();
 		}
 
 		mm->Release(m_resourceHandles);
+		mm->Release(m_typedRefs);
+
+		ResourceCache::GetInstance()->PurgeOwner(this);
 
 		if (!m_proxyIsShared)
 			m_zipFileProxy->Destroy();
@@ -3,6 +3,7 @@
 #include "MemoryManager.h"
 #include "IGpMutex.h"
 #include "IGpThreadEvent.h"
+#include "IGpAudioBuffer.h"
 #include "IGpAudioChannel.h"
 #include "IGpAudioChannelCallbacks.h"
 #include "IGpAudioDriver.h"
@@ -31,11 +32,13 @@ namespace PortabilityLayer
 		union AudioCommandParam
 		{
 			const void *m_ptr;
+			IGpAudioBuffer *m_buffer;
 			AudioChannelCallback_t m_callback;
 		};
 
 		AudioCommandType_t m_commandType;
 		AudioCommandParam m_param;
+		size_t m_bufferStartOffset;
 	};
 
 	class AudioChannelImpl final : public AudioChannel, public IGpAudioChannelCallbacks
@@ -45,8 +48,10 @@ namespace PortabilityLayer
 		~AudioChannelImpl();
 
 		void Destroy(bool wait) override;
-		bool AddBuffer(const void *lengthTaggedBuffer, bool blocking) override;
+		bool AddBuffer(IGpAudioBuffer *buffer, bool blocking) override;
+		bool AddBufferFrom(IGpAudioBuffer *buffer, size_t startOffset, bool blocking) override;
 		bool AddCallback(AudioChannelCallback_t callback, bool blocking) override;
+		void SetPan(int32_t pan, int32_t maxPan) override;
 		void ClearAllCommands() override;
 		void Stop() override;
 
@@ -70,7 +75,8 @@ namespace PortabilityLayer
 		static const unsigned int kMaxQueuedCommands = 64;
 
 		void DigestQueueItems();
-		void DigestBufferCommand(const void *dataPointer);
+		void DigestBufferCommand(IGpAudioBuffer *buffer, size_t startOffset);
+		void ReleaseQueuedBuffers();
 
 		IGpAudioChannel *m_audioChannel;
 
@@ -167,13 +173,27 @@ namespace PortabilityLayer
 		PortabilityLayer::MemoryManager::GetInstance()->Release(this);
 	}
 
-	bool AudioChannelImpl::AddBuffer(const void *lengthTaggedBuffer, bool blocking)
+	bool AudioChannelImpl::AddBuffer(IGpAudioBuffer *buffer, bool blocking)
+	{
+		return this->AddBufferFrom(buffer, 0, blocking);
+	}
+
+	bool AudioChannelImpl::AddBufferFrom(IGpAudioBuffer *buffer, size_t startOffset, bool blocking)
 	{
 		AudioCommand cmd;
 		cmd.m_commandType = AudioCommandTypes::kBuffer;
-		cmd.m_param.m_ptr = lengthTaggedBuffer;
+		cmd.m_param.m_buffer = buffer;
+		cmd.m_bufferStartOffset = startOffset;
 
-		return this->PushCommand(cmd, blocking);
+		// The queue holds a reference until the buffer is posted or the queue is cleared
+		buffer->AddRef();
+		if (!this->PushCommand(cmd, blocking))
+		{
+			buffer->Release();
+			return false;
+		}
+
+		return true;
 	}
 
 	bool AudioChannelImpl::AddCallback(AudioChannelCallback_t callback, bool blocking)
@@ -181,6 +201,7 @@ namespace PortabilityLayer
 		AudioCommand cmd;
 		cmd.m_commandType = AudioCommandTypes::kCallback;
 		cmd.m_param.m_ptr = reinterpret_cast<void*>(callback);
+		cmd.m_bufferStartOffset = 0;
 
 		return this->PushCommand(cmd, blocking);
 	}
@@ -200,7 +221,7 @@ namespace PortabilityLayer
 			switch (command.m_commandType)
 			{
 			case AudioCommandTypes::kBuffer:
-				DigestBufferCommand(command.m_param.m_ptr);
+				DigestBufferCommand(command.m_param.m_buffer, command.m_bufferStartOffset);
 				assert(m_state == State_PlayingAsync);
 				m_mutex->Unlock();
 				return;
@@ -222,18 +243,25 @@ namespace PortabilityLayer
 		m_mutex->Unlock();
 	}
 
-	void AudioChannelImpl::DigestBufferCommand(const void *dataPointer)
+	void AudioChannelImpl::DigestBufferCommand(IGpAudioBuffer *buffer, size_t startOffset)
 	{
 		assert(m_state == State_Idle);
 
-		// At this point, the buffer should already be validated and converted, and the data pointer should point at the data tag
-		uint32_t length;
-		memcpy(&length, dataPointer, 4);
-
-		m_audioChannel->PostBuffer(static_cast<const uint8_t*>(dataPointer) + 4, length);
+		m_audioChannel->PostBuffer(buffer, startOffset);
+		buffer->Release();
 		m_state = State_PlayingAsync;
 	}
 
+	void AudioChannelImpl::ReleaseQueuedBuffers()
+	{
+		for (size_t i = 0; i < m_numQueuedCommands; i++)
+		{
+			const AudioCommand &command = m_commandQueue[(m_nextDequeueCommandPos + i) % static_cast<size_t>(kMaxQueuedCommands)];
+			if (command.m_commandType == AudioCommandTypes::kBuffer)
+				command.m_param.m_buffer->Release();
+		}
+	}
+
 	bool AudioChannelImpl::PushCommand(const AudioCommand &command, bool blocking)
 	{
 		bool digestOnThisThread = false;
@@ -284,12 +312,19 @@ namespace PortabilityLayer
 	void AudioChannelImpl::ClearAllCommands()
 	{
 		m_mutex->Lock();
+		ReleaseQueuedBuffers();
 		m_numQueuedCommands = 0;
 		m_nextDequeueCommandPos = 0;
 		m_nextInsertCommandPos = 0;
 		m_mutex->Unlock();
 	}
 
+	void AudioChannelImpl::SetPan(int32_t pan, int32_t maxPan)
+	{
+		// Takes effect immediately rather than being queued, so set it before adding the buffers it applies to
+		m_audioChannel->SetPan(pan, maxPan);
+	}
+
 	void AudioChannelImpl::Stop()
 	{
 		m_mutex->Lock();
@@ -338,6 +373,7 @@ namespace PortabilityLayer
 	{
 	public:
 		AudioChannel *CreateChannel() override;
+		IGpAudioBuffer *CreateBuffer(const void *lengthTaggedBuffer) override;
 
 		void SetVolume(uint8_t vol) override;
 		uint8_t GetVolume() const override;
@@ -390,6 +426,19 @@ namespace PortabilityLayer
 		return new (storage) PortabilityLayer::AudioChannelImpl(audioChannel, threadEvent, mutex);
 	}
 
+	IGpAudioBuffer *SoundSystemImpl::CreateBuffer(const void *lengthTaggedBuffer)
+	{
+		IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver();
+		if (!audioDriver)
+			return nullptr;
+
+		// The buffer should already be validated and converted, and point at the data tag
+		uint32_t length;
+		memcpy(&length, lengthTaggedBuffer, 4);
+
+		return audioDriver->CreateBuffer(static_cast<const uint8_t*>(lengthTaggedBuffer) + 4, length);
+	}
+
 	void SoundSystemImpl::SetVolume(uint8_t vol)
 	{
 		IGpAudioDriver *audioDriver = PLDrivers::GetAudioDriver();
@@ -2,6 +2,8 @@
 
 #include "PLCore.h"
 
+struct IGpAudioBuffer;
+
 namespace PortabilityLayer
 {
 	struct AudioChannel;
@@ -11,8 +13,10 @@ namespace PortabilityLayer
 	struct AudioChannel
 	{
 		virtual void Destroy(bool wait) = 0;
-		virtual bool AddBuffer(const void *lengthTaggedBuffer, bool blocking) = 0;
+		virtual bool AddBuffer(IGpAudioBuffer *buffer, bool blocking) = 0;
+		virtual bool AddBufferFrom(IGpAudioBuffer *buffer, size_t startOffset, bool blocking) = 0;	// Starts startOffset bytes into the buffer
 		virtual bool AddCallback(AudioChannelCallback_t callback, bool blocking) = 0;
+		virtual void SetPan(int32_t pan, int32_t maxPan) = 0;
 		virtual void ClearAllCommands() = 0;
 		virtual void Stop() = 0;
 	};
@@ -21,6 +25,7 @@ namespace PortabilityLayer
 	{
 	public:
 		virtual AudioChannel *CreateChannel() = 0;
+		virtual IGpAudioBuffer *CreateBuffer(const void *lengthTaggedBuffer) = 0;
 
 		virtual void SetVolume(uint8_t vol) = 0;
 		virtual uint8_t GetVolume() const = 0;
@@ -0,0 +1,328 @@
+#include "ResourceCache.h"
+
+#include "IGpLogDriver.h"
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
+#include "MemoryManager.h"
+
+#include "PLDrivers.h"
+
+// Default number of bytes of decompressed resources to keep.  Low-memory builds can define this lower, or the
+// budget can be changed at runtime with SetBudget.
+#ifndef PL_RESOURCE_CACHE_BUDGET
+#define PL_RESOURCE_CACHE_BUDGET (16 * 1024 * 1024)
+#endif
+
+namespace PortabilityLayer
+{
+	class ResourceCacheImpl final : public ResourceCache
+	{
+	public:
+		ResourceCacheImpl();
+
+		void Init() override;
+		void Shutdown() override;
+
+		void SetBudget(size_t budgetBytes) override;
+		void GetStats(ResourceCacheStats &outStats) const override;
+
+		bool Take(const void *owner, size_t index, size_t size, void *&outContents) override;
+		bool Contains(const void *owner, size_t index) const override;
+
+		void Insert(const void *owner, size_t index, void *contents, size_t size) override;
+
+		void PurgeOwner(const void *owner) override;
+
+		static ResourceCacheImpl *GetInstance();
+
+	private:
+		static const size_t kNumBuckets = 256;
+
+		struct Entry
+		{
+			const void *m_owner;
+			size_t m_index;
+			void *m_contents;
+			size_t m_size;
+
+			Entry *m_nextInBucket;
+			Entry *m_moreRecent;
+			Entry *m_lessRecent;
+		};
+
+		static size_t BucketForKey(const void *owner, size_t index);
+
+		Entry *FindEntryLocked(const void *owner, size_t index) const;
+		void LinkMostRecentLocked(Entry *entry);
+		void UnlinkLocked(Entry *entry);
+		void *DetachLocked(Entry *entry);
+		void RemoveLocked(Entry *entry);
+		void EvictToBudgetLocked(size_t budget);
+
+		IGpMutex *m_mutex;	// Null if no system services are available, in which case nothing is cached
+
+		Entry *m_buckets[kNumBuckets];
+		Entry *m_mostRecent;
+		Entry *m_leastRecent;
+
+		size_t m_budget;
+		size_t m_bytesHeld;
+		uint64_t m_hits;
+		uint64_t m_misses;
+		uint64_t m_evictions;
+
+		static ResourceCacheImpl ms_instance;
+	};
+
+	ResourceCacheImpl::ResourceCacheImpl()
+		: m_mutex(nullptr)
+		, m_mostRecent(nullptr)
+		, m_leastRecent(nullptr)
+		, m_budget(PL_RESOURCE_CACHE_BUDGET)
+		, m_bytesHeld(0)
+		, m_hits(0)
+		, m_misses(0)
+		, m_evictions(0)
+	{
+		for (size_t i = 0; i < kNumBuckets; i++)
+			m_buckets[i] = nullptr;
+	}
+
+	void ResourceCacheImpl::Init()
+	{
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+		if (sysServices)
+			m_mutex = sysServices->CreateMutex();
+	}
+
+	void ResourceCacheImpl::Shutdown()
+	{
+		IGpLogDriver *logger = PLDrivers::GetLogDriver();
+
+		if (logger)
+			logger->Printf(IGpLogDriver::Category_Information, "ResourceCache: %llu hits, %llu misses, %llu evictions, %llu bytes held of %llu", static_cast<unsigned long long>(m_hits), static_cast<unsigned long long>(m_misses), static_cast<unsigned long long>(m_evictions), static_cast<unsigned long long>(m_bytesHeld), static_cast<unsigned long long>(m_budget));
+
+		// Everything should have been purged with its archive by now, but don't leak if it wasn't
+		while (m_leastRecent)
+			RemoveLocked(m_leastRecent);
+
+		if (m_mutex)
+		{
+			m_mutex->Destroy();
+			m_mutex = nullptr;
+		}
+	}
+
+	void ResourceCacheImpl::SetBudget(size_t budgetBytes)
+	{
+		if (!m_mutex)
+		{
+			m_budget = budgetBytes;
+			return;
+		}
+
+		m_mutex->Lock();
+		m_budget = budgetBytes;
+		EvictToBudgetLocked(budgetBytes);
+		m_mutex->Unlock();
+	}
+
+	void ResourceCacheImpl::GetStats(ResourceCacheStats &outStats) const
+	{
+		if (m_mutex)
+			m_mutex->Lock();
+
+		outStats.m_hits = m_hits;
+		outStats.m_misses = m_misses;
+		outStats.m_evictions = m_evictions;
+		outStats.m_bytesHeld = m_bytesHeld;
+		outStats.m_budget = m_budget;
+
+		if (m_mutex)
+			m_mutex->Unlock();
+	}
+
+	bool ResourceCacheImpl::Take(const void *owner, size_t index, size_t size, void *&outContents)
+	{
+		if (!m_mutex)
+			return false;
+
+		m_mutex->Lock();
+
+		Entry *entry = FindEntryLocked(owner, index);
+		if (!entry || entry->m_size != size)
+		{
+			m_misses++;
+			m_mutex->Unlock();
+			return false;
+		}
+
+		m_hits++;
+		outContents = DetachLocked(entry);
+
+		m_mutex->Unlock();
+
+		return true;
+	}
+
+	bool ResourceCacheImpl::Contains(const void *owner, size_t index) const
+	{
+		if (!m_mutex)
+			return false;
+
+		m_mutex->Lock();
+		const bool found = (FindEntryLocked(owner, index) != nullptr);
+		m_mutex->Unlock();
+
+		return found;
+	}
+
+	void ResourceCacheImpl::Insert(const void *owner, size_t index, void *contents, size_t size)
+	{
+		MemoryManager *mm = MemoryManager::GetInstance();
+
+		if (!m_mutex)
+		{
+			mm->Release(contents);
+			return;
+		}
+
+		Entry *entry = static_cast<Entry*>(mm->Alloc(sizeof(Entry)));
+
+		m_mutex->Lock();
+
+		// Another thread may have loaded the same resource in the meantime
+		if (!entry || size > m_budget || FindEntryLocked(owner, index) != nullptr)
+		{
+			m_mutex->Unlock();
+
+			mm->Release(entry);
+			mm->Release(contents);
+			return;
+		}
+
+		entry->m_owner = owner;
+		entry->m_index = index;
+		entry->m_contents = contents;
+		entry->m_size = size;
+
+		const size_t bucket = BucketForKey(owner, index);
+		entry->m_nextInBucket = m_buckets[bucket];
+		m_buckets[bucket] = entry;
+
+		LinkMostRecentLocked(entry);
+		m_bytesHeld += size;
+
+		EvictToBudgetLocked(m_budget);
+
+		m_mutex->Unlock();
+	}
+
+	void ResourceCacheImpl::PurgeOwner(const void *owner)
+	{
+		if (!m_mutex)
+			return;
+
+		m_mutex->Lock();
+
+		Entry *entry = m_leastRecent;
+		while (entry)
+		{
+			Entry *moreRecent = entry->m_moreRecent;
+
+			if (entry->m_owner == owner)
+				RemoveLocked(entry);
+
+			entry = moreRecent;
+		}
+
+		m_mutex->Unlock();
+	}
+
+	size_t ResourceCacheImpl::BucketForKey(const void *owner, size_t index)
+	{
+		const uint64_t key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(owner)) ^ (static_cast<uint64_t>(index) * 0x9e3779b97f4a7c15ULL);
+
+		return static_cast<size_t>((key ^ (key >> 29)) & (kNumBuckets - 1));
+	}
+
+	ResourceCacheImpl::Entry *ResourceCacheImpl::FindEntryLocked(const void *owner, size_t index) const
+	{
+		for (Entry *entry = m_buckets[BucketForKey(owner, index)]; entry; entry = entry->m_nextInBucket)
+		{
+			if (entry->m_owner == owner && entry->m_index == index)
+				return entry;
+		}
+
+		return nullptr;
+	}
+
+	void ResourceCacheImpl::LinkMostRecentLocked(Entry *entry)
+	{
+		entry->m_moreRecent = nullptr;
+		entry->m_lessRecent = m_mostRecent;
+
+		if (m_mostRecent)
+			m_mostRecent->m_moreRecent = entry;
+		else
+			m_leastRecent = entry;
+
+		m_mostRecent = entry;
+	}
+
+	void ResourceCacheImpl::UnlinkLocked(Entry *entry)
+	{
+		if (entry->m_moreRecent)
+			entry->m_moreRecent->m_lessRecent = entry->m_lessRecent;
+		else
+			m_mostRecent = entry->m_lessRecent;
+
+		if (entry->m_lessRecent)
+			entry->m_lessRecent->m_moreRecent = entry->m_moreRecent;
+		else
+			m_leastRecent = entry->m_moreRecent;
+	}
+
+	void *ResourceCacheImpl::DetachLocked(Entry *entry)
+	{
+		Entry **bucketLink = &m_buckets[BucketForKey(entry->m_owner, entry->m_index)];
+		while (*bucketLink != entry)
+			bucketLink = &(*bucketLink)->m_nextInBucket;
+
+		*bucketLink = entry->m_nextInBucket;
+
+		UnlinkLocked(entry);
+		m_bytesHeld -= entry->m_size;
+
+		void *contents = entry->m_contents;
+		MemoryManager::GetInstance()->Release(entry);
+
+		return contents;
+	}
+
+	void ResourceCacheImpl::RemoveLocked(Entry *entry)
+	{
+		MemoryManager::GetInstance()->Release(DetachLocked(entry));
+	}
+
+	void ResourceCacheImpl::EvictToBudgetLocked(size_t budget)
+	{
+		while (m_leastRecent && m_bytesHeld > budget)
+		{
+			RemoveLocked(m_leastRecent);
+			m_evictions++;
+		}
+	}
+
+	ResourceCacheImpl *ResourceCacheImpl::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	ResourceCacheImpl ResourceCacheImpl::ms_instance;
+
+	ResourceCache *ResourceCache::GetInstance()
+	{
+		return ResourceCacheImpl::GetInstance();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef __PL_RESOURCE_CACHE_H__
+#define __PL_RESOURCE_CACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	struct ResourceCacheStats
+	{
+		uint64_t m_hits;
+		uint64_t m_misses;
+		uint64_t m_evictions;
+		size_t m_bytesHeld;
+		size_t m_budget;
+	};
+
+	// Global LRU of decompressed resource contents that were read ahead of being loaded, or whose handles were released,
+	// shared by all open archives.  Loaded resources are owned by their handles rather than the cache, so resources in
+	// use are never evicted or counted against the budget.  Entries are keyed by the archive that owns them and an
+	// archive-defined index.  All functions may be called from any thread.
+	class ResourceCache
+	{
+	public:
+		virtual void Init() = 0;
+		virtual void Shutdown() = 0;
+
+		// Evicts down to the new budget immediately.  A budget of 0 disables caching.
+		virtual void SetBudget(size_t budgetBytes) = 0;
+		virtual void GetStats(ResourceCacheStats &outStats) const = 0;
+
+		// Removes a resource from the cache and hands its contents over to the caller if it's cached with the same size,
+		// counting a hit or miss.  The contents were allocated with the MemoryManager.
+		virtual bool Take(const void *owner, size_t index, size_t size, void *&outContents) = 0;
+		virtual bool Contains(const void *owner, size_t index) const = 0;
+
+		// Takes ownership of contents allocated with the MemoryManager, releasing them if they aren't cached
+		virtual void Insert(const void *owner, size_t index, void *contents, size_t size) = 0;
+
+		virtual void PurgeOwner(const void *owner) = 0;
+
+		static ResourceCache *GetInstance();
+	};
+}
+
+#endif
@@ -0,0 +1,595 @@
+#include "ResourceLoadBatch.h"
+
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
+#include "IGpThreadEvent.h"
+#include "MemoryManager.h"
+#include "ResourceManager.h"
+
+#include "PLDrivers.h"
+
+#include <assert.h>
+#include <new>
+
+namespace PortabilityLayer
+{
+	class ResourceLoadBatchImpl;
+
+	// Threads shared by every batch.  Batches are queued in the order that they were created, and each thread takes
+	// the next unclaimed item of the oldest batch that still has one.
+	class ResourceLoadPool
+	{
+	public:
+		ResourceLoadPool();
+
+		void Start();
+		void Stop();
+
+		bool HasThreads() const;
+		IGpMutex *GetMutex() const;
+
+		void EnqueueLocked(ResourceLoadBatchImpl *batch);
+		void DequeueLocked(ResourceLoadBatchImpl *batch);
+		void SignalWork();
+
+		static ResourceLoadPool *GetInstance();
+
+	private:
+		static const unsigned int kMaxThreads = 4;
+
+		static int StaticThreadFuncThunk(void *context);
+		int ThreadFunc();
+
+		bool ClaimItemLocked(ResourceLoadBatchImpl *&outBatch, size_t &outIndex);
+
+		IGpMutex *m_mutex;
+		IGpThreadEvent *m_workSignal;			// Auto-reset, a thread that takes an item passes it on if there's more
+		IGpThreadEvent *m_threadExitedSignal;
+
+		ResourceLoadBatchImpl *m_firstQueued;
+		ResourceLoadBatchImpl *m_lastQueued;
+
+		unsigned int m_numThreadsRunning;
+		bool m_terminating;
+
+		static ResourceLoadPool ms_instance;
+	};
+
+	class ResourceLoadBatchImpl final : public ResourceLoadBatch
+	{
+	public:
+		ResourceLoadBatchImpl(ResourceLoadRequest *requests, uint8_t *itemStates, size_t *completionOrder, size_t numItems, IGpThreadEvent *completedSignal);
+
+		void Destroy() override;
+
+		size_t NumItems() const override;
+		bool IsItemComplete(size_t index) const override;
+		bool IsComplete() const override;
+
+		bool WaitForItem(size_t index) override;
+		bool WaitForNextItem(size_t &outIndex) override;
+
+		THandle<void> LoadItem(size_t index) override;
+
+		bool HasUnclaimedItemsLocked() const;
+		size_t ClaimItemLocked();
+		bool ReadItem(size_t index) const;
+		void CompleteItemLocked(size_t index, bool succeeded);
+
+		ResourceLoadBatchImpl *m_nextQueued;
+		bool m_isQueued;
+
+	private:
+		enum ItemState
+		{
+			kItemStatePending,
+			kItemStateReading,
+			kItemStateSucceeded,
+			kItemStateFailed,
+		};
+
+		~ResourceLoadBatchImpl() override;
+
+		void Lock() const;
+		void Unlock() const;
+		void WaitForCompletion();
+
+		ResourceLoadRequest *m_requests;
+		uint8_t *m_itemStates;
+		size_t *m_completionOrder;
+		size_t m_numItems;
+
+		size_t m_numClaimed;
+		size_t m_numCompleted;
+		size_t m_numReturned;
+
+		IGpThreadEvent *m_completedSignal;	// Null if there are no threads, in which case nothing is ever waited on
+	};
+
+	ResourceLoadPool::ResourceLoadPool()
+		: m_mutex(nullptr)
+		, m_workSignal(nullptr)
+		, m_threadExitedSignal(nullptr)
+		, m_firstQueued(nullptr)
+		, m_lastQueued(nullptr)
+		, m_numThreadsRunning(0)
+		, m_terminating(false)
+	{
+	}
+
+	void ResourceLoadPool::Start()
+	{
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+		if (!sysServices)
+			return;
+
+		// Leave a core for the game thread, which decodes what the loaders read
+		unsigned int numThreads = sysServices->GetCPUCount();
+		if (numThreads > 1)
+			numThreads--;
+		if (numThreads > kMaxThreads)
+			numThreads = kMaxThreads;
+
+		m_mutex = sysServices->CreateMutex();
+		m_workSignal = sysServices->CreateThreadEvent(true, false);
+		m_threadExitedSignal = sysServices->CreateThreadEvent(true, false);
+
+		if (!m_mutex || !m_workSignal || !m_threadExitedSignal)
+		{
+			Stop();
+			return;
+		}
+
+		m_terminating = false;
+
+		for (unsigned int i = 0; i < numThreads; i++)
+		{
+			m_mutex->Lock();
+			m_numThreadsRunning++;
+			m_mutex->Unlock();
+
+			if (!sysServices->CreateThread(ResourceLoadPool::StaticThreadFuncThunk, this))
+			{
+				m_mutex->Lock();
+				m_numThreadsRunning--;
+				m_mutex->Unlock();
+				break;
+			}
+		}
+	}
+
+	void ResourceLoadPool::Stop()
+	{
+		if (m_mutex)
+		{
+			m_mutex->Lock();
+			assert(m_firstQueued == nullptr);
+			m_terminating = true;
+			m_mutex->Unlock();
+
+			m_workSignal->Signal();
+
+			for (;;)
+			{
+				m_mutex->Lock();
+				const unsigned int numThreadsRunning = m_numThreadsRunning;
+				m_mutex->Unlock();
+
+				if (numThreadsRunning == 0)
+					break;
+
+				m_threadExitedSignal->Wait();
+			}
+		}
+
+		if (m_threadExitedSignal)
+			m_threadExitedSignal->Destroy();
+		if (m_workSignal)
+			m_workSignal->Destroy();
+		if (m_mutex)
+			m_mutex->Destroy();
+
+		m_threadExitedSignal = nullptr;
+		m_workSignal = nullptr;
+		m_mutex = nullptr;
+	}
+
+	bool ResourceLoadPool::HasThreads() const
+	{
+		if (!m_mutex)
+			return false;
+
+		m_mutex->Lock();
+		const bool hasThreads = (m_numThreadsRunning > 0);
+		m_mutex->Unlock();
+
+		return hasThreads;
+	}
+
+	IGpMutex *ResourceLoadPool::GetMutex() const
+	{
+		return m_mutex;
+	}
+
+	void ResourceLoadPool::EnqueueLocked(ResourceLoadBatchImpl *batch)
+	{
+		batch->m_nextQueued = nullptr;
+		batch->m_isQueued = true;
+
+		if (m_lastQueued)
+			m_lastQueued->m_nextQueued = batch;
+		else
+			m_firstQueued = batch;
+
+		m_lastQueued = batch;
+	}
+
+	void ResourceLoadPool::DequeueLocked(ResourceLoadBatchImpl *batch)
+	{
+		if (!batch->m_isQueued)
+			return;
+
+		ResourceLoadBatchImpl *prevBatch = nullptr;
+		for (ResourceLoadBatchImpl *queued = m_firstQueued; queued != batch; queued = queued->m_nextQueued)
+			prevBatch = queued;
+
+		if (prevBatch)
+			prevBatch->m_nextQueued = batch->m_nextQueued;
+		else
+			m_firstQueued = batch->m_nextQueued;
+
+		if (m_lastQueued == batch)
+			m_lastQueued = prevBatch;
+
+		batch->m_nextQueued = nullptr;
+		batch->m_isQueued = false;
+	}
+
+	void ResourceLoadPool::SignalWork()
+	{
+		m_workSignal->Signal();
+	}
+
+	bool ResourceLoadPool::ClaimItemLocked(ResourceLoadBatchImpl *&outBatch, size_t &outIndex)
+	{
+		ResourceLoadBatchImpl *batch = m_firstQueued;
+		if (!batch)
+			return false;
+
+		outBatch = batch;
+		outIndex = batch->ClaimItemLocked();
+
+		// Batches leave the queue once all of their items have been claimed
+		if (!batch->HasUnclaimedItemsLocked())
+			DequeueLocked(batch);
+
+		return true;
+	}
+
+	int ResourceLoadPool::StaticThreadFuncThunk(void *context)
+	{
+		return static_cast<ResourceLoadPool*>(context)->ThreadFunc();
+	}
+
+	int ResourceLoadPool::ThreadFunc()
+	{
+		for (;;)
+		{
+			m_workSignal->Wait();
+
+			for (;;)
+			{
+				m_mutex->Lock();
+
+				if (m_terminating)
+				{
+					// Pass the wake-up on so that every thread sees it
+					m_workSignal->Signal();
+
+					m_numThreadsRunning--;
+					m_threadExitedSignal->Signal();
+					m_mutex->Unlock();
+					return 0;
+				}
+
+				ResourceLoadBatchImpl *batch = nullptr;
+				size_t index = 0;
+				const bool claimedItem = ClaimItemLocked(batch, index);
+				const bool hasMoreWork = (m_firstQueued != nullptr);
+
+				m_mutex->Unlock();
+
+				if (!claimedItem)
+					break;
+
+				if (hasMoreWork)
+					m_workSignal->Signal();
+
+				const bool succeeded = batch->ReadItem(index);
+
+				m_mutex->Lock();
+				batch->CompleteItemLocked(index, succeeded);
+				m_mutex->Unlock();
+			}
+		}
+	}
+
+	ResourceLoadPool *ResourceLoadPool::GetInstance()
+	{
+		return &ms_instance;
+	}
+
+	ResourceLoadPool ResourceLoadPool::ms_instance;
+
+	ResourceLoadBatchImpl::ResourceLoadBatchImpl(ResourceLoadRequest *requests, uint8_t *itemStates, size_t *completionOrder, size_t numItems, IGpThreadEvent *completedSignal)
+		: m_nextQueued(nullptr)
+		, m_isQueued(false)
+		, m_requests(requests)
+		, m_itemStates(itemStates)
+		, m_completionOrder(completionOrder)
+		, m_numItems(numItems)
+		, m_numClaimed(0)
+		, m_numCompleted(0)
+		, m_numReturned(0)
+		, m_completedSignal(completedSignal)
+	{
+		for (size_t i = 0; i < numItems; i++)
+			m_itemStates[i] = kItemStatePending;
+	}
+
+	ResourceLoadBatchImpl::~ResourceLoadBatchImpl()
+	{
+		MemoryManager *mm = MemoryManager::GetInstance();
+
+		if (m_completedSignal)
+			m_completedSignal->Destroy();
+
+		for (size_t i = 0; i < m_numItems; i++)
+			m_requests[m_numItems - 1 - i].~ResourceLoadRequest();
+
+		mm->Release(m_completionOrder);
+		mm->Release(m_itemStates);
+		mm->Release(m_requests);
+	}
+
+	void ResourceLoadBatchImpl::Destroy()
+	{
+		// Drop whatever hasn't been claimed by a thread yet, then wait out the reads in progress
+		if (m_completedSignal)
+		{
+			Lock();
+			ResourceLoadPool::GetInstance()->DequeueLocked(this);
+			const size_t numClaimed = m_numClaimed;
+			m_numClaimed = m_numItems;
+			Unlock();
+
+			for (;;)
+			{
+				Lock();
+				const bool readsFinished = (m_numCompleted == numClaimed);
+				Unlock();
+
+				if (readsFinished)
+					break;
+
+				m_completedSignal->Wait();
+			}
+		}
+
+		this->~ResourceLoadBatchImpl();
+		MemoryManager::GetInstance()->Release(this);
+	}
+
+	size_t ResourceLoadBatchImpl::NumItems() const
+	{
+		return m_numItems;
+	}
+
+	bool ResourceLoadBatchImpl::IsItemComplete(size_t index) const
+	{
+		assert(index < m_numItems);
+
+		Lock();
+		const uint8_t itemState = m_itemStates[index];
+		Unlock();
+
+		return itemState == kItemStateSucceeded || itemState == kItemStateFailed;
+	}
+
+	bool ResourceLoadBatchImpl::IsComplete() const
+	{
+		Lock();
+		const bool isComplete = (m_numCompleted == m_numItems);
+		Unlock();
+
+		return isComplete;
+	}
+
+	bool ResourceLoadBatchImpl::WaitForItem(size_t index)
+	{
+		assert(index < m_numItems);
+
+		for (;;)
+		{
+			Lock();
+			const uint8_t itemState = m_itemStates[index];
+			Unlock();
+
+			if (itemState == kItemStateSucceeded)
+				return true;
+			if (itemState == kItemStateFailed)
+				return false;
+
+			WaitForCompletion();
+		}
+	}
+
+	bool ResourceLoadBatchImpl::WaitForNextItem(size_t &outIndex)
+	{
+		for (;;)
+		{
+			Lock();
+
+			if (m_numReturned == m_numItems)
+			{
+				Unlock();
+				return false;
+			}
+
+			if (m_numReturned < m_numCompleted)
+			{
+				outIndex = m_completionOrder[m_numReturned++];
+				Unlock();
+				return true;
+			}
+
+			Unlock();
+
+			WaitForCompletion();
+		}
+	}
+
+	THandle<void> ResourceLoadBatchImpl::LoadItem(size_t index)
+	{
+		WaitForItem(index);
+
+		const ResourceLoadRequest &request = m_requests[index];
+
+		THandle<void> hdl;
+		if (request.m_archive)
+			hdl = request.m_archive->LoadResource(request.m_resTypeID, request.m_resID);
+
+		if (hdl == nullptr && request.m_fallbackArchive)
+			hdl = request.m_fallbackArchive->LoadResource(request.m_resTypeID, request.m_resID);
+
+		return hdl;
+	}
+
+	bool ResourceLoadBatchImpl::HasUnclaimedItemsLocked() const
+	{
+		return m_numClaimed < m_numItems;
+	}
+
+	size_t ResourceLoadBatchImpl::ClaimItemLocked()
+	{
+		assert(m_numClaimed < m_numItems);
+
+		const size_t index = m_numClaimed++;
+		m_itemStates[index] = kItemStateReading;
+
+		return index;
+	}
+
+	bool ResourceLoadBatchImpl::ReadItem(size_t index) const
+	{
+		const ResourceLoadRequest &request = m_requests[index];
+
+		if (request.m_archive && request.m_archive->PrefetchResource(request.m_resTypeID, request.m_resID))
+			return true;
+
+		if (request.m_fallbackArchive && request.m_fallbackArchive->PrefetchResource(request.m_resTypeID, request.m_resID))
+			return true;
+
+		return false;
+	}
+
+	void ResourceLoadBatchImpl::CompleteItemLocked(size_t index, bool succeeded)
+	{
+		m_itemStates[index] = succeeded ? kItemStateSucceeded : kItemStateFailed;
+		m_completionOrder[m_numCompleted++] = index;
+
+		if (m_completedSignal)
+			m_completedSignal->Signal();
+	}
+
+	void ResourceLoadBatchImpl::Lock() const
+	{
+		if (m_completedSignal)
+			ResourceLoadPool::GetInstance()->GetMutex()->Lock();
+	}
+
+	void ResourceLoadBatchImpl::Unlock() const
+	{
+		if (m_completedSignal)
+			ResourceLoadPool::GetInstance()->GetMutex()->Unlock();
+	}
+
+	void ResourceLoadBatchImpl::WaitForCompletion()
+	{
+		// Without threads, every item was read on creation, so nothing that's incomplete ever gets here
+		assert(m_completedSignal);
+		m_completedSignal->Wait();
+	}
+
+	ResourceLoadBatch::~ResourceLoadBatch()
+	{
+	}
+
+	ResourceLoadBatch *ResourceLoadBatch::Create(const ResourceLoadRequest *requests, size_t numRequests)
+	{
+		MemoryManager *mm = MemoryManager::GetInstance();
+		ResourceLoadPool *pool = ResourceLoadPool::GetInstance();
+
+		const size_t allocSize = (numRequests > 0) ? numRequests : 1;
+
+		ResourceLoadRequest *requestsCopy = static_cast<ResourceLoadRequest*>(mm->Alloc(sizeof(ResourceLoadRequest) * allocSize));
+		uint8_t *itemStates = static_cast<uint8_t*>(mm->Alloc(sizeof(uint8_t) * allocSize));
+		size_t *completionOrder = static_cast<size_t*>(mm->Alloc(sizeof(size_t) * allocSize));
+		void *storage = mm->Alloc(sizeof(ResourceLoadBatchImpl));
+
+		IGpThreadEvent *completedSignal = nullptr;
+		const bool hasThreads = pool->HasThreads();
+		if (hasThreads)
+			completedSignal = PLDrivers::GetSystemServices()->CreateThreadEvent(true, false);
+
+		if (!requestsCopy || !itemStates || !completionOrder || !storage || (hasThreads && !completedSignal))
+		{
+			if (completedSignal)
+				completedSignal->Destroy();
+
+			mm->Release(storage);
+			mm->Release(completionOrder);
+			mm->Release(itemStates);
+			mm->Release(requestsCopy);
+			return nullptr;
+		}
+
+		for (size_t i = 0; i < numRequests; i++)
+			new (requestsCopy + i) ResourceLoadRequest(requests[i]);
+
+		ResourceLoadBatchImpl *batch = new (storage) ResourceLoadBatchImpl(requestsCopy, itemStates, completionOrder, numRequests, completedSignal);
+
+		if (numRequests == 0)
+			return batch;
+
+		if (!hasThreads)
+		{
+			for (size_t i = 0; i < numRequests; i++)
+			{
+				const size_t index = batch->ClaimItemLocked();
+				batch->CompleteItemLocked(index, batch->ReadItem(index));
+			}
+
+			return batch;
+		}
+
+		IGpMutex *mutex = pool->GetMutex();
+		mutex->Lock();
+		pool->EnqueueLocked(batch);
+		mutex->Unlock();
+
+		pool->SignalWork();
+
+		return batch;
+	}
+
+	void ResourceLoadBatch::StartThreads()
+	{
+		ResourceLoadPool::GetInstance()->Start();
+	}
+
+	void ResourceLoadBatch::StopThreads()
+	{
+		ResourceLoadPool::GetInstance()->Stop();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef __PL_RESOURCE_LOAD_BATCH_H__
+#define __PL_RESOURCE_LOAD_BATCH_H__
+
+#include "PLHandle.h"
+#include "ResTypeID.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace PortabilityLayer
+{
+	struct IResourceArchive;
+
+	struct ResourceLoadRequest
+	{
+		IResourceArchive *m_archive;
+		IResourceArchive *m_fallbackArchive;	// Read from if the first archive doesn't have the resource, may be null
+		ResTypeID m_resTypeID;
+		int16_t m_resID;
+	};
+
+	// Reads a list of resources ahead on the resource loader threads.  Each item completes on its own, and once
+	// it has, loading it is served from the resource cache instead of inflating it again.
+	//
+	// A batch must only be used from the thread that created it, and its archives must stay open until it's
+	// destroyed.
+	class ResourceLoadBatch
+	{
+	public:
+		static ResourceLoadBatch *Create(const ResourceLoadRequest *requests, size_t numRequests);
+
+		// Waits for any reads that are already running, items that haven't started are dropped
+		virtual void Destroy() = 0;
+
+		virtual size_t NumItems() const = 0;
+		virtual bool IsItemComplete(size_t index) const = 0;
+		virtual bool IsComplete() const = 0;
+
+		// Blocks until the item has been read, returns false if neither archive could read it
+		virtual bool WaitForItem(size_t index) = 0;
+
+		// Blocks until another item completes and returns its index, in the order they completed.  Returns false
+		// once every item has been returned.
+		virtual bool WaitForNextItem(size_t &outIndex) = 0;
+
+		// Waits for the item and then loads it from its archive, or the fallback archive
+		virtual THandle<void> LoadItem(size_t index) = 0;
+
+		// Starts and stops the threads shared by all batches.  Without threads, batches are read on creation.
+		static void StartThreads();
+		static void StopThreads();
+
+	protected:
+		virtual ~ResourceLoadBatch();
+	};
+}
+
+#endif
@@ -15,6 +15,7 @@ namespace PortabilityLayer
 	struct ResourceCompiledRef;
 	class ResourceFile;
 	class ResTypeID;
+	class ResourceArchiveZipFile;
 	class ZipFileProxy;
 	class CompositeFile;
 
@@ -23,16 +24,33 @@ namespace PortabilityLayer
 		ResourceArchiveRef();
 
 		MMHandleBlock *m_handle;
+		ResourceArchiveZipFile *m_archive;	// Gets the contents back when the handle is released, if set
 		size_t m_size;
 		int16_t m_resID;
 	};
 
+	// A resource file in an archive, indexed by type and ID
+	struct ResourceArchiveTypedRef
+	{
+		int32_t m_resType;
+		int16_t m_resID;
+		size_t m_fileIndex;
+	};
+
 	struct IResourceArchive
 	{
 		virtual void Destroy() = 0;
 
 		virtual THandle<void> LoadResource(const ResTypeID &resTypeID, int id) = 0;
 
+		// Reads a resource ahead of time so that a later LoadResource of it doesn't touch the archive.
+		// May be called from any thread, but the archive must not be destroyed while it's running.
+		virtual bool PrefetchResource(const ResTypeID &resTypeID, int id) = 0;
+
+		// Opens a resource for incremental reading instead of loading it whole.  The resource isn't validated.
+		// The stream may be read from any thread, and must be closed before the archive is destroyed.
+		virtual GpIOStream *OpenResourceStream(const ResTypeID &resTypeID, int id) = 0;
+
 		virtual bool HasAnyResourcesOfType(const ResTypeID &resTypeID) const = 0;
 		virtual bool FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const = 0;
 	};
@@ -49,13 +67,23 @@ namespace PortabilityLayer
 		static ResourceArchiveZipFile *Create(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream);
 		void Destroy() override;
 
+		// Writes the archive index for a version 2 archive, see GpArchiveIndexHeader.  The buffer is zero-filled past
+		// the end of the index.  Returns false if it doesn't fit.
+		static bool WriteArchiveIndex(const ZipFileProxy *zipFileProxy, void *buffer, size_t bufferSize);
+
 		THandle<void> LoadResource(const ResTypeID &resTypeID, int id) override;
+		bool PrefetchResource(const ResTypeID &resTypeID, int id) override;
+		GpIOStream *OpenResourceStream(const ResTypeID &resTypeID, int id) override;
 
 		bool HasAnyResourcesOfType(const ResTypeID &resTypeID) const override;
 		bool FindFirstResourceOfType(const ResTypeID &resTypeID, int16_t &outID) const override;
 
+		// Takes the contents of a released resource handle into the resource cache if they still match the archive,
+		// so loading the resource again doesn't touch the archive.  Returns false if the caller still owns them.
+		bool CacheReleasedContents(const ResourceArchiveRef *ref, void *contents, size_t size);
+
 	private:
-		ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles);
+		ResourceArchiveZipFile(ZipFileProxy *zipFileProxy, bool proxyIsShared, GpIOStream *stream, ResourceArchiveRef *resourceHandles, ResourceArchiveTypedRef *typedRefs, size_t numTypedRefs);
 		~ResourceArchiveZipFile();
 
 		bool IndexResource(const ResTypeID &resTypeID, int id, size_t &outIndex, int &outValidationRule) const;
@@ -66,6 +94,10 @@ namespace PortabilityLayer
 		GpIOStream *m_stream;	// This may be null, i.e. a composite file may own it instead
 		ResourceArchiveRef *m_resourceHandles;
 		bool m_proxyIsShared;
+
+		ResourceArchiveTypedRef *m_typedRefs;	// Sorted by type and then ID
+		size_t m_numTypedRefs;
+
 	};
 
 	class ResourceManager
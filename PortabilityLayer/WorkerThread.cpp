@@ -1,20 +1,17 @@
 #include "WorkerThread.h"
-#include "IGpThreadEvent.h"
-#include "IGpSystemServices.h"
-
-#include "PLDrivers.h"
+#include "JobSystem.h"
 
 #include <stdlib.h>
 #include <new>
 
 namespace PortabilityLayer
 {
+	// Runs tasks on the job system, each one depending on the last so that they still run one at a time in order
 	class WorkerThreadImpl final : public WorkerThread
 	{
 	public:
 		WorkerThreadImpl();
 
-		bool Init();
 		void Destroy() override;
 
 		void AsyncExecuteTask(Callback_t callback, void *context) override;
@@ -22,17 +19,7 @@ namespace PortabilityLayer
 	private:
 		~WorkerThreadImpl() override;
 
-		static int StaticThreadFuncThunk(void *context);
-		int ThreadFunc();
-
-		IGpThreadEvent *m_wakeSignal;
-		IGpThreadEvent *m_wakeConsumedSignal;
-
-		Callback_t m_waitingCallback;
-		void *m_waitingContext;
-
-		bool m_terminated;
-		bool m_threadRunning;
+		Job *m_lastTask;
 	};
 }
 
@@ -44,88 +31,24 @@ void PortabilityLayer::WorkerThreadImpl::Destroy()
 
 void PortabilityLayer::WorkerThreadImpl::AsyncExecuteTask(PortabilityLayer::WorkerThread::Callback_t callback, void *context)
 {
-	m_waitingCallback = callback;
-	m_waitingContext = context;
-	m_wakeSignal->Signal();
-	m_wakeConsumedSignal->Wait();
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
+
+	PortabilityLayer::Job *task = jobSystem->SubmitJob(callback, context, &m_lastTask, 1);
+	jobSystem->ReleaseJob(m_lastTask);
+	m_lastTask = task;
 }
 
 PortabilityLayer::WorkerThreadImpl::WorkerThreadImpl()
-	: m_wakeSignal(nullptr)
-	, m_wakeConsumedSignal(nullptr)
-	, m_waitingCallback(nullptr)
-	, m_waitingContext(nullptr)
-	, m_terminated(false)
-	, m_threadRunning(false)
+	: m_lastTask(nullptr)
 {
 }
 
 PortabilityLayer::WorkerThreadImpl::~WorkerThreadImpl()
 {
-	if (m_threadRunning)
-	{
-		m_terminated = true;
-		m_wakeSignal->Signal();
-		m_wakeConsumedSignal->Wait();
-	}
-
-	if (m_wakeSignal)
-		m_wakeSignal->Destroy();
-	if (m_wakeConsumedSignal)
-		m_wakeConsumedSignal->Destroy();
-}
+	PortabilityLayer::JobSystem *jobSystem = PortabilityLayer::JobSystem::GetInstance();
 
-
-int PortabilityLayer::WorkerThreadImpl::StaticThreadFuncThunk(void *context)
-{
-	return static_cast<PortabilityLayer::WorkerThreadImpl*>(context)->ThreadFunc();
-}
-
-int PortabilityLayer::WorkerThreadImpl::ThreadFunc()
-{
-	m_wakeSignal->Wait();
-	m_wakeConsumedSignal->Signal();
-
-	for (;;)
-	{
-		m_wakeSignal->Wait();
-
-		if (m_terminated)
-		{
-			m_wakeConsumedSignal->Signal();
-			return 0;
-		}
-		else
-		{
-			Callback_t callback = m_waitingCallback;
-			void *context = m_waitingContext;
-			m_wakeConsumedSignal->Signal();
-
-			callback(context);
-		}
-	}
-}
-
-bool PortabilityLayer::WorkerThreadImpl::Init()
-{
-	IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
-
-	m_wakeSignal = sysServices->CreateThreadEvent(true, false);
-	if (!m_wakeSignal)
-		return false;
-
-	m_wakeConsumedSignal = sysServices->CreateThreadEvent(true, false);
-	if (!m_wakeConsumedSignal)
-		return false;
-
-	if (!sysServices->CreateThread(PortabilityLayer::WorkerThreadImpl::StaticThreadFuncThunk, this))
-		return false;
-
-	m_threadRunning = true;
-	m_wakeSignal->Signal();
-	m_wakeConsumedSignal->Wait();
-
-	return true;
+	jobSystem->WaitForJob(m_lastTask);
+	jobSystem->ReleaseJob(m_lastTask);
 }
 
 
@@ -139,16 +62,13 @@ PortabilityLayer::WorkerThread::~WorkerThread()
 
 PortabilityLayer::WorkerThread *PortabilityLayer::WorkerThread::Create()
 {
-	void *storage = malloc(sizeof(PortabilityLayer::WorkerThreadImpl));
-	if (!storage)
+	// Without workers, tasks would run on the calling thread
+	if (PortabilityLayer::JobSystem::GetInstance()->GetNumWorkers() == 0)
 		return nullptr;
 
-	PortabilityLayer::WorkerThreadImpl *thread = new (storage) PortabilityLayer::WorkerThreadImpl();
-	if (!thread->Init())
-	{
-		thread->Destroy();
+	void *storage = malloc(sizeof(PortabilityLayer::WorkerThreadImpl));
+	if (!storage)
 		return nullptr;
-	}
 
-	return thread;
+	return new (storage) PortabilityLayer::WorkerThreadImpl();
 }
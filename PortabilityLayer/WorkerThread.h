@@ -4,6 +4,7 @@
 
 namespace PortabilityLayer
 {
+	// Runs tasks in the background on the job system, one at a time in the order they were queued
 	class WorkerThread
 	{
 	public:
@@ -1,15 +1,22 @@
 #include "ZipFileProxy.h"
 
-#include "BinarySearch.h"
 #include "FileSectionStream.h"
+#include "GPArchive.h"
 #include "GpIOStream.h"
+#include "IGpMutex.h"
+#include "IGpSystemServices.h"
 #include "InflateStream.h"
+#include "MemReaderStream.h"
 #include "MemoryManager.h"
 #include "ZipFile.h"
 
 #include "DeflateCodec.h"
+#include "PLDrivers.h"
 
 #include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
 
 namespace
 {
@@ -41,12 +48,18 @@ namespace
 			return 1;
 	}
 
-	static int ZipDirectorySearchPredicate(const char *path, const PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> &itemPtr)
+	// FNV-1a
+	static uint32_t HashZipPath(const char *path, size_t length)
 	{
-		const uint16_t fnameLength = itemPtr.Get().m_fileNameLength;
-		const char *itemPath = GetZipItemName(itemPtr);
+		uint32_t hash = 2166136261u;
 
-		return ZipDirectorySearchPredicateResolved(path, itemPath, fnameLength);
+		for (size_t i = 0; i < length; i++)
+		{
+			hash ^= static_cast<uint8_t>(path[i] & 0xff);
+			hash *= 16777619u;
+		}
+
+		return hash;
 	}
 
 	static int ZipDirectorySortPredicate(const void *a, const void *b)
@@ -97,6 +110,135 @@ namespace
 
 namespace PortabilityLayer
 {
+	// Wraps a stream opened from the archive so that its reads are serialized with LoadFile and other opened
+	// streams.  The section and inflate streams re-seek the shared archive stream whenever it's been moved.
+	class ZipFileLockedStream final : public GpIOStream
+	{
+	public:
+		ZipFileLockedStream(GpIOStream *stream, IGpMutex *mutex);
+
+		size_t Read(void *bytesOut, size_t size) override;
+		size_t Write(const void *bytes, size_t size) override;
+		bool IsSeekable() const override;
+		bool IsReadOnly() const override;
+		bool IsWriteOnly() const override;
+		bool SeekStart(GpUFilePos_t loc) override;
+		bool SeekCurrent(GpFilePos_t loc) override;
+		bool SeekEnd(GpUFilePos_t loc) override;
+		GpUFilePos_t Size() const override;
+		GpUFilePos_t Tell() const override;
+		void Close() override;
+		void Flush() override;
+
+	private:
+		GpIOStream *m_stream;
+		IGpMutex *m_mutex;
+	};
+
+	ZipFileLockedStream::ZipFileLockedStream(GpIOStream *stream, IGpMutex *mutex)
+		: m_stream(stream)
+		, m_mutex(mutex)
+	{
+	}
+
+	size_t ZipFileLockedStream::Read(void *bytesOut, size_t size)
+	{
+		m_mutex->Lock();
+		const size_t sizeRead = m_stream->Read(bytesOut, size);
+		m_mutex->Unlock();
+
+		return sizeRead;
+	}
+
+	size_t ZipFileLockedStream::Write(const void *, size_t)
+	{
+		return 0;
+	}
+
+	bool ZipFileLockedStream::IsSeekable() const
+	{
+		return m_stream->IsSeekable();
+	}
+
+	bool ZipFileLockedStream::IsReadOnly() const
+	{
+		return true;
+	}
+
+	bool ZipFileLockedStream::IsWriteOnly() const
+	{
+		return false;
+	}
+
+	bool ZipFileLockedStream::SeekStart(GpUFilePos_t loc)
+	{
+		m_mutex->Lock();
+		const bool seeked = m_stream->SeekStart(loc);
+		m_mutex->Unlock();
+
+		return seeked;
+	}
+
+	bool ZipFileLockedStream::SeekCurrent(GpFilePos_t loc)
+	{
+		m_mutex->Lock();
+		const bool seeked = m_stream->SeekCurrent(loc);
+		m_mutex->Unlock();
+
+		return seeked;
+	}
+
+	bool ZipFileLockedStream::SeekEnd(GpUFilePos_t loc)
+	{
+		m_mutex->Lock();
+		const bool seeked = m_stream->SeekEnd(loc);
+		m_mutex->Unlock();
+
+		return seeked;
+	}
+
+	GpUFilePos_t ZipFileLockedStream::Size() const
+	{
+		return m_stream->Size();
+	}
+
+	GpUFilePos_t ZipFileLockedStream::Tell() const
+	{
+		return m_stream->Tell();
+	}
+
+	void ZipFileLockedStream::Close()
+	{
+		m_stream->Close();
+
+		this->~ZipFileLockedStream();
+		free(this);
+	}
+
+	void ZipFileLockedStream::Flush()
+	{
+	}
+
+	// A stored file in a memory-mapped archive, read straight out of the mapping
+	class ZipFileViewStream final : public MemReaderStream
+	{
+	public:
+		ZipFileViewStream(const void *data, size_t size);
+
+		void Close() override;
+	};
+
+	ZipFileViewStream::ZipFileViewStream(const void *data, size_t size)
+		: MemReaderStream(data, size)
+	{
+	}
+
+	void ZipFileViewStream::Close()
+	{
+		this->~ZipFileViewStream();
+		free(this);
+	}
+
 	void ZipFileProxy::Destroy()
 	{
 		MemoryManager *mm = MemoryManager::GetInstance();
@@ -107,101 +249,173 @@ namespace PortabilityLayer
 
 	bool ZipFileProxy::IndexFile(const char *path, size_t &outIndex) const
 	{
-		UnalignedPtr<ZipCentralDirectoryFileHeader> *indexLoc = BinarySearch(m_sortedFiles, m_sortedFiles + m_numFiles, path, ZipDirectorySearchPredicate);
-		const size_t index = static_cast<size_t>(indexLoc - m_sortedFiles);
-
-		if (index == m_numFiles)
+		if (m_pathHashTableSize == 0)
 			return false;
-		else
+
+		const size_t pathLength = strlen(path);
+		const size_t hashMask = m_pathHashTableSize - 1;
+
+		// The table is never full, so this always stops at an empty slot
+		for (size_t slot = HashZipPath(path, pathLength) & hashMask; m_pathHashTable[slot] != 0; slot = (slot + 1) & hashMask)
 		{
-			outIndex = index;
-			return true;
+			const size_t index = m_pathHashTable[slot] - 1;
+			const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[index];
+
+			if (itemPtr.Get().m_fileNameLength == pathLength && !memcmp(GetZipItemName(itemPtr), path, pathLength))
+			{
+				outIndex = index;
+				return true;
+			}
 		}
+
+		return false;
 	}
 
 
 	bool ZipFileProxy::HasPrefix(const char *prefix) const
 	{
-		size_t prefixLen = strlen(prefix);
+		size_t fileIndex = 0;
+		return FindFirstWithPrefix(prefix, fileIndex);
+	}
+
+	bool ZipFileProxy::FindFirstWithPrefix(const char *prefix, size_t &outFileIndex) const
+	{
+		const size_t prefixLen = strlen(prefix);
+
+		size_t fileIndex = FindFirstNotBefore(prefix);
+		if (fileIndex == m_numFiles)
+			return false;
+
+		UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[fileIndex];
+
+		// A file named exactly the prefix (i.e. a directory entry) doesn't count
+		if (itemPtr.Get().m_fileNameLength == prefixLen && !memcmp(prefix, GetZipItemName(itemPtr), prefixLen))
+		{
+			fileIndex++;
+			if (fileIndex == m_numFiles)
+				return false;
+
+			itemPtr = m_sortedFiles[fileIndex];
+		}
+
+		// Everything with the prefix sorts together right after it, so only the first candidate needs checking
+		const uint16_t itemNameLength = itemPtr.Get().m_fileNameLength;
+		if (itemNameLength > prefixLen && !memcmp(prefix, GetZipItemName(itemPtr), prefixLen))
+		{
+			outFileIndex = fileIndex;
+			return true;
+		}
+
+		return false;
+	}
 
+	// Returns the index of the first file that doesn't sort before the path, or the file count if there isn't one
+	size_t ZipFileProxy::FindFirstNotBefore(const char *path) const
+	{
 		size_t firstFile = 0;
 		size_t lastFileExclusive = m_numFiles;
-		size_t midFile = (firstFile + lastFileExclusive) / 2;
 
 		while (firstFile != lastFileExclusive)
 		{
-			const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[midFile];
-			const PortabilityLayer::ZipCentralDirectoryFileHeader item = itemPtr.Get();
-			const uint16_t itemNameLength = item.m_fileNameLength;
-			const char *itemPath = GetZipItemName(itemPtr);
+			const size_t midFile = (firstFile + lastFileExclusive) / 2;
 
-			const int delta = ZipDirectorySearchPredicateResolved(prefix, itemPath, itemNameLength);
+			const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[midFile];
+			const uint16_t itemNameLength = itemPtr.Get().m_fileNameLength;
 
 			// -1 = path precedes item, 1 = path succeeds item
-			if (delta < 0)
-			{
-				const bool isPathPrefix = ((itemNameLength > prefixLen) && !memcmp(prefix, itemPath, prefixLen));
-				if (isPathPrefix)
-					return true;
-				else
-				{
-					lastFileExclusive = midFile;
-					midFile = (firstFile + lastFileExclusive) / 2;
-				}
-			}
-			else if (delta > 0)
-			{
+			if (ZipDirectorySearchPredicateResolved(path, GetZipItemName(itemPtr), itemNameLength) > 0)
 				firstFile = midFile + 1;
-				midFile = (firstFile + lastFileExclusive) / 2;
+			else
+				lastFileExclusive = midFile;
+		}
+
+		return firstFile;
+	}
+
+	bool ZipFileProxy::LoadFile(size_t index, void *outBuffer)
+	{
+		if (m_mappedData)
+		{
+			const uint8_t *fileData = GetMappedFileData(index);
+			if (!fileData)
+				return false;
+
+			const ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+			const size_t uncompressedSize = centralDirHeader.m_uncompressedSize;
+
+			if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
+			{
+				memcpy(outBuffer, fileData, uncompressedSize);
+				return true;
 			}
-			else //if(delta == 0)
+			else
 			{
-				// Found the directory
-				firstFile = midFile + 1;
-				midFile = (firstFile + lastFileExclusive) / 2;
+				if (!DeflateCodec::DecompressMemory(fileData, centralDirHeader.m_compressedSize, outBuffer, uncompressedSize))
+					return false;
+
+				return DeflateContext::CRC32(0, outBuffer, uncompressedSize) == centralDirHeader.m_crc;
 			}
 		}
 
-		return false;
-	}
+		const ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+		const size_t uncompressedSize = centralDirHeader.m_uncompressedSize;
 
-	bool ZipFileProxy::FindFirstWithPrefix(const char *prefix, size_t &outFileIndex) const
-	{
-		size_t prefixLen = strlen(prefix);
+		if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
+		{
+			if (m_mutex)
+				m_mutex->Lock();
 
-		// Could do binary search, but it's much more complicated in this case, just do linear scan...
-		for (size_t i = 0; i < m_numFiles; i++)
+			const bool loaded = (SeekFileDataUnlocked(index) && m_stream->Read(outBuffer, uncompressedSize) == uncompressedSize);
+
+			if (m_mutex)
+				m_mutex->Unlock();
+
+			return loaded;
+		}
+		else if (centralDirHeader.m_method == PortabilityLayer::ZipConstants::kDeflatedMethod)
 		{
-			const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[i];
-			const PortabilityLayer::ZipCentralDirectoryFileHeader item = itemPtr.Get();
+			const size_t compressedSize = centralDirHeader.m_compressedSize;
 
-			const uint16_t itemNameLength = item.m_fileNameLength;
-			const char *itemPath = GetZipItemName(itemPtr);
+			// Only the read holds the lock, so loads on other threads can inflate at the same time.  If the whole
+			// entry can't be allocated, it's streamed instead, which has to inflate under the lock.
+			MemoryManager *mm = MemoryManager::GetInstance();
+			void *compressedData = mm->Alloc(compressedSize);
 
-			const int delta = ZipDirectorySearchPredicateResolved(prefix, itemPath, itemNameLength);
-			if (delta == 0)
-				continue;
+			if (m_mutex)
+				m_mutex->Lock();
 
-			if (delta < 0)
+			bool decompressed = false;
+			bool readCompressed = false;
+			if (SeekFileDataUnlocked(index))
 			{
-				const bool isPathPrefix = ((itemNameLength > prefixLen) && !memcmp(prefix, itemPath, prefixLen));
-
-				if (isPathPrefix)
-				{
-					outFileIndex = i;
-					return true;
-				}
+				if (compressedData)
+					readCompressed = (m_stream->Read(compressedData, compressedSize) == compressedSize);
 				else
-					return false;
+					decompressed = DeflateCodec::DecompressStream(m_stream, compressedSize, outBuffer, uncompressedSize);
 			}
-		}
 
-		return false;
+			if (m_mutex)
+				m_mutex->Unlock();
+
+			if (compressedData)
+			{
+				decompressed = (readCompressed && DeflateCodec::DecompressMemory(compressedData, compressedSize, outBuffer, uncompressedSize));
+				mm->Release(compressedData);
+			}
+
+			if (!decompressed)
+				return false;
+
+			return DeflateContext::CRC32(0, outBuffer, uncompressedSize) == centralDirHeader.m_crc;
+		}
+		else
+			return false;
 	}
 
-	bool ZipFileProxy::LoadFile(size_t index, void *outBuffer)
+	// Positions the stream at the start of the file's data, if its local header matches the central directory
+	bool ZipFileProxy::SeekFileDataUnlocked(size_t index)
 	{
-		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+		const ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
 
 		if (!m_stream->SeekStart(centralDirHeader.m_localHeaderOffset))
 			return false;
@@ -213,23 +427,45 @@ namespace PortabilityLayer
 		if (!m_stream->SeekCurrent(localHeader.m_fileNameLength + localHeader.m_extraFieldLength))
 			return false;
 
-		if (localHeader.m_compressedSize != centralDirHeader.m_compressedSize || localHeader.m_uncompressedSize != centralDirHeader.m_uncompressedSize || localHeader.m_method != centralDirHeader.m_method)
-			return false;
+		return localHeader.m_compressedSize == centralDirHeader.m_compressedSize && localHeader.m_uncompressedSize == centralDirHeader.m_uncompressedSize && localHeader.m_method == centralDirHeader.m_method;
+	}
 
-		const size_t uncompressedSize = centralDirHeader.m_uncompressedSize;
-		if (localHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
-			return m_stream->Read(outBuffer, uncompressedSize) == uncompressedSize;
-		else if (localHeader.m_method == PortabilityLayer::ZipConstants::kDeflatedMethod)
+	GpIOStream *ZipFileProxy::OpenFile(size_t index) const
+	{
+		if (m_mappedData && m_sortedFiles[index].Get().m_method == PortabilityLayer::ZipConstants::kStoredMethod)
 		{
-			const size_t compressedSize = centralDirHeader.m_compressedSize;
+			const uint8_t *fileData = GetMappedFileData(index);
+			if (!fileData)
+				return nullptr;
 
-			return DeflateCodec::DecompressStream(m_stream, compressedSize, outBuffer, uncompressedSize);
+			void *storage = malloc(sizeof(ZipFileViewStream));
+			if (!storage)
+				return nullptr;
+
+			return new (storage) ZipFileViewStream(fileData, m_sortedFiles[index].Get().m_uncompressedSize);
 		}
-		else
-			return false;
+
+		if (!m_mutex)
+			return OpenFileUnlocked(index);
+
+		void *storage = malloc(sizeof(ZipFileLockedStream));
+		if (!storage)
+			return nullptr;
+
+		m_mutex->Lock();
+		GpIOStream *stream = OpenFileUnlocked(index);
+		m_mutex->Unlock();
+
+		if (!stream)
+		{
+			free(storage);
+			return nullptr;
+		}
+
+		return new (storage) ZipFileLockedStream(stream, m_mutex);
 	}
 
-	GpIOStream *ZipFileProxy::OpenFile(size_t index) const
+	GpIOStream *ZipFileProxy::OpenFileUnlocked(size_t index) const
 	{
 		ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
 
@@ -261,6 +497,42 @@ namespace PortabilityLayer
 			return nullptr;
 	}
 
+	// Checks the local header against the central directory the same way as the stream paths, and returns
+	// the file's data in the mapping if it's all in bounds and uses a supported method.
+	const uint8_t *ZipFileProxy::GetMappedFileData(size_t index) const
+	{
+		const ZipCentralDirectoryFileHeader centralDirHeader = m_sortedFiles[index].Get();
+
+		GpUFilePos_t position = centralDirHeader.m_localHeaderOffset;
+		if (position > m_mappedSize || m_mappedSize - position < sizeof(ZipFileLocalHeader))
+			return nullptr;
+
+		const ZipFileLocalHeader localHeader = UnalignedPtr<ZipFileLocalHeader>(reinterpret_cast<const ZipFileLocalHeader*>(m_mappedData + position)).Get();
+		position += sizeof(ZipFileLocalHeader);
+
+		if (localHeader.m_compressedSize != centralDirHeader.m_compressedSize || localHeader.m_uncompressedSize != centralDirHeader.m_uncompressedSize || localHeader.m_method != centralDirHeader.m_method)
+			return nullptr;
+
+		if (localHeader.m_method == PortabilityLayer::ZipConstants::kStoredMethod)
+		{
+			if (centralDirHeader.m_compressedSize != centralDirHeader.m_uncompressedSize)
+				return nullptr;
+		}
+		else if (localHeader.m_method != PortabilityLayer::ZipConstants::kDeflatedMethod)
+			return nullptr;
+
+		const GpUFilePos_t headerExtraSize = static_cast<GpUFilePos_t>(localHeader.m_fileNameLength) + localHeader.m_extraFieldLength;
+		if (m_mappedSize - position < headerExtraSize)
+			return nullptr;
+
+		position += headerExtraSize;
+
+		if (m_mappedSize - position < centralDirHeader.m_compressedSize)
+			return nullptr;
+
+		return m_mappedData + position;
+	}
+
 	size_t ZipFileProxy::NumFiles() const
 	{
 		return m_numFiles;
@@ -271,6 +543,11 @@ namespace PortabilityLayer
 		return m_sortedFiles[index].Get().m_uncompressedSize;
 	}
 
+	uint32_t ZipFileProxy::GetFileCRC(size_t index) const
+	{
+		return m_sortedFiles[index].Get().m_crc;
+	}
+
 	void ZipFileProxy::GetFileName(size_t index, const char *&outName, size_t &outLength) const
 	{
 		const UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader> itemPtr = m_sortedFiles[index];
@@ -280,6 +557,257 @@ namespace PortabilityLayer
 		outName = GetZipItemName(itemPtr);
 	}
 
+	size_t ZipFileProxy::GetCentralDirSize() const
+	{
+		return m_centralDirSize;
+	}
+
+	size_t ZipFileProxy::GetCentralDirOffset(size_t index) const
+	{
+		return reinterpret_cast<const uint8_t*>(m_sortedFiles[index].GetRawPtr()) - static_cast<const uint8_t*>(m_centralDirImage);
+	}
+
+	const uint32_t *ZipFileProxy::GetPathHashTable(size_t &outSize) const
+	{
+		outSize = m_pathHashTableSize;
+		return m_pathHashTable;
+	}
+
+	const GpArchiveIndexTypedRef *ZipFileProxy::GetIndexedResources(size_t &outCount) const
+	{
+		outCount = m_numIndexedResources;
+		return m_indexedResources;
+	}
+
+	size_t ZipFileProxy::GetPathHashTableSize(size_t numFiles)
+	{
+		// At least twice the size of the directory so probes stay short
+		size_t pathHashTableSize = 1;
+		while (pathHashTableSize < numFiles * 2)
+			pathHashTableSize *= 2;
+
+		return pathHashTableSize;
+	}
+
+	static bool ParseCentralDirectory(uint8_t *centralDirImage, size_t centralDirSize, size_t numFiles, UnalignedPtr<ZipCentralDirectoryFileHeader> *outSortedFiles)
+	{
+		uint8_t *const centralDirStart = centralDirImage;
+		uint8_t *const centralDirEnd = centralDirStart + centralDirSize;
+		uint8_t *centralDirCursor = centralDirStart;
+
+		for (size_t i = 0; i < numFiles; i++)
+		{
+			if (centralDirEnd - centralDirCursor < sizeof(ZipCentralDirectoryFileHeader))
+				return false;
+
+			UnalignedPtr<ZipCentralDirectoryFileHeader> centralDirHeaderPtr = UnalignedPtr<ZipCentralDirectoryFileHeader>(reinterpret_cast<ZipCentralDirectoryFileHeader*>(centralDirCursor));
+			ZipCentralDirectoryFileHeader centralDirHeader = centralDirHeaderPtr.Get();
+
+			centralDirCursor += sizeof(ZipCentralDirectoryFileHeader);
+
+			if (centralDirHeader.m_signature != ZipCentralDirectoryFileHeader::kSignature)
+				return false;
+
+			if (centralDirEnd - centralDirCursor < centralDirHeader.m_fileNameLength)
+				return false;
+
+			if (!CheckAndFixFileName(centralDirCursor, centralDirHeader.m_fileNameLength))
+				return false;
+
+			centralDirCursor += centralDirHeader.m_fileNameLength;
+
+			if (centralDirEnd - centralDirCursor < centralDirHeader.m_extraFieldLength)
+				return false;
+
+			centralDirCursor += centralDirHeader.m_extraFieldLength;
+
+			if (centralDirEnd - centralDirCursor < centralDirHeader.m_commentLength)
+				return false;
+
+			centralDirCursor += centralDirHeader.m_commentLength;
+
+			outSortedFiles[i] = centralDirHeaderPtr;
+		}
+
+		if (numFiles)
+			qsort(outSortedFiles, numFiles, sizeof(ZipCentralDirectoryFileHeader*), ZipDirectorySortPredicate);
+
+		for (size_t i = 1; i < numFiles; i++)
+		{
+			if (ZipDirectorySortPredicate(outSortedFiles + (i - 1), outSortedFiles + i) == 0)
+				return false;	// Duplicate file names
+		}
+
+		return true;
+	}
+
+	static uint32_t *BuildPathHashTable(const UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles, size_t &outPathHashTableSize)
+	{
+		const size_t pathHashTableSize = ZipFileProxy::GetPathHashTableSize(numFiles);
+
+		uint32_t *pathHashTable = static_cast<uint32_t*>(MemoryManager::GetInstance()->Alloc(sizeof(uint32_t) * pathHashTableSize));
+		if (!pathHashTable)
+			return nullptr;
+
+		memset(pathHashTable, 0, sizeof(uint32_t) * pathHashTableSize);
+
+		const size_t hashMask = pathHashTableSize - 1;
+		for (size_t i = 0; i < numFiles; i++)
+		{
+			const uint16_t nameLength = sortedFiles[i].Get().m_fileNameLength;
+
+			size_t slot = HashZipPath(GetZipItemName(sortedFiles[i]), nameLength) & hashMask;
+			while (pathHashTable[slot] != 0)
+				slot = (slot + 1) & hashMask;
+
+			pathHashTable[slot] = static_cast<uint32_t>(i + 1);
+		}
+
+		outPathHashTableSize = pathHashTableSize;
+		return pathHashTable;
+	}
+
+	// Takes the sorted directory and path hash table from an archive index instead of building them.  Everything the
+	// index points at is bounds checked, but the order and hashes are trusted.
+	static bool ApplyArchiveIndex(const uint8_t *indexImage, size_t indexSize, uint8_t *centralDirImage, size_t centralDirSize, size_t numFiles, UnalignedPtr<ZipCentralDirectoryFileHeader> *outSortedFiles, uint32_t *&outPathHashTable, size_t &outPathHashTableSize, GpArchiveIndexTypedRef *&outIndexedResources, size_t &outNumIndexedResources)
+	{
+		MemoryManager *mm = MemoryManager::GetInstance();
+
+		const GpArchiveIndexHeader indexHeader = UnalignedPtr<GpArchiveIndexHeader>(reinterpret_cast<const GpArchiveIndexHeader*>(indexImage)).Get();
+
+		const size_t pathHashTableSize = indexHeader.m_pathHashTableSize;
+		const size_t numIndexedResources = indexHeader.m_numTypedRefs;
+
+		if (indexHeader.m_signature != GpArchiveIndexHeader::kSignature || indexHeader.m_numFiles != numFiles || indexHeader.m_centralDirSize != centralDirSize)
+			return false;
+
+		// The hash table needs a free slot for probes to stop at
+		if (pathHashTableSize <= numFiles || (pathHashTableSize & (pathHashTableSize - 1)) != 0 || numIndexedResources > numFiles)
+			return false;
+
+		if (pathHashTableSize > indexSize / sizeof(uint32_t))
+			return false;
+
+		if (indexSize < sizeof(GpArchiveIndexHeader) + (numFiles + pathHashTableSize) * sizeof(uint32_t) + numIndexedResources * sizeof(GpArchiveIndexTypedRef))
+			return false;
+
+		const LEUInt32_t *sortedOffsets = reinterpret_cast<const LEUInt32_t*>(indexImage + sizeof(GpArchiveIndexHeader));
+		const LEUInt32_t *pathHashTableSlots = sortedOffsets + numFiles;
+		const GpArchiveIndexTypedRef *indexedResourceRefs = reinterpret_cast<const GpArchiveIndexTypedRef*>(pathHashTableSlots + pathHashTableSize);
+
+		for (size_t i = 0; i < numFiles; i++)
+		{
+			const size_t offset = sortedOffsets[i];
+			if (offset > centralDirSize || centralDirSize - offset < sizeof(ZipCentralDirectoryFileHeader))
+				return false;
+
+			UnalignedPtr<ZipCentralDirectoryFileHeader> centralDirHeaderPtr = UnalignedPtr<ZipCentralDirectoryFileHeader>(reinterpret_cast<ZipCentralDirectoryFileHeader*>(centralDirImage + offset));
+			ZipCentralDirectoryFileHeader centralDirHeader = centralDirHeaderPtr.Get();
+
+			if (centralDirHeader.m_signature != ZipCentralDirectoryFileHeader::kSignature)
+				return false;
+
+			uint8_t *fileName = centralDirImage + offset + sizeof(ZipCentralDirectoryFileHeader);
+			if (static_cast<size_t>(centralDirImage + centralDirSize - fileName) < centralDirHeader.m_fileNameLength)
+				return false;
+
+			if (!CheckAndFixFileName(fileName, centralDirHeader.m_fileNameLength))
+				return false;
+
+			outSortedFiles[i] = centralDirHeaderPtr;
+		}
+
+		uint32_t *pathHashTable = static_cast<uint32_t*>(mm->Alloc(sizeof(uint32_t) * pathHashTableSize));
+		if (!pathHashTable)
+			return false;
+
+		size_t numUsedSlots = 0;
+		for (size_t i = 0; i < pathHashTableSize; i++)
+		{
+			const uint32_t slot = pathHashTableSlots[i];
+			if (slot > numFiles)
+			{
+				mm->Release(pathHashTable);
+				return false;
+			}
+
+			if (slot != 0)
+				numUsedSlots++;
+
+			pathHashTable[i] = slot;
+		}
+
+		if (numUsedSlots > numFiles)
+		{
+			mm->Release(pathHashTable);
+			return false;
+		}
+
+		GpArchiveIndexTypedRef *indexedResources = nullptr;
+		if (numIndexedResources > 0)
+		{
+			indexedResources = static_cast<GpArchiveIndexTypedRef*>(mm->Alloc(sizeof(GpArchiveIndexTypedRef) * numIndexedResources));
+			if (!indexedResources)
+			{
+				mm->Release(pathHashTable);
+				return false;
+			}
+
+			for (size_t i = 0; i < numIndexedResources; i++)
+				new (indexedResources + i) GpArchiveIndexTypedRef(indexedResourceRefs[i]);
+		}
+
+		outPathHashTable = pathHashTable;
+		outPathHashTableSize = pathHashTableSize;
+		outIndexedResources = indexedResources;
+		outNumIndexedResources = numIndexedResources;
+
+		return true;
+	}
+
+	// Version 2 archives store their index as a stored file at the very start of the archive
+	static bool LoadArchiveIndex(GpIOStream *stream, uint8_t *centralDirImage, size_t centralDirSize, size_t numFiles, UnalignedPtr<ZipCentralDirectoryFileHeader> *outSortedFiles, uint32_t *&outPathHashTable, size_t &outPathHashTableSize, GpArchiveIndexTypedRef *&outIndexedResources, size_t &outNumIndexedResources)
+	{
+		if (numFiles == 0)
+			return false;
+
+		const char *indexFileName = GpArchiveIndexHeader::GetFileName();
+		const size_t indexFileNameLength = strlen(indexFileName);
+
+		if (!stream->SeekStart(0))
+			return false;
+
+		ZipFileLocalHeader localHeader;
+		if (stream->Read(&localHeader, sizeof(localHeader)) != sizeof(localHeader))
+			return false;
+
+		if (localHeader.m_signature != ZipFileLocalHeader::kSignature || localHeader.m_method != ZipConstants::kStoredMethod || localHeader.m_fileNameLength != indexFileNameLength)
+			return false;
+
+		char fileName[64];
+		if (indexFileNameLength > sizeof(fileName) || stream->Read(fileName, indexFileNameLength) != indexFileNameLength || memcmp(fileName, indexFileName, indexFileNameLength))
+			return false;
+
+		if (!stream->SeekCurrent(localHeader.m_extraFieldLength))
+			return false;
+
+		const size_t indexSize = localHeader.m_uncompressedSize;
+		if (localHeader.m_compressedSize != indexSize || indexSize < sizeof(GpArchiveIndexHeader) || indexSize > GpArchiveIndexHeader::GetMaxSize(numFiles))
+			return false;
+
+		MemoryManager *mm = MemoryManager::GetInstance();
+
+		uint8_t *indexImage = static_cast<uint8_t*>(mm->Alloc(indexSize));
+		if (!indexImage)
+			return false;
+
+		const bool applied = stream->Read(indexImage, indexSize) == indexSize && ApplyArchiveIndex(indexImage, indexSize, centralDirImage, centralDirSize, numFiles, outSortedFiles, outPathHashTable, outPathHashTableSize, outIndexedResources, outNumIndexedResources);
+
+		mm->Release(indexImage);
+
+		return applied;
+	}
+
 	ZipFileProxy *ZipFileProxy::Create(GpIOStream *stream)
 	{
 		MemoryManager *mm = MemoryManager::GetInstance();
@@ -324,101 +852,69 @@ namespace PortabilityLayer
 			}
 		}
 
-		bool failed = false;
-
-		uint8_t *const centralDirStart = static_cast<uint8_t*>(centralDirImage);
-		uint8_t *const centralDirEnd = centralDirStart + centralDirSize;
-		uint8_t *centralDirCursor = centralDirStart;
+		uint32_t *pathHashTable = nullptr;
+		size_t pathHashTableSize = 0;
+		GpArchiveIndexTypedRef *indexedResources = nullptr;
+		size_t numIndexedResources = 0;
 
-		for (size_t i = 0; i < numFiles; i++)
+		if (!LoadArchiveIndex(stream, static_cast<uint8_t*>(centralDirImage), centralDirSize, numFiles, centralDirFiles, pathHashTable, pathHashTableSize, indexedResources, numIndexedResources))
 		{
-			if (centralDirEnd - centralDirCursor < sizeof(ZipCentralDirectoryFileHeader))
-			{
-				failed = true;
-				break;
-			}
-
-			UnalignedPtr<ZipCentralDirectoryFileHeader> centralDirHeaderPtr = UnalignedPtr<ZipCentralDirectoryFileHeader>(reinterpret_cast<ZipCentralDirectoryFileHeader*>(centralDirCursor));
-			ZipCentralDirectoryFileHeader centralDirHeader = centralDirHeaderPtr.Get();
-
-			centralDirCursor += sizeof(ZipCentralDirectoryFileHeader);
-
-			if (centralDirHeader.m_signature != ZipCentralDirectoryFileHeader::kSignature)
-			{
-				failed = true;
-				break;
-			}
-
-			if (centralDirEnd - centralDirCursor < centralDirHeader.m_fileNameLength)
-			{
-				failed = true;
-				break;
-			}
-
-			if (!CheckAndFixFileName(centralDirCursor, centralDirHeader.m_fileNameLength))
-			{
-				failed = true;
-				break;
-			}
-
-			centralDirCursor += centralDirHeader.m_fileNameLength;
-
-			if (centralDirEnd - centralDirCursor < centralDirHeader.m_extraFieldLength)
+			if (!ParseCentralDirectory(static_cast<uint8_t*>(centralDirImage), centralDirSize, numFiles, centralDirFiles))
 			{
-				failed = true;
-				break;
+				mm->Release(centralDirFiles);
+				mm->Release(centralDirImage);
+				return nullptr;
 			}
 
-			centralDirCursor += centralDirHeader.m_extraFieldLength;
-
-			if (centralDirEnd - centralDirCursor < centralDirHeader.m_commentLength)
+			if (numFiles > 0)
 			{
-				failed = true;
-				break;
+				pathHashTable = BuildPathHashTable(centralDirFiles, numFiles, pathHashTableSize);
+				if (!pathHashTable)
+				{
+					mm->Release(centralDirFiles);
+					mm->Release(centralDirImage);
+					return nullptr;
+				}
 			}
-
-			centralDirCursor += centralDirHeader.m_commentLength;
-
-			centralDirFiles[i] = centralDirHeaderPtr;
-		}
-
-		if (failed)
-		{
-			mm->Release(centralDirFiles);
-			mm->Release(centralDirImage);
-			return nullptr;
 		}
 
-		if (numFiles)
-			qsort(centralDirFiles, numFiles, sizeof(ZipCentralDirectoryFileHeader*), ZipDirectorySortPredicate);
-
-		for (size_t i = 1; i < numFiles; i++)
-		{
-			if (ZipDirectorySortPredicate(centralDirFiles + (i - 1), centralDirFiles + i) == 0)
-			{
-				// Duplicate file names
-				mm->Release(centralDirFiles);
-				mm->Release(centralDirImage);
-				return nullptr;
-			}
-		}
+		IGpMutex *mutex = nullptr;
+		IGpSystemServices *sysServices = PLDrivers::GetSystemServices();
+		if (sysServices)
+			mutex = sysServices->CreateMutex();
 
 		void *storage = mm->Alloc(sizeof(ZipFileProxy));
 		if (!storage)
 		{
+			if (mutex)
+				mutex->Destroy();
+			mm->Release(indexedResources);
+			mm->Release(pathHashTable);
 			mm->Release(centralDirFiles);
 			mm->Release(centralDirImage);
 			return nullptr;
 		}
 
-		return new (storage) ZipFileProxy(stream, centralDirImage, centralDirFiles, numFiles);
+		// Mapping is optional, everything falls back to reading the stream
+		const void *mappedData = stream->MapContents();
+		const GpUFilePos_t mappedSize = mappedData ? stream->Size() : 0;
+
+		return new (storage) ZipFileProxy(stream, mappedData, mappedSize, centralDirImage, centralDirSize, centralDirFiles, numFiles, pathHashTable, pathHashTableSize, indexedResources, numIndexedResources, mutex);
 	}
 
-	ZipFileProxy::ZipFileProxy(GpIOStream *stream, void *centralDirImage, UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles)
+	ZipFileProxy::ZipFileProxy(GpIOStream *stream, const void *mappedData, GpUFilePos_t mappedSize, void *centralDirImage, size_t centralDirSize, UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles, uint32_t *pathHashTable, size_t pathHashTableSize, GpArchiveIndexTypedRef *indexedResources, size_t numIndexedResources, IGpMutex *mutex)
 		: m_stream(stream)
+		, m_mappedData(static_cast<const uint8_t*>(mappedData))
+		, m_mappedSize(mappedSize)
+		, m_mutex(mutex)
 		, m_centralDirImage(centralDirImage)
+		, m_centralDirSize(centralDirSize)
 		, m_sortedFiles(sortedFiles)
 		, m_numFiles(numFiles)
+		, m_pathHashTable(pathHashTable)
+		, m_pathHashTableSize(pathHashTableSize)
+		, m_indexedResources(indexedResources)
+		, m_numIndexedResources(numIndexedResources)
 	{
 	}
 
@@ -427,5 +923,10 @@ namespace PortabilityLayer
 		MemoryManager *mm = MemoryManager::GetInstance();
 		mm->Release(m_centralDirImage);
 		mm->Release(m_sortedFiles);
+		mm->Release(m_pathHashTable);
+		mm->Release(m_indexedResources);
+
+		if (m_mutex)
+			m_mutex->Destroy();
 	}
 }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "GpFilePos.h"
 #include "PLUnalignedPtr.h"
 
 class GpIOStream;
+struct IGpMutex;
 
 namespace PortabilityLayer
 {
+	struct GpArchiveIndexTypedRef;
 	struct ZipCentralDirectoryFileHeader;
 
 	class ZipFileProxy
@@ -14,8 +17,14 @@ namespace PortabilityLayer
 		void Destroy();
 
 		bool IndexFile(const char *path, size_t &outIndex) const;
+
+		// LoadFile may be called from any thread.  Reads are serialized on the underlying stream, but inflating and
+		// checking the CRC happen outside the lock.  If the archive is memory-mapped, loads copy or inflate straight
+		// out of the mapping.
 		bool LoadFile(size_t index, void *outBuffer);
 
+		// OpenFile may be called from any thread, reads from the stream are serialized with LoadFile.  Stored files in
+		// a memory-mapped archive are opened as views of the mapping instead.
 		GpIOStream *OpenFile(size_t index) const;
 
 		bool HasPrefix(const char *path) const;
@@ -23,17 +32,42 @@ namespace PortabilityLayer
 
 		size_t NumFiles() const;
 		size_t GetFileSize(size_t index) const;
+		uint32_t GetFileCRC(size_t index) const;
 		void GetFileName(size_t index, const char *&outName, size_t &outLength) const;
 
+		// Used to write and read archive indexes
+		size_t GetCentralDirSize() const;
+		size_t GetCentralDirOffset(size_t index) const;
+		const uint32_t *GetPathHashTable(size_t &outSize) const;
+		const GpArchiveIndexTypedRef *GetIndexedResources(size_t &outCount) const;	// Null if the archive has no index
+
 		static ZipFileProxy *Create(GpIOStream *stream);
+		static size_t GetPathHashTableSize(size_t numFiles);
 
 	private:
-		ZipFileProxy(GpIOStream *stream, void *centralDirImage, UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles);
+		ZipFileProxy(GpIOStream *stream, const void *mappedData, GpUFilePos_t mappedSize, void *centralDirImage, size_t centralDirSize, UnalignedPtr<ZipCentralDirectoryFileHeader> *sortedFiles, size_t numFiles, uint32_t *pathHashTable, size_t pathHashTableSize, GpArchiveIndexTypedRef *indexedResources, size_t numIndexedResources, IGpMutex *mutex);
 		~ZipFileProxy();
 
+		bool SeekFileDataUnlocked(size_t index);
+		GpIOStream *OpenFileUnlocked(size_t index) const;
+		const uint8_t *GetMappedFileData(size_t index) const;
+		size_t FindFirstNotBefore(const char *path) const;
+
 		GpIOStream *m_stream;
+		const uint8_t *m_mappedData;	// Null if the stream can't be mapped
+		GpUFilePos_t m_mappedSize;
+		IGpMutex *m_mutex;	// May be null if no system services are available
 		void *m_centralDirImage;
+		size_t m_centralDirSize;
 		UnalignedPtr<ZipCentralDirectoryFileHeader> *m_sortedFiles;
 		size_t m_numFiles;
+
+		// Open-addressed table of sorted file indexes + 1, keyed by a hash of the path.  Size is a power of 2.
+		uint32_t *m_pathHashTable;
+		size_t m_pathHashTableSize;
+
+		// Resources sorted by type and ID, from the archive index
+		GpArchiveIndexTypedRef *m_indexedResources;
+		size_t m_numIndexedResources;
 	};
 }
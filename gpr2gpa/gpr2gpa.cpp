@@ -1,18 +1,27 @@
+#include "BitmapImage.h"
 #include "BMPFormat.h"
 #include "CFileStream.h"
 #include "CombinedTimestamp.h"
 #include "GPArchive.h"
 #include "MacRomanConversion.h"
+#include "MemoryManager.h"
 #include "MemReaderStream.h"
+#include "QDGraf.h"
+#include "QDManager.h"
 #include "QDPictDecoder.h"
 #include "QDPictEmitContext.h"
 #include "QDPictEmitScanlineParameters.h"
+#include "QDPixMap.h"
+#include "QDStandardPalette.h"
 #include "MacFileInfo.h"
+#include "PLUnalignedPtr.h"
 #include "ResourceFile.h"
 #include "ResourceCompiledTypeList.h"
+#include "ResourceManager.h"
 #include "SharedTypes.h"
 #include "UTF8.h"
 #include "ZipFile.h"
+#include "ZipFileProxy.h"
 #include "WaveFormat.h"
 
 #include "zlib.h"
@@ -47,9 +56,11 @@ struct PlannedEntry
 
 	std::string m_name;
 	bool m_isDirectory;
+	bool m_isStored;	// Never compressed
 
 	PlannedEntry()
 		: m_isDirectory(false)
+		, m_isStored(false)
 	{
 	}
 };
@@ -185,7 +196,45 @@ bool TryDeflate(const std::vector<uint8_t> &uncompressed, std::vector<uint8_t> &
 	return true;
 }
 
-void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const PortabilityLayer::CombinedTimestamp &ts)
+void AppendZipData(std::vector<uint8_t> &zipData, const void *data, size_t size)
+{
+	if (size > 0)
+		VectorAppend(zipData, static_cast<const uint8_t*>(data), size);
+}
+
+// Fills in the archive index, which must be the first entry, once the central directory is final
+bool WriteArchiveIndex(std::vector<uint8_t> &zipData, size_t cdirPos)
+{
+	PortabilityLayer::MemReaderStream memStream(&zipData[0], zipData.size());
+
+	PortabilityLayer::ZipFileProxy *proxy = PortabilityLayer::ZipFileProxy::Create(&memStream);
+	if (!proxy)
+		return false;
+
+	PortabilityLayer::ZipFileLocalHeader localHeader = PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipFileLocalHeader>(reinterpret_cast<const PortabilityLayer::ZipFileLocalHeader*>(&zipData[0])).Get();
+
+	uint8_t *indexData = &zipData[0] + sizeof(localHeader) + localHeader.m_fileNameLength;
+	const size_t indexSize = localHeader.m_uncompressedSize;
+
+	const bool written = PortabilityLayer::ResourceArchiveZipFile::WriteArchiveIndex(proxy, indexData, indexSize);
+	proxy->Destroy();
+
+	if (!written)
+		return false;
+
+	// The index is stored, so only the CRCs need to change
+	PortabilityLayer::ZipCentralDirectoryFileHeader cdirHeader = PortabilityLayer::UnalignedPtr<PortabilityLayer::ZipCentralDirectoryFileHeader>(reinterpret_cast<const PortabilityLayer::ZipCentralDirectoryFileHeader*>(&zipData[cdirPos])).Get();
+
+	localHeader.m_crc = crc32(0, indexData, static_cast<uint32_t>(indexSize));
+	cdirHeader.m_crc = localHeader.m_crc;
+
+	memcpy(&zipData[0], &localHeader, sizeof(localHeader));
+	memcpy(&zipData[cdirPos], &cdirHeader, sizeof(cdirHeader));
+
+	return true;
+}
+
+void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const PortabilityLayer::CombinedTimestamp &ts, bool writeArchiveIndex)
 {
 	FILE *outF = fopen_utf8(path, "wb");
 	if (!outF)
@@ -199,7 +248,19 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 
 	ts.GetAsMSDOSTimestamp(msdosModificationDate, msdosModificationTime);
 
+	if (writeArchiveIndex)
+	{
+		// Reserve space for the index at the start of the archive, it's filled in once everything else is laid out
+		PlannedEntry indexEntry;
+		indexEntry.m_name = PortabilityLayer::GpArchiveIndexHeader::GetFileName();
+		indexEntry.m_uncompressedContents.resize(PortabilityLayer::GpArchiveIndexHeader::GetMaxSize(entries.size() + 1));
+		indexEntry.m_isStored = true;
+
+		entries.insert(entries.begin(), indexEntry);
+	}
+
 	std::vector<PortabilityLayer::ZipCentralDirectoryFileHeader> cdirRecords;
+	std::vector<uint8_t> zipData;
 
 	// Why does OMP require signed indexes?  When do I ever want negative iterations?  Uggghh.
 	int numEntries = entries.size();
@@ -209,7 +270,7 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 	{
 		PlannedEntry &entry = entries[i];
 
-		if (entry.m_uncompressedContents.size() > 0)
+		if (entry.m_uncompressedContents.size() > 0 && !entry.m_isStored)
 		{
 			if (!TryDeflate(entry.m_uncompressedContents, entry.m_compressedContents))
 				entry.m_compressedContents.resize(0);
@@ -250,7 +311,7 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 		cdirHeader.m_diskNumber = 0;
 		cdirHeader.m_internalAttributes = 0;
 		cdirHeader.m_externalAttributes = entry.m_isDirectory ? PortabilityLayer::ZipConstants::kDirectoryAttributes : PortabilityLayer::ZipConstants::kArchivedAttributes;
-		cdirHeader.m_localHeaderOffset = ftell(outF);
+		cdirHeader.m_localHeaderOffset = static_cast<uint32_t>(zipData.size());
 
 		cdirRecords.push_back(cdirHeader);
 
@@ -268,25 +329,24 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 		localHeader.m_fileNameLength = cdirHeader.m_fileNameLength;
 		localHeader.m_extraFieldLength = 0;
 
-		fwrite(&localHeader, 1, sizeof(localHeader), outF);
-
-		fwrite(entry.m_name.c_str(), 1, entry.m_name.size(), outF);
+		AppendZipData(zipData, &localHeader, sizeof(localHeader));
+		AppendZipData(zipData, entry.m_name.c_str(), entry.m_name.size());
 
 		if (isCompressed)
-			fwrite(&entry.m_compressedContents[0], 1, entry.m_compressedContents.size(), outF);
+			AppendZipData(zipData, &entry.m_compressedContents[0], entry.m_compressedContents.size());
 		else if (entry.m_uncompressedContents.size() > 0)
-			fwrite(&entry.m_uncompressedContents[0], 1, entry.m_uncompressedContents.size(), outF);
+			AppendZipData(zipData, &entry.m_uncompressedContents[0], entry.m_uncompressedContents.size());
 	}
 
-	long cdirPos = ftell(outF);
+	size_t cdirPos = zipData.size();
 
 	for (size_t i = 0; i < entries.size(); i++)
 	{
-		fwrite(&cdirRecords[i], 1, sizeof(PortabilityLayer::ZipCentralDirectoryFileHeader), outF);
-		fwrite(entries[i].m_name.c_str(), 1, entries[i].m_name.size(), outF);
+		AppendZipData(zipData, &cdirRecords[i], sizeof(PortabilityLayer::ZipCentralDirectoryFileHeader));
+		AppendZipData(zipData, entries[i].m_name.c_str(), entries[i].m_name.size());
 	}
 
-	long cdirEndPos = ftell(outF);
+	size_t cdirEndPos = zipData.size();
 
 	PortabilityLayer::ZipEndOfCentralDirectoryRecord endRecord;
 
@@ -295,11 +355,16 @@ void ExportZipFile(const char *path, std::vector<PlannedEntry> &entries, const P
 	endRecord.m_centralDirDisk = 0;
 	endRecord.m_numCentralDirRecordsThisDisk = static_cast<uint32_t>(entries.size());
 	endRecord.m_numCentralDirRecords = static_cast<uint32_t>(entries.size());
-	endRecord.m_centralDirectorySizeBytes = cdirEndPos - cdirPos;
-	endRecord.m_centralDirStartOffset = cdirPos;
+	endRecord.m_centralDirectorySizeBytes = static_cast<uint32_t>(cdirEndPos - cdirPos);
+	endRecord.m_centralDirStartOffset = static_cast<uint32_t>(cdirPos);
 	endRecord.m_commentLength = 0;
 
-	fwrite(&endRecord, 1, sizeof(endRecord), outF);
+	AppendZipData(zipData, &endRecord, sizeof(endRecord));
+
+	if (writeArchiveIndex && !WriteArchiveIndex(zipData, cdirPos))
+		fprintf(stderr, "Failed to write archive index, the archive will be indexed at load time\n");
+
+	fwrite(&zipData[0], 1, zipData.size(), outF);
 
 	fclose(outF);
 }
@@ -1409,7 +1474,167 @@ bool ApplyPatch(const std::vector<uint8_t> &patchFileContents, std::vector<Plann
 	return true;
 }
 
-int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimestamp &ts, FILE *patchF, const char *outPath)
+// Draws a bitmap into a new surface and copies out its pixels at the given pitch
+bool PrebakePlane(const THandle<BitmapImage> &bmpHdl, const Rect &rect, GpPixelFormat_t pixelFormat, size_t bytesPerPixel, size_t pitch, std::vector<uint8_t> &outPlane)
+{
+	PortabilityLayer::QDManager *qdManager = PortabilityLayer::QDManager::GetInstance();
+
+	DrawSurface *surface = nullptr;
+	if (qdManager->NewGWorld(&surface, pixelFormat, rect, nullptr) != PLErrors::kNone)
+		return false;
+
+	surface->DrawPicture(bmpHdl, rect);
+
+	const PortabilityLayer::PixMapImpl *pixMap = static_cast<const PortabilityLayer::PixMapImpl*>(*surface->m_port.GetPixMap());
+	const uint8_t *pixelData = static_cast<const uint8_t*>(pixMap->GetPixelData());
+	const size_t surfacePitch = pixMap->GetPitch();
+
+	const size_t width = rect.Width();
+	const size_t height = rect.Height();
+
+	outPlane.resize(pitch * height);
+	for (size_t row = 0; row < height; row++)
+		memcpy(&outPlane[row * pitch], pixelData + row * surfacePitch, width * bytesPerPixel);
+
+	qdManager->DisposeGWorld(surface);
+
+	return true;
+}
+
+void AppendPrebakedPadding(std::vector<uint8_t> &bmp)
+{
+	const size_t alignment = PortabilityLayer::PrebakedBitmapHeader::kAlignment;
+
+	bmp.resize((bmp.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+// Appends the bitmap's pixels in the layout described by PrebakedBitmapHeader, converted the same way DrawPicture
+// would convert them.  Returns false and leaves the bitmap alone if it can't be drawn.
+bool PrebakeBitmap(std::vector<uint8_t> &bmp)
+{
+	if (bmp.size() < sizeof(PortabilityLayer::BitmapFileHeader) + sizeof(PortabilityLayer::BitmapInfoHeader))
+		return false;
+
+	const PortabilityLayer::BitmapFileHeader fileHeader = PortabilityLayer::UnalignedPtr<PortabilityLayer::BitmapFileHeader>(reinterpret_cast<const PortabilityLayer::BitmapFileHeader*>(&bmp[0])).Get();
+	const PortabilityLayer::BitmapInfoHeader infoHeader = PortabilityLayer::UnalignedPtr<PortabilityLayer::BitmapInfoHeader>(reinterpret_cast<const PortabilityLayer::BitmapInfoHeader*>(&bmp[sizeof(PortabilityLayer::BitmapFileHeader)])).Get();
+
+	if (fileHeader.m_fileSize != bmp.size())
+		return false;
+
+	const uint16_t bpp = infoHeader.m_bitsPerPixel;
+	if (bpp != 1 && bpp != 4 && bpp != 8 && bpp != 16 && bpp != 24)
+		return false;
+
+	if (infoHeader.m_numColors > 256)
+		return false;
+
+	const uint32_t width = infoHeader.m_width;
+	const uint32_t height = infoHeader.m_height;
+	if (width == 0 || height == 0 || width > 0x7fff || height > 0x7fff)
+		return false;
+
+	const size_t alignment = PortabilityLayer::PrebakedBitmapHeader::kAlignment;
+	const size_t pitch8 = (width + alignment - 1) / alignment * alignment;
+	const size_t pitch32 = (width * 4 + alignment - 1) / alignment * alignment;
+
+	PortabilityLayer::MemoryManager *mm = PortabilityLayer::MemoryManager::GetInstance();
+
+	THandle<BitmapImage> bmpHdl = THandle<BitmapImage>(mm->AllocHandle(bmp.size()));
+	if (!bmpHdl)
+		return false;
+
+	memcpy(static_cast<void*>(*bmpHdl), &bmp[0], bmp.size());
+
+	const Rect rect = Rect::Create(0, 0, static_cast<int16_t>(height), static_cast<int16_t>(width));
+
+	std::vector<uint8_t> plane8;
+	std::vector<uint8_t> plane32;
+
+	const bool baked = PrebakePlane(bmpHdl, rect, GpPixelFormats::k8BitStandard, 1, pitch8, plane8) && PrebakePlane(bmpHdl, rect, GpPixelFormats::kRGB32, 4, pitch32, plane32);
+
+	bmpHdl.Dispose();
+
+	if (!baked)
+		return false;
+
+	uint32_t flags = PortabilityLayer::PrebakedBitmapHeader::kFlag8BitStandard | PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32;
+	if (bpp > 8)
+		flags |= PortabilityLayer::PrebakedBitmapHeader::kFlag8BitDithered;
+
+	// Most pictures only use standard palette colors, in which case the 8-bit plane is enough for both
+	const PortabilityLayer::RGBAColor *stdColors = PortabilityLayer::StandardPalette::GetInstance()->GetColors();
+
+	bool isPaletteExpansion = true;
+	for (size_t row = 0; row < height && isPaletteExpansion; row++)
+	{
+		for (size_t col = 0; col < width; col++)
+		{
+			const uint32_t expandedColor = stdColors[plane8[row * pitch8 + col]].AsUInt32();
+
+			if (memcmp(&expandedColor, &plane32[row * pitch32 + col * 4], 4))
+			{
+				isPaletteExpansion = false;
+				break;
+			}
+		}
+	}
+
+	if (isPaletteExpansion)
+		flags |= PortabilityLayer::PrebakedBitmapHeader::kFlagRGB32FromPalette;
+
+	AppendPrebakedPadding(bmp);
+
+	const size_t headerOffset = bmp.size();
+	bmp.resize(headerOffset + sizeof(PortabilityLayer::PrebakedBitmapHeader));
+	AppendPrebakedPadding(bmp);
+
+	const size_t offset8 = bmp.size();
+	VectorAppend(bmp, &plane8[0], plane8.size());
+
+	size_t offset32 = 0;
+	if (!isPaletteExpansion)
+	{
+		offset32 = bmp.size();
+		VectorAppend(bmp, &plane32[0], plane32.size());
+	}
+
+	PortabilityLayer::PrebakedBitmapHeader prebakedHeader;
+	prebakedHeader.m_signature = PortabilityLayer::PrebakedBitmapHeader::kSignature;
+	prebakedHeader.m_flags = flags;
+	prebakedHeader.m_width = width;
+	prebakedHeader.m_height = height;
+	prebakedHeader.m_pitch8 = static_cast<uint32_t>(pitch8);
+	prebakedHeader.m_offset8 = static_cast<uint32_t>(offset8);
+	prebakedHeader.m_pitch32 = isPaletteExpansion ? 0 : static_cast<uint32_t>(pitch32);
+	prebakedHeader.m_offset32 = static_cast<uint32_t>(offset32);
+
+	memcpy(&bmp[headerOffset], &prebakedHeader, sizeof(prebakedHeader));
+
+	return true;
+}
+
+void PrebakeBitmaps(std::vector<PlannedEntry> &archive)
+{
+	int numEntries = archive.size();
+
+	for (int i = 0; i < numEntries; i++)
+	{
+		PlannedEntry &entry = archive[i];
+
+		const std::string &name = entry.m_name;
+		if (entry.m_isDirectory || name.length() < 4 || name.substr(name.length() - 4) != ".bmp")
+			continue;
+
+		if (!PrebakeBitmap(entry.m_uncompressedContents))
+		{
+			fprintf(stderr, "Couldn't pre-bake bitmap ");
+			fputs_utf8(name.c_str(), stderr);
+			fprintf(stderr, "\n");
+		}
+	}
+}
+
+int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimestamp &ts, FILE *patchF, const char *outPath, bool isVersion2)
 {
 	FILE *inF = fopen_utf8(resPath, "rb");
 	if (!inF)
@@ -1542,16 +1767,19 @@ int ConvertSingleFile(const char *resPath, const PortabilityLayer::CombinedTimes
 			return -1;
 	}
 
+	if (isVersion2)
+		PrebakeBitmaps(contents);
+
 	std::sort(contents.begin(), contents.end(), EntryAlphaSortPredicate);
 
-	ExportZipFile(outPath, contents, ts);
+	ExportZipFile(outPath, contents, ts, isVersion2);
 
 	resFile->Destroy();
 
 	return 0;
 }
 
-int ConvertDirectory(const std::string &basePath, const PortabilityLayer::CombinedTimestamp &ts)
+int ConvertDirectory(const std::string &basePath, const PortabilityLayer::CombinedTimestamp &ts, bool isVersion2)
 {
 	std::vector<std::string> paths;
 	ScanDirectoryForExtension(paths, basePath.c_str(), ".gpr", true);
@@ -1592,7 +1820,7 @@ int ConvertDirectory(const std::string &basePath, const PortabilityLayer::Combin
 			fputs_utf8(houseArchivePath.c_str(), stdout);
 			fprintf(stdout, "\n");
 
-			int returnCode = ConvertSingleFile(resPath.c_str(), ts, nullptr, houseArchivePath.c_str());
+			int returnCode = ConvertSingleFile(resPath.c_str(), ts, nullptr, houseArchivePath.c_str(), isVersion2);
 			if (returnCode)
 			{
 				fprintf(stderr, "An error occurred while converting\n");
@@ -1608,15 +1836,24 @@ int ConvertDirectory(const std::string &basePath, const PortabilityLayer::Combin
 
 int PrintUsage()
 {
-	fprintf(stderr, "Usage: gpr2gpa <input.gpr> <input.ts> <output.gpa> [patch.json]\n");
-	fprintf(stderr, "       gpr2gpa <input dir>\\* <input.ts>\n");
-	fprintf(stderr, "       gpr2gpa <input dir>/* <input.ts>\n");
-	fprintf(stderr, "       gpr2gpa * <input.ts>\n");
+	fprintf(stderr, "Usage: gpr2gpa [-v2] <input.gpr> <input.ts> <output.gpa> [patch.json]\n");
+	fprintf(stderr, "       gpr2gpa [-v2] <input dir>\\* <input.ts>\n");
+	fprintf(stderr, "       gpr2gpa [-v2] <input dir>/* <input.ts>\n");
+	fprintf(stderr, "       gpr2gpa [-v2] * <input.ts>\n");
+	fprintf(stderr, "  -v2: Pre-bake pictures to the display formats and write an archive index\n");
 	return -1;
 }
 
 int toolMain(int argc, const char **argv)
 {
+	bool isVersion2 = false;
+	if (argc >= 2 && !strcmp(argv[1], "-v2"))
+	{
+		isVersion2 = true;
+		argc--;
+		argv++;
+	}
+
 	if (argc < 3)
 		return PrintUsage();
 
@@ -1639,13 +1876,13 @@ int toolMain(int argc, const char **argv)
 	std::string base = argv[1];
 
 	if (base == "*")
-		return ConvertDirectory(".", ts);
+		return ConvertDirectory(".", ts, isVersion2);
 
 	if (base.length() >= 2)
 	{
 		std::string baseEnding = base.substr(base.length() - 2, 2);
 		if (baseEnding == "\\*" || baseEnding == "/*")
-			return ConvertDirectory(base.substr(0, base.length() - 2), ts);
+			return ConvertDirectory(base.substr(0, base.length() - 2), ts, isVersion2);
 	}
 
 	if (argc != 4 && argc != 5)
@@ -1662,5 +1899,5 @@ int toolMain(int argc, const char **argv)
 		}
 	}
 
-	return ConvertSingleFile(argv[1], ts, patchF, argv[3]);
+	return ConvertSingleFile(argv[1], ts, patchF, argv[3], isVersion2);
 }